@@ -0,0 +1,216 @@
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+
+#include "pix/pix.hpp"
+#include "math/utils.hpp"
+#include "utils/hittable_list.hpp"
+#include "utils/bvh.hpp"
+#include "utils/scenes.hpp"
+#include "utils/scene_file.hpp"
+#include "utils/compiled_scene.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/camera.hpp"
+#include "utils/renderer.hpp"
+#include "utils/frame_writer.hpp"
+#include "utils/frame_time_controller.hpp"
+
+const auto aspect_ratio = 16.0 / 9.0;
+const int image_width = 800;
+const int image_height = static_cast<int>(image_width / aspect_ratio);
+
+camera cam = random_scene_camera(0, aspect_ratio);
+
+// Samples added per frame, the image converges while the camera stands still
+const int samples_per_frame = 2;
+std::unique_ptr<renderer> tracer;
+
+scene world_scene;
+std::unique_ptr<hittable> world;
+
+double lastTime = 0.0;
+int frame_count = 0;
+int orbit_step = 0;
+bool orbiting = true;
+bool space_was_down = false, left_was_down = false, right_was_down = false;
+
+// Frame in flight. It renders into target while the window keeps showing the
+// last finished frame, the main thread never waits for it.
+std::shared_ptr<render_job> job;
+image target(image_width, image_height);
+
+// Shrinks the frames of a moving camera to keep up the frame rate, --target-fps sets it
+double target_fps = 30.0;
+std::unique_ptr<frame_time_controller> pacing;
+frame_time_controller::frame_size job_size;
+
+bool save_image = false;
+// Frame number goes in place of the #s, --output changes it
+std::string output_pattern = "output/frame_#.jpg";
+// Encodes saved frames on its own threads while the next frame renders
+std::unique_ptr<frame_writer> writer;
+// Per frame statistics as JSON lines, opened by --stats
+std::ofstream stats_file;
+
+// Shows a finished frame, prints its numbers and saves it
+void showFrame(Pix *pix, const render_job &done)
+{
+    double currentTime = Pix::GetTime();
+    double delta = currentTime - lastTime;
+    lastTime = currentTime;
+    double render_time = done.seconds();
+    pacing->finished(job_size, render_time);
+
+    // Frames of a moving camera may be smaller than the window
+    resample(target, pix->frame);
+
+    std::cout << "Frame : " << frame_count << " FPS : " << 1.0 / delta << " Frame time : " << delta
+              << " Resolution : " << target.width << "x" << target.height
+              << " Samples : " << tracer->accumulated_samples() << std::endl;
+    done.stats().print(std::cout, render_time);
+    if (stats_file.is_open())
+        done.stats().write_json(stats_file, frame_count, tracer->settings.max_depth, render_time);
+
+    frame_count++;
+    if (orbiting)
+        orbit_step++;
+    if (!save_image)
+        return;
+    // The window keeps drawing pix->frame, the encoders get a copy
+    image &copy = writer->acquire(pix->frame.width, pix->frame.height);
+    copy.pixels = pix->frame.pixels;
+    writer->submit(copy, frame_path(output_pattern, frame_count));
+}
+
+// Called for every frame of the window, starts a render whenever none is running
+void renderCallback(Pix *pix)
+{
+    // Space pauses the orbit, letting the image converge
+    bool space_down = pix->IsKeyPressed(GLFW_KEY_SPACE);
+    if (space_down && !space_was_down)
+        orbiting = !orbiting;
+    space_was_down = space_down;
+
+    // The arrow keys turn the orbit by hand
+    bool left_down = pix->IsKeyPressed(GLFW_KEY_LEFT), right_down = pix->IsKeyPressed(GLFW_KEY_RIGHT);
+    if (left_down && !left_was_down)
+        orbit_step--;
+    if (right_down && !right_was_down)
+        orbit_step++;
+    left_was_down = left_down;
+    right_was_down = right_down;
+
+    if (job && job->done())
+    {
+        if (job->wait() == job_state::finished)
+            showFrame(pix, *job);
+        job.reset();
+    }
+
+    //rotate camera around the lookat point, a scene's own camera stands still
+    camera next = world_scene.view ? world_scene.view->make(aspect_ratio) : random_scene_camera(orbit_step, aspect_ratio);
+
+    // A frame for a camera that has moved on is of no use, drop it at once
+    if (job && next != cam)
+    {
+        job->cancel();
+        job->wait();
+        job.reset();
+    }
+
+    if (!job)
+    {
+        // Once the camera stops the frames go back to full size and converge
+        job_size = pacing->next(next != cam);
+        if (target.width != job_size.width || target.height != job_size.height)
+            target = image(job_size.width, job_size.height);
+        tracer->settings.samples_per_pixel = job_size.samples;
+        cam = next;
+        job = tracer->submit(*world, world_scene.materials, cam, target, true, [](int tiles_done, int tiles_total)
+                             {
+            int remaining = tiles_total - tiles_done;
+            // Percentage of tiles processed upto 2 decimal places
+            std::cout << "Tiles remaining: " << remaining << " : Remaining " << std::fixed << std::setprecision(2) << (remaining * 100.0) / tiles_total << "%"
+                      << "\r"; });
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    std::string scene_path;
+    bool denoise = false; // --denoise filters every frame before it is shown
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--save") == 0)
+        {
+            save_image = true;
+            std::cout << "Saving images to output folder. Make sure a folder named \"output\" exists..." << std::endl;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            // A .y4m path collects every frame in one video stream
+            save_image = true;
+            output_pattern = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            scene_path = argv[++i];
+        else if (strcmp(argv[i], "--denoise") == 0)
+            denoise = true;
+        else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc)
+            target_fps = std::strtod(argv[++i], nullptr); // 0 renders every frame at full size
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            stats_file.open(argv[++i], std::ios::app);
+            if (!stats_file)
+            {
+                std::cerr << "Failed to open " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    auto pix = Pix(image_width, image_height, "Raytracer");
+
+    if (scene_path.empty())
+    {
+        world_scene = random_scene();
+        world = std::make_unique<bvh>(world_scene.objects);
+    }
+    else if (is_compiled_scene(scene_path))
+    {
+        auto flat = std::make_unique<flat_scene>();
+        if (!load_compiled_scene(scene_path, *flat, world_scene.materials, world_scene.view))
+            return 1;
+        world = std::move(flat);
+    }
+    else
+    {
+        if (!load_scene(scene_path, world_scene))
+            return 1;
+        world = std::make_unique<bvh>(world_scene.objects);
+    }
+    render_settings settings;
+    settings.samples_per_pixel = samples_per_frame;
+    settings.denoise.enabled = denoise;
+    tracer = std::make_unique<renderer>(settings);
+    pacing = std::make_unique<frame_time_controller>(
+        frame_time_controller::frame_size{image_width, image_height, samples_per_frame},
+        target_fps > 0 ? 1.0 / target_fps : 0.0);
+
+    auto yellow = "\u001b[33m";
+    auto reset = "\u001b[0m";
+    std::cout << yellow << "Using " << tracer->num_threads() << " threads" << reset << std::endl;
+
+    writer = std::make_unique<frame_writer>();
+    // Progress goes to the terminal a few times a second, not on every tile
+    tracer->progress_interval = std::chrono::milliseconds(250);
+    pix.PixRun(renderCallback);
+    if (job)
+    {
+        job->cancel();
+        job->wait();
+    }
+    return writer->flush() ? 0 : 1;
+}
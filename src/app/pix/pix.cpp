@@ -31,7 +31,7 @@ Pix::Pix(int width, int height, std::string title){
 
     // Setup the scene
     GLuint VAO, VBO, EBO, shaderProgram, texture;
-    uint8_t* pixels = this->_setupScene(&VAO, &VBO, &EBO, &shaderProgram, &texture);
+    this->_setupScene(&VAO, &VBO, &EBO, &shaderProgram, &texture);
 
     this->window = window;
     this->VAO = VAO;
@@ -39,11 +39,9 @@ Pix::Pix(int width, int height, std::string title){
     this->EBO = EBO;
     this->shaderProgram = shaderProgram;
     this->texture = texture;
-    this->pixels = pixels;
 }
 
 Pix::~Pix(){
-    delete[] this->pixels;
     glfwTerminate();
 }
 void Pix::PixRun(void (*callback)(Pix* pix)){
@@ -67,29 +65,21 @@ void Pix::PixRun(void (*callback)(Pix* pix)){
 }
 
 void Pix::SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
-    this->pixels[(y * this->width + x) * 3 + 0] = r;
-    this->pixels[(y * this->width + x) * 3 + 1] = g;
-    this->pixels[(y * this->width + x) * 3 + 2] = b;
+    this->frame.set_pixel(x, y, r, g, b);
 }
 
 void Pix::SetPixel(int x, int y, color col, int samples_per_pixel){
-    auto r = col.x();
-    auto g = col.y();
-    auto b = col.z();
-
-    auto scale = 1.0 / samples_per_pixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
-    this->pixels[(y * this->width + x) * 3 + 0] = static_cast<uint8_t>(256 * clamp(r, 0.0, 0.999));
-    this->pixels[(y * this->width + x) * 3 + 1] = static_cast<uint8_t>(256 * clamp(g, 0.0, 0.999));
-    this->pixels[(y * this->width + x) * 3 + 2] = static_cast<uint8_t>(256 * clamp(b, 0.0, 0.999));
+    this->frame.set_pixel(x, y, col, samples_per_pixel);
 }
 
 double Pix::GetTime(){
     return glfwGetTime();
 }
 
+bool Pix::IsKeyPressed(int key){
+    return glfwGetKey(this->window, key) == GLFW_PRESS;
+}
+
 void Pix::_framebuffer_size_callback(GLFWwindow* window, int width, int height){
     (void)window;
     glViewport(0, 0, width, height);
@@ -136,6 +126,8 @@ GLFWwindow* Pix::_initializeWindow(int width, int height, std::string title){
     }
 
     glfwMakeContextCurrent(window);
+    // Wait for the display between frames instead of redrawing as fast as possible
+    glfwSwapInterval(1);
     glfwSetFramebufferSizeCallback(window, this->_framebuffer_size_callback);
 
     if (glewInit() != GLEW_OK)
@@ -147,7 +139,7 @@ GLFWwindow* Pix::_initializeWindow(int width, int height, std::string title){
     return window;
 }
 
-uint8_t* Pix::_setupScene(GLuint *VAO, GLuint *VBO, GLuint *EBO, GLuint *shaderProgram, GLuint *texture){
+void Pix::_setupScene(GLuint *VAO, GLuint *VBO, GLuint *EBO, GLuint *shaderProgram, GLuint *texture){
     float vertices[] = {
         // positions         // texture coords
         1.0f, 1.0f, 0.0f, 1.0f, 1.0f,   // top right
@@ -194,16 +186,14 @@ uint8_t* Pix::_setupScene(GLuint *VAO, GLuint *VBO, GLuint *EBO, GLuint *shaderP
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    uint8_t* pixels = new uint8_t[this->width * this->height * 3];
-    this->_createTexture(texture, pixels);
-
-    return pixels;
+    this->frame = image(this->width, this->height);
+    this->_createTexture(texture, this->frame.data());
 }
 
 void Pix::_updateTexture(void (*callback)(Pix* pix)){
     callback(this);
     // Update the texture with the new pixel data
     glBindTexture(GL_TEXTURE_2D, this->texture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, this->pixels);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, this->frame.data());
 }
 
@@ -0,0 +1,588 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "math/utils.hpp"
+#include "utils/hittable_list.hpp"
+#include "utils/bvh.hpp"
+#include "utils/sphere.hpp"
+#include "utils/camera.hpp"
+#include "utils/material.hpp"
+#include "utils/scenes.hpp"
+#include "utils/triangle_mesh.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/instance.hpp"
+
+// Relative difference allowed between two code paths computing the same hit
+// distance, they round differently once the compiler fuses multiply-adds
+const double hit_tolerance = sizeof(real) == sizeof(float) ? 1e-4 : 1e-9;
+
+double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+hittable_list sphere_field(int count)
+{
+    hittable_list world;
+    const material_id mat = 0; // Only the hit distances are compared
+    double half_side = 0.75 * std::cbrt(static_cast<double>(count));
+
+    for (int i = 0; i < count; i++)
+        world.add(make_shared<sphere>(random_vec3(-half_side, half_side), 0.2, mat));
+
+    return world;
+}
+
+std::vector<ray> field_rays(int count, const aabb &bounds)
+{
+    std::vector<ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        point3 origin(
+            random_double(bounds.minimum.x(), bounds.maximum.x()),
+            random_double(bounds.minimum.y(), bounds.maximum.y()),
+            random_double(bounds.minimum.z(), bounds.maximum.z()));
+        rays.push_back(ray(origin, random_unit_vector()));
+    }
+    return rays;
+}
+
+std::vector<ray> camera_rays(int count)
+{
+    point3 lookfrom(3, 2, 10);
+    point3 lookat(0, 0, -1);
+    camera cam(lookfrom, lookat, vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, (lookat - lookfrom).length());
+
+    std::vector<ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; i++)
+        rays.push_back(cam.get_ray(random_double(), random_double()));
+    return rays;
+}
+
+double trace(const hittable &world, const std::vector<ray> &rays, size_t count, std::vector<double> &hits)
+{
+    hits.assign(count, infinity);
+    hit_record rec;
+
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (world.hit(rays[i], 0.001, infinity, rec))
+            hits[i] = rec.t;
+    }
+    return seconds_since(start);
+}
+
+void compare(const std::string &name, const hittable_list &list, const std::vector<ray> &rays)
+{
+    auto start = bench_clock::now();
+    bvh accel(list);
+    double build_time = seconds_since(start);
+
+    // The flat list is quadratic overall, so trace fewer rays through it on big scenes
+    size_t flat_count = std::min(rays.size(), std::max<size_t>(1000, 20000000 / list.objects.size()));
+
+    std::vector<double> flat_hits, bvh_hits;
+    double flat_time = trace(list, rays, flat_count, flat_hits);
+    double bvh_time = trace(accel, rays, rays.size(), bvh_hits);
+
+    int mismatches = 0;
+    for (size_t i = 0; i < flat_count; i++)
+    {
+        if (flat_hits[i] != bvh_hits[i])
+            mismatches++;
+    }
+
+    double flat_rate = flat_count / flat_time;
+    double bvh_rate = rays.size() / bvh_time;
+
+    std::cout << std::left << std::setw(16) << name
+              << std::right << std::setw(10) << list.objects.size()
+              << std::setw(10) << accel.nodes.size()
+              << std::setw(7) << accel.depth()
+              << std::fixed << std::setprecision(3)
+              << std::setw(11) << build_time * 1000.0
+              << std::setw(12) << flat_rate / 1e6
+              << std::setw(12) << bvh_rate / 1e6
+              << std::setw(10) << bvh_rate / flat_rate
+              << std::setw(12) << mismatches << std::endl;
+}
+
+// Camera rays through every pixel centre in scanline order, the coherent
+// pattern the packet path sees during rendering
+std::vector<ray> primary_rays(int width, int height)
+{
+    camera cam = random_scene_camera(0, static_cast<double>(width) / height);
+    std::vector<ray> rays;
+    rays.reserve(static_cast<size_t>(width) * height);
+    for (int j = 0; j < height; j++)
+        for (int i = 0; i < width; i++)
+            rays.push_back(cam.get_ray((i + 0.5) / (width - 1), (j + 0.5) / (height - 1)));
+    return rays;
+}
+
+// Like trace, packet_size rays at a time through hit_packet
+double trace_packets(const hittable &world, const std::vector<ray> &rays, std::vector<double> &hits)
+{
+    hits.assign(rays.size(), infinity);
+
+    auto start = bench_clock::now();
+    for (size_t first = 0; first < rays.size(); first += packet_size)
+    {
+        ray_packet packet;
+        packet.t_min = 0.001;
+        const hittable *hit_objects[packet_size] = {};
+        for (int l = 0; l < packet_size; l++)
+        {
+            if (first + l < rays.size())
+                packet.set(l, rays[first + l], infinity);
+            else
+                packet.deactivate(l);
+        }
+        world.hit_packet(packet, hit_objects);
+        for (int l = 0; l < packet_size && first + l < rays.size(); l++)
+        {
+            if (hit_objects[l])
+                hits[first + l] = packet.t_max[l];
+        }
+    }
+    return seconds_since(start);
+}
+
+void compare_packets(const hittable &world, const std::vector<ray> &rays)
+{
+    std::vector<double> scalar_hits;
+    double scalar_time = trace(world, rays, rays.size(), scalar_hits);
+
+    std::vector<double> packet_hits;
+    double packet_time = trace_packets(world, rays, packet_hits);
+
+    int mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        if (fabs(scalar_hits[i] - packet_hits[i]) > hit_tolerance * (1.0 + fabs(scalar_hits[i])) && scalar_hits[i] != packet_hits[i])
+            mismatches++;
+    }
+
+    double scalar_rate = rays.size() / scalar_time;
+    double packet_rate = rays.size() / packet_time;
+    std::cout << "primary rays, " << packet_size << " per packet, " << simd_width << " SIMD lanes: "
+              << std::fixed << std::setprecision(3)
+              << "scalar " << scalar_rate / 1e6 << " Mray/s, packet " << packet_rate / 1e6 << " Mray/s, speedup "
+              << packet_rate / scalar_rate << ", mismatches " << mismatches << std::endl;
+}
+
+// Like scanned or modelled surfaces, neighbouring triangles share their vertices
+void height_field(int count, std::vector<point3> &vertices, std::vector<uint32_t> &indices)
+{
+    int cells = std::max(1, static_cast<int>(std::sqrt(count / 2.0)));
+    vertices.clear();
+    indices.clear();
+    for (int z = 0; z <= cells; z++)
+        for (int x = 0; x <= cells; x++)
+            vertices.push_back(point3(0.3 * x, random_double(0, 0.3), 0.3 * z));
+
+    for (int z = 0; z < cells; z++)
+    {
+        for (int x = 0; x < cells; x++)
+        {
+            uint32_t i0 = static_cast<uint32_t>(z * (cells + 1) + x);
+            uint32_t i1 = i0 + 1, i2 = i0 + cells + 1, i3 = i2 + 1;
+            indices.insert(indices.end(), {i0, i1, i2, i1, i3, i2});
+        }
+    }
+}
+
+// Standalone triangle objects in a bvh against one triangle_mesh over the same data
+void compare_mesh(int count, int ray_count)
+{
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices;
+    height_field(count, vertices, indices);
+    count = static_cast<int>(indices.size() / 3);
+
+    const material_id mat = 0; // Only the hit distances are compared
+    hittable_list list;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        list.add(make_shared<triangle>(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], mat));
+
+    auto start = bench_clock::now();
+    bvh objects(list);
+    double objects_build = seconds_since(start);
+    start = bench_clock::now();
+    triangle_mesh mesh(vertices, indices, mat);
+    double mesh_build = seconds_since(start);
+
+    // Every triangle object is a separate allocation with a control block, referenced from the list and the bvh
+    size_t object_bytes = count * (sizeof(triangle) + 16 + 2 * sizeof(shared_ptr<hittable>)) + objects.nodes.size() * sizeof(bvh_node);
+    size_t mesh_bytes = mesh.memory_size();
+
+    aabb bounds;
+    mesh.bounding_box(bounds);
+    std::vector<ray> rays = field_rays(ray_count, bounds);
+    std::vector<double> object_hits, mesh_hits;
+    double object_time = trace(objects, rays, rays.size(), object_hits);
+    double mesh_time = trace(mesh, rays, rays.size(), mesh_hits);
+
+    // The mesh stores its edges in single precision, so allow for rounding
+    int mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        if (object_hits[i] != mesh_hits[i] && !(fabs(object_hits[i] - mesh_hits[i]) < 1e-4 * (1.0 + fabs(object_hits[i]))))
+            mismatches++;
+    }
+
+    std::cout << std::left << std::setw(16) << "height_field"
+              << std::right << std::setw(10) << count
+              << std::fixed << std::setprecision(3)
+              << std::setw(11) << objects_build * 1000.0
+              << std::setw(11) << mesh_build * 1000.0
+              << std::setw(9) << std::setprecision(1) << static_cast<double>(object_bytes) / count
+              << std::setw(9) << static_cast<double>(mesh_bytes) / count
+              << std::setprecision(3)
+              << std::setw(12) << rays.size() / object_time / 1e6
+              << std::setw(12) << rays.size() / mesh_time / 1e6
+              << std::setw(12) << mismatches << std::endl;
+}
+
+// Unit sphere of stacks rings by slices segments, the two triangles of every
+// cell but the one that collapses at each pole
+void uv_sphere(int stacks, int slices, std::vector<point3> &vertices, std::vector<uint32_t> &indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (int i = 0; i <= stacks; i++)
+    {
+        double theta = pi * i / stacks;
+        for (int j = 0; j < slices; j++)
+        {
+            double phi = 2 * pi * j / slices;
+            vertices.push_back(point3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+        }
+    }
+
+    for (int i = 0; i < stacks; i++)
+    {
+        for (int j = 0; j < slices; j++)
+        {
+            uint32_t i0 = static_cast<uint32_t>(i * slices + j);
+            uint32_t i1 = static_cast<uint32_t>(i * slices + (j + 1) % slices);
+            uint32_t i2 = i0 + slices, i3 = i1 + slices;
+            if (i > 0)
+                indices.insert(indices.end(), {i0, i1, i2});
+            if (i < stacks - 1)
+                indices.insert(indices.end(), {i1, i3, i2});
+        }
+    }
+}
+
+// Rays from outside aimed into a dense sphere mesh, whose edges of about 1e-2
+// give Möller-Trumbore determinants far below any ray t_min. Every ray has to
+// hit on every path, returns the number of misses.
+int check_dense_mesh(int ray_count)
+{
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices;
+    uv_sphere(200, 400, vertices, indices);
+
+    const material_id mat = 0; // Only the hits are counted
+    auto mesh = make_shared<triangle_mesh>(vertices, indices, mat);
+    hittable_list objects;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        objects.add(make_shared<triangle>(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], mat));
+    bvh object_tree(objects);
+    hittable_list meshes;
+    meshes.add(mesh);
+    flat_scene flat(meshes);
+
+    // Directions are left unnormalized, like those of the camera
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++)
+    {
+        point3 origin = 3 * random_unit_vector();
+        rays.push_back(ray(origin, random_vec3(-0.5, 0.5) - origin));
+    }
+
+    std::vector<double> hits[5];
+    trace(*mesh, rays, rays.size(), hits[0]);
+    trace(object_tree, rays, rays.size(), hits[1]);
+    trace(flat, rays, rays.size(), hits[2]);
+    trace_packets(*mesh, rays, hits[3]);
+    trace_packets(flat, rays, hits[4]);
+
+    int total = 0;
+    std::cout << std::left << std::setw(16) << "uv_sphere"
+              << std::right << std::setw(10) << indices.size() / 3;
+    for (const std::vector<double> &path : hits)
+    {
+        int misses = static_cast<int>(std::count(path.begin(), path.end(), infinity));
+        total += misses;
+        std::cout << std::setw(13) << misses;
+    }
+    std::cout << std::endl;
+    return total;
+}
+
+// Copies of one mesh baked into world space, a triangle_mesh each in a bvh,
+// against instances of the mesh under an instance_bvh
+void compare_instances(int copies, int ray_count)
+{
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices;
+    height_field(200, vertices, indices);
+    const material_id mat = 0; // Only the hit distances are compared
+    auto shared_mesh = make_shared<triangle_mesh>(vertices, indices, mat);
+
+    double half_side = 2.5 * std::cbrt(static_cast<double>(copies));
+    std::vector<affine_transform> placements;
+    for (int i = 0; i < copies; i++)
+        placements.push_back(affine_transform::translate(random_vec3(-half_side, half_side)) *
+                             affine_transform::rotate(vec3(0, 1, 0), static_cast<real>(random_double(0, 2 * pi))) *
+                             affine_transform::scale(vec3(1, 1, 1) * static_cast<real>(random_double(0.5, 1.5))));
+
+    auto start = bench_clock::now();
+    hittable_list baked_meshes;
+    for (const affine_transform &t : placements)
+    {
+        std::vector<point3> placed(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++)
+            placed[v] = t.point(vertices[v]);
+        baked_meshes.add(make_shared<triangle_mesh>(std::move(placed), indices, mat));
+    }
+    bvh baked(baked_meshes);
+    double baked_build = seconds_since(start);
+
+    start = bench_clock::now();
+    std::vector<instance> copies_of_mesh;
+    copies_of_mesh.reserve(copies);
+    for (const affine_transform &t : placements)
+        copies_of_mesh.emplace_back(shared_mesh, t);
+    instance_bvh instanced(std::move(copies_of_mesh));
+    double instanced_build = seconds_since(start);
+
+    size_t baked_bytes = baked.nodes.size() * sizeof(bvh_node);
+    for (const auto &object : baked_meshes.objects)
+        baked_bytes += std::static_pointer_cast<triangle_mesh>(object)->memory_size() + sizeof(triangle_mesh) + 16 + 2 * sizeof(shared_ptr<hittable>);
+    size_t instanced_bytes = instanced.memory_size() + shared_mesh->memory_size();
+
+    aabb bounds;
+    instanced.bounding_box(bounds);
+    std::vector<ray> rays = field_rays(ray_count, bounds);
+    std::vector<double> baked_hits, instanced_hits;
+    double baked_time = trace(baked, rays, rays.size(), baked_hits);
+    double instanced_time = trace(instanced, rays, rays.size(), instanced_hits);
+
+    // Both store the triangles in single precision, in different spaces
+    int mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        if (baked_hits[i] != instanced_hits[i] && !(fabs(baked_hits[i] - instanced_hits[i]) < 1e-4 * (1.0 + fabs(baked_hits[i]))))
+            mismatches++;
+    }
+
+    std::cout << std::left << std::setw(16) << "height_field"
+              << std::right << std::setw(10) << copies
+              << std::setw(12) << static_cast<size_t>(copies) * shared_mesh->triangle_count()
+              << std::fixed << std::setprecision(3)
+              << std::setw(11) << baked_build * 1000.0
+              << std::setw(11) << instanced_build * 1000.0
+              << std::setw(10) << std::setprecision(1) << static_cast<double>(baked_bytes) / copies
+              << std::setw(10) << static_cast<double>(instanced_bytes) / copies
+              << std::setprecision(3)
+              << std::setw(12) << rays.size() / baked_time / 1e6
+              << std::setw(12) << rays.size() / instanced_time / 1e6
+              << std::setw(12) << mismatches << std::endl;
+}
+
+// The bvh over objects against the flat structure of arrays backend
+void compare_backends(const std::string &name, const hittable_list &list, const std::vector<ray> &rays)
+{
+    auto start = bench_clock::now();
+    bvh tree(list);
+    double tree_build = seconds_since(start);
+    start = bench_clock::now();
+    flat_scene flat(list);
+    double flat_build = seconds_since(start);
+
+    std::vector<double> tree_hits, flat_hits;
+    double tree_time = trace(tree, rays, rays.size(), tree_hits);
+    double flat_time = trace(flat, rays, rays.size(), flat_hits);
+
+    // The inlined flat loops may fuse multiply-adds that the object code does not
+    int mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        if (fabs(tree_hits[i] - flat_hits[i]) > hit_tolerance * (1.0 + fabs(tree_hits[i])) && tree_hits[i] != flat_hits[i])
+            mismatches++;
+    }
+
+    size_t primitives = flat.sphere_count() + flat.triangle_count() + flat.box_count() + flat.quad_count() +
+                        flat.disk_count();
+    std::cout << std::left << std::setw(16) << name
+              << std::right << std::setw(10) << primitives
+              << std::fixed << std::setprecision(3)
+              << std::setw(11) << tree_build * 1000.0
+              << std::setw(11) << flat_build * 1000.0
+              << std::setw(12) << rays.size() / tree_time / 1e6
+              << std::setw(12) << rays.size() / flat_time / 1e6
+              << std::setw(10) << tree_time / flat_time
+              << std::setw(12) << mismatches << std::endl;
+}
+
+int main(int argc, char const *argv[])
+{
+    int max_primitives = 0; // 0 picks the default of the mode
+    int ray_count = 200000;
+    bool suite = false;
+    suite_options suite_opts;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-primitives") == 0 && i + 1 < argc)
+            max_primitives = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            ray_count = std::atoi(argv[++i]);
+        else if (strcmp(argv[i], "--suite") == 0)
+            suite = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            suite_opts.json = argv[++i];
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            suite_opts.min_seconds = std::atof(argv[++i]);
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+            suite_opts.width = std::max(16, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "--spp") == 0 && i + 1 < argc)
+            suite_opts.spp = std::max(1, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            suite_opts.threads = std::max(0, std::atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            suite_opts.seed = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max-primitives N] [--rays N]\n"
+                      << "       " << argv[0] << " --suite [--json PATH] [--max-primitives N] [--min-time S]\n"
+                      << "             [--width N] [--spp N] [--threads N] [--seed N]\n"
+                      << "  Without --suite, compares the acceleration structures against each other.\n"
+                      << "  With --suite, times the intersection, scatter and sampling functions and\n"
+                      << "  fixed seed renders of 10^2 up to --max-primitives (default 10^6) primitives,\n"
+                      << "  and writes rays/s and ns/ray as JSON to PATH (default - for stdout)." << std::endl;
+            return 1;
+        }
+    }
+
+    if (suite)
+    {
+        if (max_primitives > 0)
+            suite_opts.max_primitives = max_primitives;
+        return run_suite(suite_opts);
+    }
+    if (max_primitives <= 0)
+        max_primitives = 100000;
+
+    std::cout << std::left << std::setw(16) << "scene"
+              << std::right << std::setw(10) << "prims"
+              << std::setw(10) << "nodes"
+              << std::setw(7) << "depth"
+              << std::setw(11) << "build ms"
+              << std::setw(12) << "flat Mray/s"
+              << std::setw(12) << "bvh Mray/s"
+              << std::setw(10) << "speedup"
+              << std::setw(12) << "mismatches" << std::endl;
+
+    hittable_list scene = random_scene().objects;
+    compare("random_scene", scene, camera_rays(ray_count));
+
+    for (int count = 100; count <= max_primitives; count *= 10)
+    {
+        hittable_list field = sphere_field(count);
+        aabb bounds;
+        field.bounding_box(bounds);
+        compare("sphere_field", field, field_rays(ray_count, bounds));
+    }
+
+    std::cout << std::endl;
+    compare_packets(bvh(scene), primary_rays(800, 450));
+
+    std::cout << std::endl
+              << std::left << std::setw(16) << "scene"
+              << std::right << std::setw(10) << "tris"
+              << std::setw(11) << "obj ms"
+              << std::setw(11) << "mesh ms"
+              << std::setw(9) << "obj B/t"
+              << std::setw(9) << "mesh B/t"
+              << std::setw(12) << "obj Mray/s"
+              << std::setw(12) << "mesh Mray/s"
+              << std::setw(12) << "mismatches" << std::endl;
+    for (int count = 100; count <= max_primitives * 10; count *= 10)
+        compare_mesh(count, ray_count);
+
+    std::cout << std::endl
+              << std::left << std::setw(16) << "misses"
+              << std::right << std::setw(10) << "tris"
+              << std::setw(13) << "mesh"
+              << std::setw(13) << "objects"
+              << std::setw(13) << "flat"
+              << std::setw(13) << "mesh packet"
+              << std::setw(13) << "flat packet" << std::endl;
+    int dense_misses = check_dense_mesh(ray_count);
+
+    std::cout << std::endl
+              << std::left << std::setw(16) << "scene"
+              << std::right << std::setw(10) << "copies"
+              << std::setw(12) << "tris"
+              << std::setw(11) << "baked ms"
+              << std::setw(11) << "inst ms"
+              << std::setw(10) << "baked B/c"
+              << std::setw(10) << "inst B/c"
+              << std::setw(12) << "bake Mray/s"
+              << std::setw(12) << "inst Mray/s"
+              << std::setw(12) << "mismatches" << std::endl;
+    for (int copies = 10; copies <= max_primitives / 10; copies *= 10)
+        compare_instances(copies, ray_count);
+
+    std::cout << std::endl
+              << std::left << std::setw(16) << "scene"
+              << std::right << std::setw(10) << "prims"
+              << std::setw(11) << "bvh ms"
+              << std::setw(11) << "flat ms"
+              << std::setw(12) << "bvh Mray/s"
+              << std::setw(12) << "flat Mray/s"
+              << std::setw(10) << "speedup"
+              << std::setw(12) << "mismatches" << std::endl;
+    compare_backends("random_scene", scene, camera_rays(ray_count));
+    for (int count = 100; count <= max_primitives; count *= 10)
+    {
+        hittable_list field = sphere_field(count);
+        aabb bounds;
+        field.bounding_box(bounds);
+        compare_backends("sphere_field", field, field_rays(ray_count, bounds));
+    }
+    for (int count = 100; count <= max_primitives; count *= 10)
+    {
+        std::vector<point3> vertices;
+        std::vector<uint32_t> indices;
+        height_field(count, vertices, indices);
+        hittable_list triangles;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            triangles.add(make_shared<triangle>(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], 0));
+        aabb bounds;
+        triangles.bounding_box(bounds);
+        compare_backends("height_field", triangles, field_rays(ray_count, bounds));
+    }
+
+    if (dense_misses > 0)
+    {
+        std::cerr << dense_misses << " rays missed the dense mesh" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,354 @@
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "bench/bench.hpp"
+#include "math/ray_packet.hpp"
+#include "utils/sphere.hpp"
+#include "utils/cube.hpp"
+#include "utils/planar.hpp"
+#include "utils/camera.hpp"
+#include "utils/material.hpp"
+#include "utils/scenes.hpp"
+#include "utils/triangle_mesh.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/renderer.hpp"
+#include "utils/image.hpp"
+
+// Inputs per microbenchmark, cycled through until the minimum time has passed.
+// Small enough to stay in L1, so the numbers are about the arithmetic.
+static const size_t micro_inputs = 1024;
+
+struct micro_result
+{
+    std::string name;
+    std::string unit; // What one call produces, ray or sample
+    uint64_t calls;
+    double seconds;
+};
+
+struct render_result
+{
+    std::string scene;
+    size_t primitives;
+    int width, height, spp, threads;
+    double build_seconds, seconds;
+    uint64_t samples, rays;
+    uint64_t image_hash;
+};
+
+// Calls op(i) for i cycling over the inputs until min_seconds have passed. The
+// values op returns are summed into a volatile, so the calls can't be dropped.
+template <typename Op>
+static micro_result time_calls(const std::string &name, const std::string &unit, double min_seconds, Op op)
+{
+    double sum = 0;
+    uint64_t calls = 0;
+    double elapsed;
+    auto start = bench_clock::now();
+    do
+    {
+        for (size_t i = 0; i < micro_inputs; i++)
+            sum += op(i);
+        calls += micro_inputs;
+    } while ((elapsed = seconds_since(start)) < min_seconds);
+
+    volatile double sink = sum;
+    (void)sink;
+    std::cerr << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << elapsed * 1e9 / calls << " ns/" << unit << std::endl;
+    return {name, unit, calls, elapsed};
+}
+
+// Rays from a small cloud around origin towards points spread around target,
+// so that some of them pass the object by
+static std::vector<ray> aimed_rays(const point3 &origin, const point3 &target, double spread)
+{
+    std::vector<ray> rays;
+    for (size_t i = 0; i < micro_inputs; i++)
+    {
+        point3 from = origin + 0.2 * random_in_unit_sphere();
+        point3 to = target + spread * random_in_unit_sphere();
+        rays.push_back(ray(from, unit_vector(to - from)));
+    }
+    return rays;
+}
+
+static void run_micro(const suite_options &options, std::vector<micro_result> &results)
+{
+    const double min_seconds = options.min_seconds;
+    const point3 eye(0, 0, 1);
+    hit_record rec;
+
+    thread_rng().seed(options.seed);
+    sphere ball(point3(0, 0, -1), 0.5, 0);
+    std::vector<ray> ball_rays = aimed_rays(eye, ball.center, 0.7);
+    results.push_back(time_calls("sphere::hit", "ray", min_seconds, [&](size_t i)
+                                 { return ball.hit(ball_rays[i], 0.001, infinity, rec) ? rec.t : 0.0; }));
+
+    triangle tri(point3(-1, -1, -1), point3(1, -1, -1), point3(0, 1, -1), 0);
+    std::vector<ray> tri_rays = aimed_rays(eye, point3(0, 0, -1), 1.0);
+    results.push_back(time_calls("ray_triangle_intersection", "ray", min_seconds, [&](size_t i)
+                                 { return ray_triangle_intersection(tri_rays[i], tri, 0.001, infinity, rec) ? rec.t : 0.0; }));
+
+    cube box(point3(0, 0, -1), 1, vec3(0, 1, 0), vec3(0, 0, 1), 0);
+    std::vector<ray> box_rays = aimed_rays(eye, box.center, 1.0);
+    results.push_back(time_calls("cube::hit", "ray", min_seconds, [&](size_t i)
+                                 { return box.hit(box_rays[i], 0.001, infinity, rec) ? rec.t : 0.0; }));
+
+    quad panel(point3(-1, -1, -1), vec3(2, 0, 0), vec3(0, 2, 0), 0);
+    std::vector<ray> panel_rays = aimed_rays(eye, point3(0, 0, -1), 1.0);
+    results.push_back(time_calls("quad::hit", "ray", min_seconds, [&](size_t i)
+                                 { return panel.hit(panel_rays[i], 0.001, infinity, rec) ? rec.t : 0.0; }));
+
+    scene cover = random_scene();
+    camera cam = random_scene_camera(0, 16.0 / 9.0);
+    std::vector<ray> camera_rays;
+    for (size_t i = 0; i < micro_inputs; i++)
+        camera_rays.push_back(cam.get_ray(random_double(), random_double()));
+    results.push_back(time_calls("hittable_list::hit/random_scene", "ray", min_seconds, [&](size_t i)
+                                 { return cover.objects.hit(camera_rays[i], 0.001, infinity, rec) ? rec.t : 0.0; }));
+
+    // Incoming rays with the records of their hits on the sphere, half of them from the inside
+    std::vector<ray> incoming;
+    std::vector<hit_record> records;
+    for (size_t i = 0; incoming.size() < micro_inputs; i++)
+    {
+        const ray &r = ball_rays[i % micro_inputs];
+        if (!ball.hit(r, 0.001, infinity, rec))
+            continue;
+        if (incoming.size() % 2)
+        {
+            rec.front_face = !rec.front_face;
+            rec.normal = -rec.normal;
+        }
+        incoming.push_back(r);
+        records.push_back(rec);
+    }
+    const std::pair<const char *, material> materials[] = {
+        {"lambertian::scatter", lambertian(color(0.5, 0.5, 0.5))},
+        {"metal::scatter", metal(color(0.7, 0.6, 0.5), 0.1)},
+        {"dielectric::scatter", dielectric(1.5)},
+    };
+    for (const auto &[name, mat] : materials)
+    {
+        results.push_back(time_calls(name, "ray", min_seconds, [&](size_t i)
+                                     {
+                                         color attenuation;
+                                         ray scattered;
+                                         bool kept = scatter(mat, incoming[i], records[i], attenuation, scattered);
+                                         return kept ? scattered.dir.x() : 0.0; }));
+    }
+
+    const vec3 normal(0, 1, 0);
+    results.push_back(time_calls("random_double", "sample", min_seconds, [&](size_t)
+                                 { return random_double(); }));
+    results.push_back(time_calls("random_unit_vector", "sample", min_seconds, [&](size_t)
+                                 { return random_unit_vector().x(); }));
+    results.push_back(time_calls("random_in_unit_sphere", "sample", min_seconds, [&](size_t)
+                                 { return random_in_unit_sphere().x(); }));
+    results.push_back(time_calls("random_in_hemisphere", "sample", min_seconds, [&](size_t)
+                                 { return random_in_hemisphere(normal).x(); }));
+    results.push_back(time_calls("random_in_unit_disk", "sample", min_seconds, [&](size_t)
+                                 { return random_in_unit_disk().x(); }));
+}
+
+// Forwards to a world and counts the rays traced against it. Each thread adds
+// to its own cache line, so the workers don't fight over one counter.
+class ray_counter : public hittable
+{
+public:
+    explicit ray_counter(const hittable &world) : world(world) {}
+
+    virtual bool hit(const ray &r, real t_min, real t_max, hit_record &rec) const override
+    {
+        slot().fetch_add(1, std::memory_order_relaxed);
+        return world.hit(r, t_min, t_max, rec);
+    }
+
+    virtual bool bounding_box(aabb &output_box) const override { return world.bounding_box(output_box); }
+
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override
+    {
+        uint64_t active = 0;
+        for (int lane = 0; lane < packet_size; lane++)
+            active += packet.active(lane);
+        slot().fetch_add(active, std::memory_order_relaxed);
+        world.hit_packet(packet, hit_objects);
+    }
+
+    uint64_t total() const
+    {
+        uint64_t sum = 0;
+        for (const counter &c : counters)
+            sum += c.rays.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static const int max_slots = 64;
+
+    struct alignas(64) counter
+    {
+        std::atomic<uint64_t> rays{0};
+    };
+
+    std::atomic<uint64_t> &slot() const
+    {
+        static std::atomic<int> next_thread{0};
+        thread_local int thread_index = next_thread++;
+        return counters[thread_index % max_slots].rays;
+    }
+
+    const hittable &world;
+    mutable counter counters[max_slots];
+};
+
+// Looks at the middle of the box from above and to the side, far enough back to see all of it
+static camera overview_camera(const aabb &bounds, double aspect_ratio)
+{
+    point3 centre = bounds.centroid();
+    double radius = 0.5 * (bounds.maximum - bounds.minimum).length();
+    point3 lookfrom = centre + 1.6 * radius * unit_vector(vec3(1, 0.8, 1.6));
+    return camera(lookfrom, centre, vec3(0, 1, 0), 45, aspect_ratio, 0, (centre - lookfrom).length());
+}
+
+// FNV-1a over the pixels, changes whenever a change to the renderer changes the image
+static uint64_t image_hash(const image &img)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t byte : img.pixels)
+        hash = (hash ^ byte) * 0x100000001b3ULL;
+    return hash;
+}
+
+static render_result render_scene(const std::string &name, const hittable_list &objects, const material_table &materials,
+                                  const camera &cam, const image &target, const suite_options &options)
+{
+    auto start = bench_clock::now();
+    flat_scene world(objects);
+    double build_seconds = seconds_since(start);
+
+    render_settings settings;
+    settings.samples_per_pixel = options.spp;
+    settings.num_threads = options.threads;
+    settings.seed = options.seed;
+    renderer tracer(settings);
+
+    image img(target.width, target.height);
+    ray_counter counted(world);
+    start = bench_clock::now();
+    tracer.render(counted, materials, cam, img);
+    double seconds = seconds_since(start);
+
+    size_t primitives = world.sphere_count() + world.triangle_count() + world.box_count() + world.quad_count() +
+                        world.disk_count();
+    render_result result{name, primitives, img.width, img.height,
+                         options.spp, tracer.num_threads(), build_seconds, seconds,
+                         static_cast<uint64_t>(img.width) * img.height * options.spp, counted.total(), image_hash(img)};
+    std::cerr << std::left << std::setw(16) << name << std::right << std::setw(10) << result.primitives
+              << std::fixed << std::setprecision(2) << std::setw(10) << result.rays / seconds / 1e6 << " Mray/s"
+              << std::setw(10) << seconds * 1e9 / result.rays << " ns/ray" << std::endl;
+    return result;
+}
+
+static void run_renders(const suite_options &options, std::vector<render_result> &results)
+{
+    image target(options.width, options.width * 9 / 16);
+    double aspect_ratio = static_cast<double>(target.width) / target.height;
+
+    thread_rng().seed(options.seed);
+    scene cover = random_scene();
+    results.push_back(render_scene("random_scene", cover.objects, cover.materials,
+                                   random_scene_camera(0, aspect_ratio), target, options));
+
+    material_table grey;
+    grey.add(lambertian(color(0.5, 0.5, 0.5)));
+    for (int count = 100; count <= options.max_primitives; count *= 10)
+    {
+        thread_rng().seed(options.seed);
+        hittable_list field = sphere_field(count);
+        aabb bounds;
+        field.bounding_box(bounds);
+        results.push_back(render_scene("sphere_field", field, grey, overview_camera(bounds, aspect_ratio), target, options));
+    }
+
+    for (int count = 100; count <= options.max_primitives; count *= 10)
+    {
+        thread_rng().seed(options.seed);
+        std::vector<point3> vertices;
+        std::vector<uint32_t> indices;
+        height_field(count, vertices, indices);
+        hittable_list terrain;
+        terrain.add(make_shared<triangle_mesh>(std::move(vertices), std::move(indices), 0));
+        aabb bounds;
+        terrain.bounding_box(bounds);
+        results.push_back(render_scene("height_field", terrain, grey, overview_camera(bounds, aspect_ratio), target, options));
+    }
+}
+
+static void write_json(std::ostream &out, const suite_options &options, int threads,
+                       const std::vector<micro_result> &micro, const std::vector<render_result> &renders)
+{
+    out << std::setprecision(6);
+    out << "{\n  \"build\": {\"real\": \"" << (sizeof(real) == sizeof(float) ? "float" : "double")
+        << "\", \"simd_width\": " << simd_width << ", \"packet_size\": " << packet_size
+        << ", \"threads\": " << threads << ", \"seed\": " << options.seed << "},\n";
+
+    out << "  \"micro\": [\n";
+    for (size_t i = 0; i < micro.size(); i++)
+    {
+        const micro_result &m = micro[i];
+        out << "    {\"name\": \"" << m.name << "\", \"calls\": " << m.calls << ", \"seconds\": " << m.seconds
+            << ", \"" << m.unit << "s_per_sec\": " << m.calls / m.seconds
+            << ", \"ns_per_" << m.unit << "\": " << m.seconds * 1e9 / m.calls << "}"
+            << (i + 1 < micro.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    // ns_per_ray is wall time over all threads, the inverse of the throughput
+    out << "  \"render\": [\n";
+    for (size_t i = 0; i < renders.size(); i++)
+    {
+        const render_result &r = renders[i];
+        std::ostringstream hash;
+        hash << std::hex << std::setw(16) << std::setfill('0') << r.image_hash;
+        out << "    {\"scene\": \"" << r.scene << "\", \"primitives\": " << r.primitives
+            << ", \"width\": " << r.width << ", \"height\": " << r.height << ", \"spp\": " << r.spp
+            << ", \"threads\": " << r.threads << ", \"build_seconds\": " << r.build_seconds
+            << ", \"seconds\": " << r.seconds << ", \"samples\": " << r.samples << ", \"rays\": " << r.rays
+            << ", \"rays_per_sec\": " << r.rays / r.seconds << ", \"ns_per_ray\": " << r.seconds * 1e9 / r.rays
+            << ", \"image_hash\": \"" << hash.str() << "\"}"
+            << (i + 1 < renders.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int run_suite(const suite_options &options)
+{
+    std::vector<micro_result> micro;
+    std::vector<render_result> renders;
+    run_micro(options, micro);
+    run_renders(options, renders);
+    int threads = renders.empty() ? 0 : renders.front().threads;
+
+    if (options.json == "-")
+    {
+        write_json(std::cout, options, threads, micro, renders);
+        return 0;
+    }
+
+    std::ofstream file(options.json);
+    write_json(file, options, threads, micro, renders);
+    if (!file)
+    {
+        std::cerr << "Failed to write " << options.json << std::endl;
+        return 1;
+    }
+    std::cerr << "Saved : " << options.json << std::endl;
+    return 0;
+}
@@ -0,0 +1,6 @@
+#include "math/random.hpp"
+
+pcg32& thread_rng() {
+    thread_local pcg32 rng;
+    return rng;
+}
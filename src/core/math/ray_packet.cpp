@@ -0,0 +1,245 @@
+#include "math/ray_packet.hpp"
+
+// The kernels mirror the scalar tests in sphere::hit, ray_triangle_intersection,
+// cube::hit and the planar shapes operation for operation, so both paths agree
+// on which primitive is closest.
+
+int sphere_hit_packet(ray_packet& packet, const point3& center, real radius) {
+    const vreal cx(center.e[0]), cy(center.e[1]), cz(center.e[2]);
+    const vreal rr(radius * radius);
+    const vreal t_min(packet.t_min);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal dx = vreal::load(packet.dx + i), dy = vreal::load(packet.dy + i), dz = vreal::load(packet.dz + i);
+        vreal ocx = vreal::load(packet.ox + i) - cx;
+        vreal ocy = vreal::load(packet.oy + i) - cy;
+        vreal ocz = vreal::load(packet.oz + i) - cz;
+        vreal t_max = vreal::load(packet.t_max + i);
+
+        vreal a = dx * dx + dy * dy + dz * dz;
+        vreal half_b = ocx * dx + ocy * dy + ocz * dz;
+        vreal c = (ocx * ocx + ocy * ocy + ocz * ocz) - rr;
+        vreal discriminant = half_b * half_b - a * c;
+        vmask valid = discriminant >= vreal(0.0);
+        if (valid.bits() == 0)
+            continue;
+
+        vreal sqrtd = vsqrt(vmax(discriminant, vreal(0.0)));
+        vreal near_root = (vreal(0.0) - half_b - sqrtd) / a;
+        vreal far_root = (vreal(0.0) - half_b + sqrtd) / a;
+
+        vmask near_ok = valid & (near_root >= t_min) & (near_root <= t_max);
+        vmask far_ok = andnot(near_ok, valid & (far_root >= t_min) & (far_root <= t_max));
+        vmask hit = near_ok | far_ok;
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, select(near_ok, near_root, far_root), t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+int triangle_hit_packet(ray_packet& packet, const point3& v0, const vec3& edge1, const vec3& edge2) {
+    const vreal e1x(edge1.e[0]), e1y(edge1.e[1]), e1z(edge1.e[2]);
+    const vreal e2x(edge2.e[0]), e2y(edge2.e[1]), e2z(edge2.e[2]);
+    const vreal vx(v0.e[0]), vy(v0.e[1]), vz(v0.e[2]);
+    const vreal t_min(packet.t_min);
+    const vreal zero(0.0), one(1.0);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal dx = vreal::load(packet.dx + i), dy = vreal::load(packet.dy + i), dz = vreal::load(packet.dz + i);
+
+        // Möller-Trumbore
+        vreal hx = dy * e2z - dz * e2y;
+        vreal hy = dz * e2x - dx * e2z;
+        vreal hz = dx * e2y - dy * e2x;
+        vreal a = e1x * hx + e1y * hy + e1z * hz;
+        // Only a ray in the plane of the triangle is rejected, a grows with the
+        // edges and the direction, so any epsilon would drop small triangles
+        vmask valid = (a < zero) | (a > zero);
+
+        vreal f = one / a;
+        vreal sx = vreal::load(packet.ox + i) - vx;
+        vreal sy = vreal::load(packet.oy + i) - vy;
+        vreal sz = vreal::load(packet.oz + i) - vz;
+        vreal u = f * (sx * hx + sy * hy + sz * hz);
+        valid = valid & (u >= zero) & (u <= one);
+        if (valid.bits() == 0)
+            continue;
+
+        vreal qx = sy * e1z - sz * e1y;
+        vreal qy = sz * e1x - sx * e1z;
+        vreal qz = sx * e1y - sy * e1x;
+        vreal v = f * (dx * qx + dy * qy + dz * qz);
+        valid = valid & (v >= zero) & (u + v <= one);
+
+        vreal t = f * (e2x * qx + e2y * qy + e2z * qz);
+        vreal t_max = vreal::load(packet.t_max + i);
+        vmask hit = valid & (t > t_min) & (t < t_max);
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, t, t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+int cube_hit_packet(ray_packet& packet, const affine_transform& to_local) {
+    const affine_transform& m = to_local;
+    const vreal t_min(packet.t_min), one(1.0), minus_one(-1.0);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal ox = vreal::load(packet.ox + i), oy = vreal::load(packet.oy + i), oz = vreal::load(packet.oz + i);
+        vreal dx = vreal::load(packet.dx + i), dy = vreal::load(packet.dy + i), dz = vreal::load(packet.dz + i);
+
+        // The ray in the frame of the box, where it spans [-1, 1] on every axis
+        vreal near[3], far[3];
+        for (int a = 0; a < 3; a++) {
+            vreal o = vreal(m.m[a][0]) * ox + vreal(m.m[a][1]) * oy + vreal(m.m[a][2]) * oz + vreal(m.m[a][3]);
+            vreal d = vreal(m.m[a][0]) * dx + vreal(m.m[a][1]) * dy + vreal(m.m[a][2]) * dz;
+            vreal t0 = (minus_one - o) / d;
+            vreal t1 = (one - o) / d;
+            near[a] = vmin(t0, t1);
+            far[a] = vmax(t0, t1);
+        }
+        vreal enter = vmax(vmax(near[0], near[1]), near[2]);
+        vreal exit = vmin(vmin(far[0], far[1]), far[2]);
+
+        // A ray that starts inside leaves through the far side
+        vreal t = select(enter > t_min, enter, exit);
+        vreal t_max = vreal::load(packet.t_max + i);
+        vmask hit = (enter <= exit) & (t > t_min) & (t < t_max);
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, t, t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+// Distance along the rays of lanes i to i + simd_width to the plane, infinite
+// or NaN for rays parallel to it, and the points they reach
+static inline vreal plane_distance(const ray_packet& packet, int i, const vec3& normal, real offset,
+                                   vreal& px, vreal& py, vreal& pz) {
+    const vreal nx(normal.e[0]), ny(normal.e[1]), nz(normal.e[2]);
+    vreal ox = vreal::load(packet.ox + i), oy = vreal::load(packet.oy + i), oz = vreal::load(packet.oz + i);
+    vreal dx = vreal::load(packet.dx + i), dy = vreal::load(packet.dy + i), dz = vreal::load(packet.dz + i);
+    vreal t = (vreal(offset) - (nx * ox + ny * oy + nz * oz)) / (nx * dx + ny * dy + nz * dz);
+    px = ox + t * dx;
+    py = oy + t * dy;
+    pz = oz + t * dz;
+    return t;
+}
+
+int plane_hit_packet(ray_packet& packet, const vec3& normal, real offset) {
+    const vreal t_min(packet.t_min);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal px, py, pz;
+        vreal t = plane_distance(packet, i, normal, offset, px, py, pz);
+        vreal t_max = vreal::load(packet.t_max + i);
+        vmask hit = (t > t_min) & (t < t_max);
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, t, t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+int quad_hit_packet(ray_packet& packet, const vec3& normal, real offset,
+                    const point3& corner, const vec3& alpha_axis, const vec3& beta_axis) {
+    const vreal qx(corner.e[0]), qy(corner.e[1]), qz(corner.e[2]);
+    const vreal ax(alpha_axis.e[0]), ay(alpha_axis.e[1]), az(alpha_axis.e[2]);
+    const vreal bx(beta_axis.e[0]), by(beta_axis.e[1]), bz(beta_axis.e[2]);
+    const vreal t_min(packet.t_min), zero(0.0), one(1.0);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal px, py, pz;
+        vreal t = plane_distance(packet, i, normal, offset, px, py, pz);
+        vreal t_max = vreal::load(packet.t_max + i);
+        vmask valid = (t > t_min) & (t < t_max);
+        if (valid.bits() == 0)
+            continue;
+
+        vreal rx = px - qx, ry = py - qy, rz = pz - qz;
+        vreal alpha = rx * ax + ry * ay + rz * az;
+        vreal beta = rx * bx + ry * by + rz * bz;
+        vmask hit = valid & (alpha >= zero) & (alpha <= one) & (beta >= zero) & (beta <= one);
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, t, t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+int disk_hit_packet(ray_packet& packet, const vec3& normal, real offset, const point3& center, real radius) {
+    const vreal cx(center.e[0]), cy(center.e[1]), cz(center.e[2]);
+    const vreal rr(radius * radius);
+    const vreal t_min(packet.t_min);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal px, py, pz;
+        vreal t = plane_distance(packet, i, normal, offset, px, py, pz);
+        vreal t_max = vreal::load(packet.t_max + i);
+        vmask valid = (t > t_min) & (t < t_max);
+        if (valid.bits() == 0)
+            continue;
+
+        vreal rx = px - cx, ry = py - cy, rz = pz - cz;
+        vmask hit = valid & (rx * rx + ry * ry + rz * rz <= rr);
+        int bits = hit.bits();
+        if (bits == 0)
+            continue;
+
+        select(hit, t, t_max).store(packet.t_max + i);
+        hits |= bits << i;
+    }
+
+    return hits;
+}
+
+int box_hit_packet(const ray_packet& packet, const point3& box_min, const point3& box_max) {
+    const vreal minx(box_min.e[0]), miny(box_min.e[1]), minz(box_min.e[2]);
+    const vreal maxx(box_max.e[0]), maxy(box_max.e[1]), maxz(box_max.e[2]);
+    const vreal t_min(packet.t_min);
+    int hits = 0;
+
+    for (int i = 0; i < packet_size; i += simd_width) {
+        vreal ox = vreal::load(packet.ox + i), oy = vreal::load(packet.oy + i), oz = vreal::load(packet.oz + i);
+        vreal ix = vreal::load(packet.inv_dx + i), iy = vreal::load(packet.inv_dy + i), iz = vreal::load(packet.inv_dz + i);
+
+        vreal tx0 = (minx - ox) * ix, tx1 = (maxx - ox) * ix;
+        vreal ty0 = (miny - oy) * iy, ty1 = (maxy - oy) * iy;
+        vreal tz0 = (minz - oz) * iz, tz1 = (maxz - oz) * iz;
+
+        vreal t_near = vmax(vmax(vmin(tx0, tx1), vmin(ty0, ty1)), vmax(vmin(tz0, tz1), t_min));
+        vreal t_far = vmin(vmin(vmax(tx0, tx1), vmax(ty0, ty1)), vmin(vmax(tz0, tz1), vreal::load(packet.t_max + i)));
+
+        hits |= (t_near <= t_far).bits() << i;
+    }
+
+    return hits;
+}
@@ -0,0 +1,282 @@
+#include "math/sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+uint32_t hash_seed(uint64_t seed, uint32_t dimension, uint32_t which) {
+    return static_cast<uint32_t>(mix_bits(seed ^ mix_bits((static_cast<uint64_t>(dimension) << 8) | which)));
+}
+
+double to_unit(uint32_t bits) {
+    return bits * (1.0 / 4294967296.0);
+}
+
+uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Hash that only lets each bit depend on the bits below it, so on reversed
+// bits it permutes every level of the binary tree of intervals (Burley 2020)
+uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+// Owen scrambling: randomizes the points and keeps their stratification
+uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+// The first two Sobol dimensions. The first is the van der Corput sequence.
+uint32_t sobol(uint32_t index, int dimension) {
+    if (dimension == 0)
+        return reverse_bits(index);
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+        if (index & 1)
+            result ^= v;
+    return result;
+}
+
+// Point index of one Sobol pair. Shuffling the indices with a different seed
+// for every pair decorrelates the pairs of one path from each other.
+void sobol_2d(uint32_t index, uint64_t seed, uint32_t dimension, double& u, double& v) {
+    uint32_t shuffled = nested_uniform_scramble(index, hash_seed(seed, dimension, 0));
+    u = to_unit(nested_uniform_scramble(sobol(shuffled, 0), hash_seed(seed, dimension, 1)));
+    v = to_unit(nested_uniform_scramble(sobol(shuffled, 1), hash_seed(seed, dimension, 2)));
+}
+
+double sobol_1d(uint32_t index, uint64_t seed, uint32_t dimension) {
+    uint32_t shuffled = nested_uniform_scramble(index, hash_seed(seed, dimension, 0));
+    return to_unit(nested_uniform_scramble(sobol(shuffled, 0), hash_seed(seed, dimension, 1)));
+}
+
+// Permutation of [0, l) picked by p, from "Correlated Multi-Jittered Sampling" (Kensler 2013)
+uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;
+        i *= 0xe170893du;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3fu;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+    return (i + p) % l;
+}
+
+double randfloat(uint32_t i, uint32_t p) {
+    i ^= p;
+    i ^= i >> 17;
+    i ^= i >> 10;
+    i *= 0xb36534e5u;
+    i ^= i >> 12;
+    i ^= i >> 21;
+    i *= 0x93fc4795u;
+    i ^= 0xdf6e307fu;
+    i ^= i >> 17;
+    i *= 1 | p >> 18;
+    return to_unit(i);
+}
+
+// Sample s of a pattern of n points, one per cell of an m by ceil(n/m) grid
+// and one per row and column of its n by n subgrid
+void cmj_2d(uint32_t s, uint32_t n, uint32_t p, double& u, double& v) {
+    uint32_t m = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(n))));
+    uint32_t rows = (n + m - 1) / m;
+    s = permute(s, n, p * 0x51633e2du);
+    uint32_t sx = permute(s % m, m, p * 0x68bc21ebu);
+    uint32_t sy = permute(s / m, rows, p * 0x02e5be93u);
+    double jx = randfloat(s, p * 0x967a889bu);
+    double jy = randfloat(s, p * 0x368cc8b7u);
+    u = (sx + (sy + jx) / rows) / m;
+    v = (s + jy) / n;
+}
+
+double cmj_1d(uint32_t s, uint32_t n, uint32_t p) {
+    return (permute(s, n, p * 0x51633e2du) + randfloat(s, p * 0x967a889bu)) / n;
+}
+
+// Rank of every texel of a tileable blue noise texture, made with the
+// void-and-cluster method (Ulichney 1993). A texel's value is its rank over the
+// texel count, so every value appears once and close values lie far apart.
+const int mask_size = 64;
+
+std::vector<float> make_blue_noise_mask() {
+    const int n = mask_size * mask_size;
+    const double sigma = 1.5;
+    const int reach = 6; // The filter is below 1e-3 further out
+
+    std::vector<double> filter((2 * reach + 1) * (2 * reach + 1));
+    for (int dy = -reach; dy <= reach; dy++)
+        for (int dx = -reach; dx <= reach; dx++)
+            filter[(dy + reach) * (2 * reach + 1) + dx + reach] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+
+    // energy is the filtered image of the set texels
+    std::vector<char> set(n, 0);
+    std::vector<double> energy(n, 0.0);
+    auto toggle = [&](int i) {
+        set[i] = !set[i];
+        double sign = set[i] ? 1.0 : -1.0;
+        int x = i % mask_size, y = i / mask_size;
+        for (int dy = -reach; dy <= reach; dy++)
+            for (int dx = -reach; dx <= reach; dx++) {
+                int tx = (x + dx + mask_size) % mask_size, ty = (y + dy + mask_size) % mask_size;
+                energy[ty * mask_size + tx] += sign * filter[(dy + reach) * (2 * reach + 1) + dx + reach];
+            }
+    };
+    auto tightest_cluster = [&] {
+        int best = -1;
+        for (int i = 0; i < n; i++)
+            if (set[i] && (best < 0 || energy[i] > energy[best]))
+                best = i;
+        return best;
+    };
+    auto largest_void = [&] {
+        int best = -1;
+        for (int i = 0; i < n; i++)
+            if (!set[i] && (best < 0 || energy[i] < energy[best]))
+                best = i;
+        return best;
+    };
+
+    // A tenth of the texels at random, then moved from their tightest cluster
+    // to the largest void until that doesn't change anything
+    pcg32 rng(0x5eed, 0xb10e);
+    int initial = 0;
+    while (initial < n / 10) {
+        int i = static_cast<int>(rng.next_uint() % n);
+        if (!set[i]) {
+            toggle(i);
+            initial++;
+        }
+    }
+    for (int iteration = 0; iteration < n; iteration++) {
+        int cluster = tightest_cluster();
+        toggle(cluster);
+        int hole = largest_void();
+        toggle(hole);
+        if (hole == cluster)
+            break;
+    }
+
+    std::vector<int> rank(n, 0);
+    const std::vector<char> initial_set = set;
+    const std::vector<double> initial_energy = energy;
+    for (int r = initial - 1; r >= 0; r--) {
+        int cluster = tightest_cluster();
+        toggle(cluster);
+        rank[cluster] = r;
+    }
+    set = initial_set;
+    energy = initial_energy;
+    for (int r = initial; r < n; r++) {
+        int hole = largest_void();
+        toggle(hole);
+        rank[hole] = r;
+    }
+
+    std::vector<float> mask(n);
+    for (int i = 0; i < n; i++)
+        mask[i] = (rank[i] + 0.5f) / n;
+    return mask;
+}
+
+const std::vector<float>& blue_noise_mask() {
+    static const std::vector<float> mask = make_blue_noise_mask();
+    return mask;
+}
+
+// Shift of the pixel for one coordinate of one dimension. Each coordinate reads
+// the mask at its own offset, so the shifts of different dimensions don't line up.
+double blue_noise_shift(uint32_t x, uint32_t y, uint64_t seed, uint32_t dimension, uint32_t which) {
+    uint32_t h = hash_seed(seed, dimension, which);
+    uint32_t mx = (x + h) % mask_size, my = (y + (h >> 16)) % mask_size;
+    return blue_noise_mask()[my * mask_size + mx];
+}
+
+double wrap(double u) {
+    return u >= 1.0 ? u - 1.0 : u;
+}
+
+} // namespace
+
+pixel_sampler& thread_sampler() {
+    thread_local pixel_sampler sampler;
+    return sampler;
+}
+
+void pixel_sampler::start(sampler_type type, int x, int y, int sample_index, int sample_count, uint64_t seed) {
+    this->type = type;
+    this->x = static_cast<uint32_t>(x);
+    this->y = static_cast<uint32_t>(y);
+    index = static_cast<uint32_t>(sample_index);
+    count = static_cast<uint32_t>(std::max(sample_count, 1));
+    this->seed = seed;
+    pixel_seed = mix_bits(seed ^ mix_bits((static_cast<uint64_t>(this->y) << 32) | this->x));
+    dimension = 0;
+}
+
+double pixel_sampler::next_1d() {
+    uint32_t d = dimension++;
+    switch (type) {
+    case sampler_type::stratified:
+        return cmj_1d(index % count, count, hash_seed(pixel_seed ^ (index / count), d, 3));
+    case sampler_type::sobol:
+        return sobol_1d(index, pixel_seed, d);
+    case sampler_type::blue_noise:
+        return wrap(sobol_1d(index, seed, d) + blue_noise_shift(x, y, seed, d, 4));
+    case sampler_type::independent:
+        break;
+    }
+    return random_double();
+}
+
+void pixel_sampler::next_2d(double& u, double& v) {
+    uint32_t d = dimension++;
+    switch (type) {
+    case sampler_type::stratified:
+        cmj_2d(index % count, count, hash_seed(pixel_seed ^ (index / count), d, 3), u, v);
+        return;
+    case sampler_type::sobol:
+        sobol_2d(index, pixel_seed, d, u, v);
+        return;
+    case sampler_type::blue_noise:
+        sobol_2d(index, seed, d, u, v);
+        u = wrap(u + blue_noise_shift(x, y, seed, d, 4));
+        v = wrap(v + blue_noise_shift(x, y, seed, d, 5));
+        return;
+    case sampler_type::independent:
+        break;
+    }
+    u = random_double();
+    v = random_double();
+}
@@ -0,0 +1,35 @@
+#include "utils/accumulation_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+double accumulation_buffer::variance(int x, int y) const
+{
+    size_t i = static_cast<size_t>(y) * width + x;
+    double n = counts[i];
+    if (n < 2)
+        return std::numeric_limits<double>::infinity();
+
+    double mean = luminance(sum(x, y)) / n;
+    return std::max(0.0, (luminance_sq[i] - n * mean * mean) / (n - 1)) / n;
+}
+
+double accumulation_buffer::relative_error(int x, int y) const
+{
+    double n = count(x, y);
+    if (n < 2)
+        return std::numeric_limits<double>::infinity();
+
+    double mean = luminance(sum(x, y)) / n;
+    // The small offset keeps near black pixels from demanding samples forever
+    return std::sqrt(variance(x, y)) / (mean + 1e-3);
+}
+
+uint64_t accumulation_buffer::total_samples() const
+{
+    uint64_t total = 0;
+    for (uint32_t c : counts)
+        total += c;
+    return total;
+}
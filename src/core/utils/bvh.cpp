@@ -0,0 +1,330 @@
+#include "utils/bvh.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+#include <algorithm>
+
+bvh::bvh(const std::vector<shared_ptr<hittable>>& objects, int max_leaf_size) {
+    std::vector<bvh_primitive> prims;
+    prims.reserve(objects.size());
+
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        aabb box;
+        if (!objects[i]->bounding_box(box)) {
+            unbounded.push_back(objects[i]);
+            continue;
+        }
+        prims.push_back({box, box.centroid(), i});
+    }
+
+    if (prims.empty())
+        return;
+
+    nodes = build_bvh(prims, max_leaf_size);
+
+    primitives.reserve(prims.size());
+    for (const auto& prim : prims)
+        primitives.push_back(objects[prim.index]);
+}
+
+static void build_node(std::vector<bvh_node>& nodes, std::vector<bvh_primitive>& prims,
+                       uint32_t begin, uint32_t end, int depth, int max_leaf_size, double traversal_cost) {
+    const int max_depth = bvh::max_depth;
+    const int bin_count = bvh::bin_count;
+
+    uint32_t node_index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(bvh_node());
+
+    aabb bounds, centroid_bounds;
+    for (uint32_t i = begin; i < end; i++) {
+        bounds.expand(prims[i].box);
+        centroid_bounds.expand(prims[i].centroid);
+    }
+    nodes[node_index].box = bounds;
+
+    uint32_t count = end - begin;
+    auto make_leaf = [&]() {
+        nodes[node_index].offset = begin;
+        nodes[node_index].count = count;
+        nodes[node_index].axis = 0;
+    };
+
+    if (count <= 1 || depth >= max_depth - 1) {
+        make_leaf();
+        return;
+    }
+
+    // Bin the centroids along every axis and sweep the bin boundaries for the cheapest split
+    struct bin {
+        aabb box;
+        uint32_t count = 0;
+    };
+
+    int best_axis = -1;
+    int best_split = 0;
+    double best_cost = infinity;
+    double parent_area = bounds.surface_area();
+
+    for (int axis = 0; axis < 3; axis++) {
+        double lo = centroid_bounds.minimum.e[axis];
+        double extent = centroid_bounds.maximum.e[axis] - lo;
+        if (extent <= 0.0)
+            continue;
+
+        bin bins[bin_count];
+        double scale = bin_count / extent;
+        for (uint32_t i = begin; i < end; i++) {
+            int b = std::min(bin_count - 1, static_cast<int>((prims[i].centroid.e[axis] - lo) * scale));
+            bins[b].count++;
+            bins[b].box.expand(prims[i].box);
+        }
+
+        double left_area[bin_count - 1];
+        uint32_t left_count[bin_count - 1];
+        aabb left_box;
+        uint32_t left_sum = 0;
+        for (int b = 0; b < bin_count - 1; b++) {
+            left_box.expand(bins[b].box);
+            left_sum += bins[b].count;
+            left_area[b] = left_box.surface_area();
+            left_count[b] = left_sum;
+        }
+
+        aabb right_box;
+        uint32_t right_sum = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            right_box.expand(bins[b].box);
+            right_sum += bins[b].count;
+            if (left_count[b - 1] == 0 || right_sum == 0)
+                continue;
+            double cost = traversal_cost + (left_area[b - 1] * left_count[b - 1] + right_box.surface_area() * right_sum) / parent_area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // All centroids coincide, there is nothing to split on
+    if (best_axis < 0) {
+        make_leaf();
+        return;
+    }
+
+    if (count <= static_cast<uint32_t>(max_leaf_size) && best_cost >= count) {
+        make_leaf();
+        return;
+    }
+
+    double lo = centroid_bounds.minimum.e[best_axis];
+    double scale = bin_count / (centroid_bounds.maximum.e[best_axis] - lo);
+    auto mid_it = std::partition(prims.begin() + begin, prims.begin() + end, [&](const bvh_primitive& p) {
+        int b = std::min(bin_count - 1, static_cast<int>((p.centroid.e[best_axis] - lo) * scale));
+        return b < best_split;
+    });
+    uint32_t mid = static_cast<uint32_t>(mid_it - prims.begin());
+
+    // Guard against floating point disagreement between binning passes
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+            [&](const bvh_primitive& a, const bvh_primitive& b) {
+                return a.centroid.e[best_axis] < b.centroid.e[best_axis];
+            });
+    }
+
+    build_node(nodes, prims, begin, mid, depth + 1, max_leaf_size, traversal_cost);
+    uint32_t second_child = static_cast<uint32_t>(nodes.size());
+    build_node(nodes, prims, mid, end, depth + 1, max_leaf_size, traversal_cost);
+
+    nodes[node_index].offset = second_child;
+    nodes[node_index].count = 0;
+    nodes[node_index].axis = static_cast<uint32_t>(best_axis);
+}
+
+std::vector<bvh_node> build_bvh(std::vector<bvh_primitive>& prims, int max_leaf_size, double traversal_cost) {
+    std::vector<bvh_node> nodes;
+    if (prims.empty())
+        return nodes;
+    nodes.reserve(2 * prims.size());
+    build_node(nodes, prims, 0, static_cast<uint32_t>(prims.size()), 0, max_leaf_size, traversal_cost);
+    return nodes;
+}
+
+bool bvh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    hit_record temp_rec;
+    bool hit_anything = false;
+    real closest_so_far = t_max;
+
+    for (const auto& object : unbounded) {
+        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+            hit_anything = true;
+            closest_so_far = temp_rec.t;
+            rec = temp_rec;
+        }
+    }
+
+    if (nodes.empty())
+        return hit_anything;
+
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    const vec3 inv_dir(1.0 / dir.e[0], 1.0 / dir.e[1], 1.0 / dir.e[2]);
+    const bool dir_is_neg[3] = {inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0};
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real t_enter;
+    uint64_t boxes = 0;
+
+    while (true) {
+        const bvh_node& node = nodes[current];
+        boxes++;
+        if (node.box.hit(origin, inv_dir, t_min, closest_so_far, t_enter)) {
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                    if (primitives[i]->hit(r, t_min, closest_so_far, temp_rec)) {
+                        hit_anything = true;
+                        closest_so_far = temp_rec.t;
+                        rec = temp_rec;
+                    }
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (dir_is_neg[node.axis]) {
+                // The second child holds the larger coordinates, so it is nearer
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            } else {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    return hit_anything;
+}
+
+bool bvh::occluded(const ray& r, real t_min, real t_max) const {
+    for (const auto& object : unbounded) {
+        if (object->occluded(r, t_min, t_max))
+            return true;
+    }
+
+    if (nodes.empty())
+        return false;
+
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    const vec3 inv_dir(1.0 / dir.e[0], 1.0 / dir.e[1], 1.0 / dir.e[2]);
+    const bool dir_is_neg[3] = {inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0};
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real t_enter;
+    uint64_t boxes = 0;
+    bool blocked = false;
+
+    // Any hit will do, the nearer child still goes first to find one sooner
+    while (!blocked) {
+        const bvh_node& node = nodes[current];
+        boxes++;
+        if (node.box.hit(origin, inv_dir, t_min, t_max, t_enter)) {
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count && !blocked; i++)
+                    blocked = primitives[i]->occluded(r, t_min, t_max);
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (dir_is_neg[node.axis]) {
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            } else {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    return blocked;
+}
+
+void bvh::add_lights(light_list& lights) const {
+    for (const auto& object : primitives)
+        object->add_lights(lights);
+    for (const auto& object : unbounded)
+        object->add_lights(lights);
+}
+
+void bvh::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    for (const auto& object : unbounded)
+        object->hit_packet(packet, hit_objects);
+
+    if (nodes.empty())
+        return;
+
+    // The whole packet follows the child order of its first active ray,
+    // which suits the coherent packets this path is meant for
+    int first = 0;
+    while (first < packet_size && !packet.active(first))
+        first++;
+    if (first == packet_size)
+        return;
+    const bool dir_is_neg[3] = {packet.inv_dx[first] < 0, packet.inv_dy[first] < 0, packet.inv_dz[first] < 0};
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    uint64_t boxes = 0;
+
+    while (true) {
+        const bvh_node& node = nodes[current];
+        boxes += packet_size;
+        if (box_hit_packet(packet, node.box.minimum, node.box.maximum)) {
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                    primitives[i]->hit_packet(packet, hit_objects);
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (dir_is_neg[node.axis]) {
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            } else {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+}
+
+bool bvh::bounding_box(aabb& output_box) const {
+    if (nodes.empty() || !unbounded.empty())
+        return false;
+    output_box = nodes[0].box;
+    return true;
+}
+
+int bvh::depth() const {
+    return nodes.empty() ? 0 : subtree_depth(0);
+}
+
+int bvh::subtree_depth(uint32_t node) const {
+    if (nodes[node].count > 0)
+        return 1;
+    return 1 + std::max(subtree_depth(node + 1), subtree_depth(nodes[node].offset));
+}
@@ -34,4 +34,17 @@ ray camera::get_ray(double s, double t) const
     return ray(
         origin + offset,
         lower_left_corner + s * horizontal + t * vertical - origin - offset);
-}
\ No newline at end of file
+}
+
+bool camera::operator==(const camera& other) const
+{
+    return origin == other.origin && lower_left_corner == other.lower_left_corner &&
+           horizontal == other.horizontal && vertical == other.vertical &&
+           u == other.u && v == other.v && w == other.w && lens_radius == other.lens_radius;
+}
+
+camera camera_settings::make(double aspect_ratio) const
+{
+    double focus = focus_dist > 0 ? focus_dist : (lookat - lookfrom).length();
+    return camera(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, focus);
+}
@@ -0,0 +1,328 @@
+#include "utils/compiled_scene.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+static const char compiled_scene_magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+static const uint32_t compiled_scene_version = 5;
+static const uint32_t byte_order_mark = 0x01020304;
+// Every buffer starts on a cache line of the mapping
+static const uint64_t buffer_alignment = 64;
+static const int buffer_count = 70;
+
+// A material independent of the layout of the material variant
+struct material_record {
+    uint32_t type; // Index of the alternative in the material variant
+    uint32_t unused;
+    double albedo[3]; // Or the radiance a light gives off
+    double param; // Fuzz of a metal, index of refraction of a dielectric
+};
+
+struct compiled_scene_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t real_size;
+    uint32_t node_size;
+    uint32_t max_leaf_size;
+    uint32_t has_view;
+    double view[12]; // lookfrom, lookat, vup, vfov, aperture, focus_dist
+    uint64_t material_offset, material_count;
+    uint64_t buffers[buffer_count][2]; // Offset in the file and number of values
+};
+
+static_assert(std::is_trivially_copyable<bvh_node>::value, "bvh nodes are stored as raw bytes");
+
+// Calls f on every view of world, in the order of the buffers in the file
+template <typename Scene, typename F>
+static void for_each_buffer(Scene &world, F f)
+{
+    auto &s = world.spheres;
+    auto &t = world.triangles;
+    auto &b = world.boxes;
+    auto &q = world.quads;
+    auto &d = world.disks;
+    auto &p = world.planes;
+    f(s.cx); f(s.cy); f(s.cz); f(s.radius); f(s.mat_id);
+    f(t.v0x); f(t.v0y); f(t.v0z); f(t.e1x); f(t.e1y); f(t.e1z); f(t.e2x); f(t.e2y); f(t.e2z);
+    f(t.nx); f(t.ny); f(t.nz); f(t.mat_id);
+    for (auto &values : b.m)
+        f(values);
+    f(b.mat_id);
+    f(q.qx); f(q.qy); f(q.qz); f(q.nx); f(q.ny); f(q.nz); f(q.offset);
+    f(q.ax); f(q.ay); f(q.az); f(q.bx); f(q.by); f(q.bz);
+    f(q.ux); f(q.uy); f(q.uz); f(q.vx); f(q.vy); f(q.vz); f(q.mat_id);
+    f(d.cx); f(d.cy); f(d.cz); f(d.nx); f(d.ny); f(d.nz); f(d.offset); f(d.radius); f(d.mat_id);
+    f(p.nx); f(p.ny); f(p.nz); f(p.offset); f(p.mat_id);
+    f(world.sphere_nodes); f(world.triangle_nodes); f(world.box_nodes); f(world.quad_nodes);
+    f(world.disk_nodes);
+}
+
+static_assert(std::variant_size<material>::value == 4, "store and read back every material type");
+
+static material_record make_record(const material &m)
+{
+    material_record record = {};
+    record.type = static_cast<uint32_t>(m.index());
+    color albedo(0, 0, 0);
+    if (auto l = std::get_if<lambertian>(&m))
+        albedo = l->albedo;
+    else if (auto mt = std::get_if<metal>(&m))
+    {
+        albedo = mt->albedo;
+        record.param = mt->fuzz;
+    }
+    else if (auto d = std::get_if<dielectric>(&m))
+        record.param = d->ir;
+    else if (auto light = std::get_if<diffuse_light>(&m))
+        albedo = light->emit;
+    for (int i = 0; i < 3; i++)
+        record.albedo[i] = albedo.e[i];
+    return record;
+}
+
+static bool read_record(const material_record &record, material_table &materials)
+{
+    color albedo(record.albedo[0], record.albedo[1], record.albedo[2]);
+    switch (record.type)
+    {
+    case 0: materials.add(lambertian(albedo)); return true;
+    case 1: materials.add(metal(albedo, record.param)); return true;
+    case 2: materials.add(dielectric(record.param)); return true;
+    case 3: materials.add(diffuse_light(albedo)); return true;
+    default: return false;
+    }
+}
+
+template <typename T>
+static void write_values(std::ofstream &file, const array_view<T> &values)
+{
+    file.write(reinterpret_cast<const char *>(values.data), values.size() * sizeof(T));
+}
+
+// Nodes go out a block at a time through zeroed copies, so that the padding
+// bytes of the struct don't make two compilations of a scene differ
+static void write_values(std::ofstream &file, const array_view<bvh_node> &values)
+{
+    const size_t block = 4096;
+    std::vector<bvh_node> clean(block);
+    for (size_t start = 0; start < values.size(); start += block)
+    {
+        size_t count = std::min(block, values.size() - start);
+        std::memset(static_cast<void *>(clean.data()), 0, count * sizeof(bvh_node));
+        for (size_t i = 0; i < count; i++)
+        {
+            clean[i].box = values[start + i].box;
+            clean[i].offset = values[start + i].offset;
+            clean[i].count = values[start + i].count;
+            clean[i].axis = values[start + i].axis;
+        }
+        file.write(reinterpret_cast<const char *>(clean.data()), count * sizeof(bvh_node));
+    }
+}
+
+bool is_compiled_scene(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(compiled_scene_magic)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, compiled_scene_magic, sizeof(magic)) == 0;
+}
+
+bool save_compiled_scene(const std::string &path, const flat_scene &world, const material_table &materials,
+                         const std::optional<camera_settings> &view)
+{
+    if (!world.others.nodes.empty() || !world.others.unbounded.empty())
+    {
+        std::cerr << "Cannot compile " << path << ": the scene holds objects that the flat backend can't flatten" << std::endl;
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    compiled_scene_header header = {};
+    std::memcpy(header.magic, compiled_scene_magic, sizeof(header.magic));
+    header.version = compiled_scene_version;
+    header.byte_order = byte_order_mark;
+    header.real_size = sizeof(real);
+    header.node_size = sizeof(bvh_node);
+    header.max_leaf_size = flat_scene::max_leaf_size;
+    if (view)
+    {
+        header.has_view = 1;
+        const vec3 *vectors[] = {&view->lookfrom, &view->lookat, &view->vup};
+        for (int v = 0; v < 3; v++)
+            for (int i = 0; i < 3; i++)
+                header.view[v * 3 + i] = vectors[v]->e[i];
+        header.view[9] = view->vfov;
+        header.view[10] = view->aperture;
+        header.view[11] = view->focus_dist;
+    }
+
+    // Lay out the file first, so that the header can be written before the buffers
+    uint64_t end = sizeof(header);
+    auto next_aligned = [&](uint64_t bytes)
+    {
+        uint64_t offset = (end + buffer_alignment - 1) / buffer_alignment * buffer_alignment;
+        end = offset + bytes;
+        return offset;
+    };
+    header.material_count = materials.size();
+    header.material_offset = next_aligned(materials.size() * sizeof(material_record));
+    int index = 0;
+    for_each_buffer(world, [&](const auto &values)
+                    {
+        header.buffers[index][0] = next_aligned(values.size() * sizeof(values[0]));
+        header.buffers[index][1] = values.size();
+        index++; });
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    auto pad_to = [&](uint64_t offset)
+    {
+        static const char zeros[buffer_alignment] = {};
+        file.write(zeros, offset - written);
+        written = offset;
+    };
+
+    pad_to(header.material_offset);
+    for (const material &m : materials.materials)
+    {
+        material_record record = make_record(m);
+        file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+    written += materials.size() * sizeof(material_record);
+
+    index = 0;
+    for_each_buffer(world, [&](const auto &values)
+                    {
+        pad_to(header.buffers[index++][0]);
+        write_values(file, values);
+        written += values.size() * sizeof(values[0]); });
+
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool load_compiled_scene(const std::string &path, flat_scene &world, material_table &materials,
+                         std::optional<camera_settings> &view)
+{
+    auto file = mapped_file::open(path);
+    if (!file)
+        return false;
+    auto fail = [&](const char *reason)
+    {
+        std::cerr << "Could not load " << path << ": " << reason << std::endl;
+        return false;
+    };
+
+    compiled_scene_header header;
+    if (file->size() < sizeof(header))
+        return fail("not a compiled scene");
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, compiled_scene_magic, sizeof(header.magic)) != 0)
+        return fail("not a compiled scene");
+    if (header.version != compiled_scene_version)
+        return fail("compiled by another version, compile it again");
+    if (header.byte_order != byte_order_mark)
+        return fail("compiled on a machine of the other byte order");
+    if (header.real_size != sizeof(real))
+        return fail(header.real_size == sizeof(float) ? "compiled for single precision, build with -DRT_FLOAT"
+                                                      : "compiled for double precision, build without -DRT_FLOAT");
+    if (header.node_size != sizeof(bvh_node) || header.max_leaf_size != flat_scene::max_leaf_size)
+        return fail("compiled by a build with another bvh layout, compile it again");
+
+    // Bounds of a buffer of count values of the given size at offset
+    const uint64_t size = file->size();
+    auto inside = [&](uint64_t offset, uint64_t count, uint64_t value_size, uint64_t alignment)
+    {
+        return offset % alignment == 0 && offset <= size && count <= (size - offset) / value_size;
+    };
+
+    if (!inside(header.material_offset, header.material_count, sizeof(material_record), alignof(material_record)))
+        return fail("truncated file");
+    material_table table;
+    table.materials.reserve(header.material_count);
+    const auto *records = reinterpret_cast<const material_record *>(file->data() + header.material_offset);
+    for (uint64_t i = 0; i < header.material_count; i++)
+    {
+        if (!read_record(records[i], table))
+            return fail("unknown material type");
+    }
+
+    flat_scene result;
+    bool in_bounds = true;
+    int index = 0;
+    for_each_buffer(result, [&](auto &values)
+                    {
+        using T = typename std::decay_t<decltype(values)>::value_type;
+        uint64_t offset = header.buffers[index][0], count = header.buffers[index][1];
+        index++;
+        if (!inside(offset, count, sizeof(T), alignof(T)))
+            in_bounds = false;
+        else
+            values = array_view<T>(reinterpret_cast<const T *>(file->data() + offset), count); });
+    if (!in_bounds)
+        return fail("truncated file");
+
+    // The leaf loops read max_leaf_size values past the last primitive
+    const auto &s = result.spheres;
+    const auto &t = result.triangles;
+    const auto &b = result.boxes;
+    const auto &q = result.quads;
+    const auto &d = result.disks;
+    const auto &p = result.planes;
+    const size_t spheres_read = s.mat_id.size() + flat_scene::max_leaf_size;
+    const size_t triangles_read = t.mat_id.size() + flat_scene::max_leaf_size;
+    bool sizes_match = s.cx.size() == spheres_read && s.cy.size() == spheres_read && s.cz.size() == spheres_read &&
+                       s.radius.size() == spheres_read;
+    for (const array_view<real> *values : {&t.v0x, &t.v0y, &t.v0z, &t.e1x, &t.e1y, &t.e1z, &t.e2x, &t.e2y, &t.e2z})
+        sizes_match &= values->size() == triangles_read;
+    for (const array_view<real> *values : {&t.nx, &t.ny, &t.nz})
+        sizes_match &= values->size() == t.mat_id.size();
+    const size_t boxes_read = b.mat_id.size() + flat_scene::max_leaf_size;
+    for (const array_view<real> &values : b.m)
+        sizes_match &= values.size() == boxes_read;
+    const size_t quads_read = q.mat_id.size() + flat_scene::max_leaf_size;
+    for (const array_view<real> *values : {&q.qx, &q.qy, &q.qz, &q.nx, &q.ny, &q.nz, &q.offset,
+                                           &q.ax, &q.ay, &q.az, &q.bx, &q.by, &q.bz})
+        sizes_match &= values->size() == quads_read;
+    for (const array_view<real> *values : {&q.ux, &q.uy, &q.uz, &q.vx, &q.vy, &q.vz})
+        sizes_match &= values->size() == q.mat_id.size();
+    const size_t disks_read = d.mat_id.size() + flat_scene::max_leaf_size;
+    for (const array_view<real> *values : {&d.cx, &d.cy, &d.cz, &d.nx, &d.ny, &d.nz, &d.offset, &d.radius})
+        sizes_match &= values->size() == disks_read;
+    for (const array_view<real> *values : {&p.nx, &p.ny, &p.nz, &p.offset})
+        sizes_match &= values->size() == p.mat_id.size();
+    if (!sizes_match)
+        return fail("buffer sizes don't match");
+
+    result.source = file;
+    world = std::move(result);
+    materials = std::move(table);
+    view.reset();
+    if (header.has_view)
+    {
+        camera_settings settings;
+        settings.lookfrom = point3(header.view[0], header.view[1], header.view[2]);
+        settings.lookat = point3(header.view[3], header.view[4], header.view[5]);
+        settings.vup = vec3(header.view[6], header.view[7], header.view[8]);
+        settings.vfov = header.view[9];
+        settings.aperture = header.view[10];
+        settings.focus_dist = header.view[11];
+        view = settings;
+    }
+    return true;
+}
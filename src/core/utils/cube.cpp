@@ -0,0 +1,114 @@
+#include "utils/cube.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+
+cube::cube(point3 cen, real side_len, vec3 up, vec3 front, material_id m){
+    center = cen;
+    this->side_len = side_len;
+    this->up = up;
+    this->front = front;
+    this->right = cross(up, front);
+    mat_id = m;
+
+    // The columns of the map from the box frame are the half edges
+    affine_transform to_world;
+    const vec3 axes[3] = {right, up, front};
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < 3; i++)
+            to_world.m[i][a] = axes[a].e[i] * side_len / 2;
+    }
+    for (int i = 0; i < 3; i++)
+        to_world.m[i][3] = center.e[i];
+    to_local = to_world.inverse();
+}
+
+bool cube::intersect(const affine_transform& to_local, const ray& r, real t_min, real t_max, real& t,
+                     vec3& outward_normal) {
+    const auto& m = to_local.m;
+    real enter = -infinity, exit = infinity;
+    int enter_axis = 0, exit_axis = 0;
+    vec3 d;
+    for (int a = 0; a < 3; a++) {
+        real o = m[a][0] * r.orig.e[0] + m[a][1] * r.orig.e[1] + m[a][2] * r.orig.e[2] + m[a][3];
+        d.e[a] = m[a][0] * r.dir.e[0] + m[a][1] * r.dir.e[1] + m[a][2] * r.dir.e[2];
+        real t0 = (-1 - o) / d.e[a];
+        real t1 = (1 - o) / d.e[a];
+        real near = t0 < t1 ? t0 : t1;
+        real far = t0 < t1 ? t1 : t0;
+        if (near > enter) {
+            enter = near;
+            enter_axis = a;
+        }
+        if (far < exit) {
+            exit = far;
+            exit_axis = a;
+        }
+    }
+
+    // A ray that starts inside leaves through the far side
+    bool inside = !(enter > t_min);
+    t = inside ? exit : enter;
+    if (!(enter <= exit && t > t_min && t < t_max))
+        return false;
+
+    // The ray enters through the side it faces and leaves through the other
+    int axis = inside ? exit_axis : enter_axis;
+    vec3 local_normal;
+    local_normal.e[axis] = (d.e[axis] < 0) != inside ? 1 : -1;
+    outward_normal = to_local.normal(local_normal);
+    return true;
+}
+
+bool cube::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    RT_STAT(tests[test_cube]++);
+    real t;
+    vec3 outward_normal;
+    if (!intersect(to_local, r, t_min, t_max, t, outward_normal))
+        return false;
+
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.set_face_normal(r, unit_vector(outward_normal));
+    rec.mat_id = mat_id;
+    rec.light = light_shape::area;
+    return true;
+}
+
+bool cube::bounding_box(aabb& output_box) const {
+    const real h = side_len / 2;
+    output_box = aabb();
+    for (int corner = 0; corner < 8; corner++) {
+        output_box.expand(center + ((corner & 1) ? h : -h) * right + ((corner & 2) ? h : -h) * up +
+                          ((corner & 4) ? h : -h) * front);
+    }
+    return true;
+}
+
+void cube::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    // Lanes report the cube itself, cube::hit fills in the normal
+    RT_STAT(tests[test_cube] += packet_size);
+    int hits = cube_hit_packet(packet, to_local);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1) {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+quad cube::face(int i) const {
+    const vec3 edges[3] = {right * side_len, up * side_len, front * side_len};
+    return face(center, edges, i, mat_id);
+}
+
+quad cube::face(const point3& center, const vec3 edges[3], int i, material_id m) {
+    const vec3 &n = edges[i % 3], &u = edges[(i + 1) % 3], &v = edges[(i + 2) % 3];
+    // Swapping the edges turns the normal of the far face around
+    if (i < 3)
+        return quad(center + n / 2 - u / 2 - v / 2, u, v, m);
+    return quad(center - n / 2 - u / 2 - v / 2, v, u, m);
+}
+
+void cube::add_lights(light_list& lights) const {
+    for (int i = 0; i < 6; i++)
+        face(i).add_lights(lights);
+}
@@ -0,0 +1,235 @@
+#include "utils/denoise.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Rows per task of the passes
+static const int band = 16;
+
+static int bands(int height)
+{
+    return (height + band - 1) / band;
+}
+
+void resolve_features(const accumulation_buffer& accum, image& img, thread_pool& pool)
+{
+    const size_t pixels = static_cast<size_t>(img.width) * img.height;
+    img.albedo.assign(pixels * 3, 0.0f);
+    img.normal.assign(pixels * 3, 0.0f);
+    img.depth.assign(pixels, 0.0f);
+
+    pool.parallel_for(bands(img.height), [&](int index, int)
+                      {
+        for (int y = index * band; y < std::min(img.height, (index + 1) * band); y++)
+        {
+            for (int x = 0; x < img.width; x++)
+            {
+                size_t i = static_cast<size_t>(y) * img.width + x;
+                int n = accum.count(x, y);
+                if (n == 0)
+                    continue;
+                float length_sq = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    img.albedo[i * 3 + c] = accum.albedo_sums[i * 3 + c] / n;
+                    length_sq += accum.normal_sums[i * 3 + c] * accum.normal_sums[i * 3 + c];
+                }
+                // The mean of the unit normals is shorter where a pixel straddles an edge
+                if (length_sq > 0)
+                    for (int c = 0; c < 3; c++)
+                        img.normal[i * 3 + c] = accum.normal_sums[i * 3 + c] / std::sqrt(length_sq);
+                img.depth[i] = accum.depth_sums[i] / n;
+            }
+        } });
+}
+
+// Lighting and the variance of its luminance, the quantities the passes filter
+struct lighting
+{
+    float r, g, b, variance;
+};
+
+static float luminance(const float* c)
+{
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+}
+
+// Albedo the radiance is divided by. Near black surfaces keep their radiance.
+static float divisor(float albedo)
+{
+    return std::max(albedo, 0.01f);
+}
+
+void denoise(const accumulation_buffer& accum, image& img, const denoise_settings& settings, thread_pool& pool)
+{
+    const int width = img.width, height = img.height;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    std::vector<lighting> current(pixels), next(pixels);
+    std::vector<float> slope(pixels * 2); // Depth change per pixel along x and y
+
+    pool.parallel_for(bands(height), [&](int index, int)
+                      {
+        for (int y = index * band; y < std::min(height, (index + 1) * band); y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                size_t i = static_cast<size_t>(y) * width + x;
+                const float* albedo = &img.albedo[i * 3];
+                lighting &l = current[i];
+                int n = accum.count(x, y);
+                if (n == 0)
+                {
+                    l = {0, 0, 0, 0};
+                }
+                else
+                {
+                    color mean = accum.sum(x, y) / n;
+                    l.r = static_cast<float>(mean.e[0]) / divisor(albedo[0]);
+                    l.g = static_cast<float>(mean.e[1]) / divisor(albedo[1]);
+                    l.b = static_cast<float>(mean.e[2]) / divisor(albedo[2]);
+                    // Unknown below two samples, then any difference passes the luminance test
+                    float scale = luminance(&l.r) / std::max(static_cast<float>(luminance(mean)), 1e-6f);
+                    double variance = accum.variance(x, y);
+                    l.variance = std::isfinite(variance) ? static_cast<float>(variance) * scale * scale : INFINITY;
+                }
+
+                // The smaller of the one-sided differences, which stays small
+                // along a silhouette
+                const float *z = &img.depth[i];
+                float dx = INFINITY, dy = INFINITY;
+                if (x > 0)
+                    dx = std::fabs(z[0] - z[-1]);
+                if (x + 1 < width)
+                    dx = std::min(dx, std::fabs(z[1] - z[0]));
+                if (y > 0)
+                    dy = std::fabs(z[0] - z[-width]);
+                if (y + 1 < height)
+                    dy = std::min(dy, std::fabs(z[width] - z[0]));
+                slope[i * 2] = std::isfinite(dx) ? dx : 0.0f;
+                slope[i * 2 + 1] = std::isfinite(dy) ? dy : 0.0f;
+            }
+        } });
+
+    // B3 spline, the taps of the 5 by 5 kernel are the products of two of these
+    const float kernel[3] = {3.0f / 8, 1.0f / 4, 1.0f / 16};
+    const float color_sigma = static_cast<float>(settings.color_sigma);
+    const float normal_power = static_cast<float>(settings.normal_power);
+    const float depth_sigma = static_cast<float>(settings.depth_sigma);
+    const float albedo_scale = static_cast<float>(1.0 / (settings.albedo_sigma * settings.albedo_sigma));
+
+    std::vector<float> deviation(pixels);
+    for (int pass = 0; pass < settings.passes; pass++)
+    {
+        // The luminance test uses the standard deviation of the noise blurred
+        // over the 3 by 3 neighbours, a single pixel's estimate is too noisy
+        pool.parallel_for(bands(height), [&](int index, int)
+                          {
+            for (int y = index * band; y < std::min(height, (index + 1) * band); y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    float variance = 0, variance_weight = 0;
+                    for (int dy = -1; dy <= 1; dy++)
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            int qx = x + dx, qy = y + dy;
+                            if (qx < 0 || qx >= width || qy < 0 || qy >= height)
+                                continue;
+                            float w = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                            variance += w * current[static_cast<size_t>(qy) * width + qx].variance;
+                            variance_weight += w;
+                        }
+                    deviation[static_cast<size_t>(y) * width + x] = std::sqrt(variance / variance_weight);
+                }
+            } });
+
+        const int step = 1 << pass;
+        pool.parallel_for(bands(height), [&](int index, int)
+                          {
+            for (int y = index * band; y < std::min(height, (index + 1) * band); y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    const size_t p = static_cast<size_t>(y) * width + x;
+                    const lighting &center = current[p];
+                    const float *albedo_p = &img.albedo[p * 3];
+                    const float *normal_p = &img.normal[p * 3];
+                    const bool sky_p = normal_p[0] == 0 && normal_p[1] == 0 && normal_p[2] == 0;
+                    const float depth_p = img.depth[p];
+                    const float luminance_p = luminance(&center.r);
+
+                    const float w_center = kernel[0] * kernel[0];
+                    float sum_weight = w_center, r = w_center * center.r, g = w_center * center.g, b = w_center * center.b;
+                    float sum_variance = w_center * w_center * center.variance;
+                    for (int dy = -2; dy <= 2; dy++)
+                    {
+                        const int qy = y + dy * step;
+                        if (qy < 0 || qy >= height)
+                            continue;
+                        for (int dx = -2; dx <= 2; dx++)
+                        {
+                            const int qx = x + dx * step;
+                            if ((dx == 0 && dy == 0) || qx < 0 || qx >= width)
+                                continue;
+                            const size_t q = static_cast<size_t>(qy) * width + qx;
+                            const lighting &l = current[q];
+
+                            const float *normal_q = &img.normal[q * 3];
+                            const bool sky_q = normal_q[0] == 0 && normal_q[1] == 0 && normal_q[2] == 0;
+                            if (sky_p != sky_q)
+                                continue;
+                            // The product of the weights as a single exponential,
+                            // neighbours past e^-16 are left out
+                            const float *albedo_q = &img.albedo[q * 3];
+                            float exponent = 0;
+                            for (int c = 0; c < 3; c++)
+                                exponent += (albedo_p[c] - albedo_q[c]) * (albedo_p[c] - albedo_q[c]) * albedo_scale;
+                            float depth_step = slope[p * 2] * std::abs(dx * step) + slope[p * 2 + 1] * std::abs(dy * step);
+                            exponent += std::fabs(img.depth[q] - depth_p) / (depth_sigma * depth_step + 1e-3f * depth_p + 1e-6f);
+                            if (!sky_p)
+                            {
+                                // cosine^normal_power
+                                float cosine = normal_p[0] * normal_q[0] + normal_p[1] * normal_q[1] + normal_p[2] * normal_q[2];
+                                if (cosine <= 0)
+                                    continue;
+                                exponent -= normal_power * std::log(std::min(cosine, 1.0f));
+                            }
+                            if (!(exponent < 16))
+                                continue;
+                            exponent += std::fabs(luminance(&l.r) - luminance_p) /
+                                        (color_sigma * std::max(deviation[p], deviation[q]) + 1e-6f);
+                            float w = kernel[std::abs(dx)] * kernel[std::abs(dy)] * std::exp(-exponent);
+                            if (!(w > 0))
+                                continue;
+                            sum_weight += w;
+                            r += w * l.r;
+                            g += w * l.g;
+                            b += w * l.b;
+                            sum_variance += w * w * l.variance;
+                        }
+                    }
+                    next[p] = {r / sum_weight, g / sum_weight, b / sum_weight, sum_variance / (sum_weight * sum_weight)};
+                }
+            } });
+        std::swap(current, next);
+    }
+
+    if (img.hdr.size() != pixels * 4)
+        img.hdr.assign(pixels * 4, 0.0f);
+    pool.parallel_for(bands(height), [&](int index, int)
+                      {
+        for (int y = index * band; y < std::min(height, (index + 1) * band); y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                size_t i = static_cast<size_t>(y) * width + x;
+                const float *albedo = &img.albedo[i * 3];
+                float *out = &img.hdr[i * 4];
+                out[0] = current[i].r * divisor(albedo[0]);
+                out[1] = current[i].g * divisor(albedo[1]);
+                out[2] = current[i].b * divisor(albedo[2]);
+                out[3] = 1.0f;
+            }
+        } });
+}
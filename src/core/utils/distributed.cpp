@@ -0,0 +1,509 @@
+#include "utils/distributed.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+static const char protocol_magic[8] = {'R', 'T', 'T', 'I', 'L', 'E', 'S', '\0'};
+static const uint32_t protocol_version = 4;
+static const uint32_t byte_order_mark = 0x01020304;
+// Blocks a worker holds at once, one renders while the next one is on the way
+static const size_t pipeline_depth = 2;
+// Largest message either side accepts
+static const uint32_t max_message_size = 1u << 28;
+
+// Both ends are checked to be builds of the same layout, so structs go over
+// the wire as they are in memory, like the buffers of a compiled scene
+enum message_type : uint32_t {
+    message_hello = 1, // Worker to coordinator, hello_message
+    message_reject,    // Coordinator to worker, the reason as text
+    message_frame,     // Coordinator to worker, frame_header, camera, render_settings
+    message_block,     // Coordinator to worker, block_message
+    message_result,    // Worker to coordinator, result_message, then the linear RGBA floats of the block row by row
+};
+
+struct message_header {
+    uint32_t type;
+    uint32_t size; // Bytes that follow
+};
+
+struct hello_message {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t real_size;
+    uint32_t camera_size;
+    uint32_t settings_size;
+    uint32_t stats_size;
+    uint32_t threads;
+    uint32_t unused;
+    uint64_t fingerprint;
+};
+
+struct frame_header {
+    uint32_t frame;
+    int32_t width, height;
+};
+
+struct block_message {
+    uint32_t frame;
+    tile region;
+};
+
+struct result_message {
+    render_stats stats;
+    uint32_t frame;
+    tile region;
+};
+
+static_assert(std::is_trivially_copyable<camera>::value, "cameras are sent as raw bytes");
+static_assert(std::is_trivially_copyable<render_settings>::value, "settings are sent as raw bytes");
+static_assert(std::is_trivially_copyable<render_stats>::value, "statistics are sent as raw bytes");
+
+static bool send_message(tcp_socket &socket, uint32_t type, const void *payload, size_t size,
+                         std::vector<unsigned char> &buffer)
+{
+    message_header header = {type, static_cast<uint32_t>(size)};
+    buffer.resize(sizeof(header) + size);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    if (size > 0)
+        std::memcpy(buffer.data() + sizeof(header), payload, size);
+    return socket.send_all(buffer.data(), buffer.size());
+}
+
+static bool receive_message(tcp_socket &socket, message_header &header, std::vector<unsigned char> &payload)
+{
+    if (!socket.receive_all(&header, sizeof(header)) || header.size > max_message_size)
+        return false;
+    payload.resize(header.size);
+    return header.size == 0 || socket.receive_all(payload.data(), header.size);
+}
+
+uint64_t scene_fingerprint(const hittable &world, const material_table &materials)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&](const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+
+    aabb box;
+    uint8_t bounded = world.bounding_box(box) ? 1 : 0;
+    add(&bounded, sizeof(bounded));
+    if (bounded)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            double bounds[2] = {box.min().e[i], box.max().e[i]};
+            add(bounds, sizeof(bounds));
+        }
+    }
+    uint64_t count = materials.size();
+    add(&count, sizeof(count));
+    for (const material &m : materials.materials)
+    {
+        uint64_t type = m.index();
+        add(&type, sizeof(type));
+    }
+    return hash;
+}
+
+struct tile_coordinator::connection {
+    std::unique_ptr<tcp_socket> socket;
+    std::string name;
+    std::thread thread;
+    bool finished = false;   // serve() has returned, the thread can be joined
+    uint32_t frame_sent = 0; // Last frame whose description the worker got
+    std::deque<std::pair<uint32_t, int>> in_flight; // Frame and index of the blocks sent, oldest first
+};
+
+std::unique_ptr<tile_coordinator> tile_coordinator::listen(int port, uint64_t fingerprint)
+{
+    auto listener = tcp_socket::listen(port);
+    if (!listener)
+        return nullptr;
+    return std::unique_ptr<tile_coordinator>(new tile_coordinator(std::move(listener), port, fingerprint));
+}
+
+tile_coordinator::tile_coordinator(std::unique_ptr<tcp_socket> listener, int port, uint64_t fingerprint)
+    : listener(std::move(listener)), port(port), fingerprint(fingerprint), acceptor([this] { accept_loop(); })
+{
+}
+
+tile_coordinator::~tile_coordinator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (connection &worker : connections)
+            worker.socket->shutdown();
+    }
+    work_available.notify_all();
+
+    // Wake the acceptor up with a connection of our own
+    tcp_socket::connect("127.0.0.1", port);
+    acceptor.join();
+    for (connection &worker : connections)
+        worker.thread.join();
+}
+
+int tile_coordinator::workers() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready_workers;
+}
+
+void tile_coordinator::accept_loop()
+{
+    while (true)
+    {
+        auto socket = listener->accept();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        if (!socket)
+            continue;
+
+        // Forget the workers that have left
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            if (!it->finished)
+            {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            it = connections.erase(it);
+        }
+
+        connections.emplace_back();
+        connection &worker = connections.back();
+        worker.socket = std::move(socket);
+        worker.name = worker.socket->peer();
+        worker.thread = std::thread([this, &worker] { serve(worker); });
+    }
+}
+
+void tile_coordinator::render(const camera &cam, const render_settings &settings, image &img,
+                              const render_job::progress_callback &progress)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    frame_id++;
+    frame_header header = {frame_id, img.width, img.height};
+    frame_message.resize(sizeof(header) + sizeof(camera) + sizeof(render_settings));
+    std::memcpy(frame_message.data(), &header, sizeof(header));
+    std::memcpy(frame_message.data() + sizeof(header), &cam, sizeof(camera));
+    std::memcpy(frame_message.data() + sizeof(header) + sizeof(camera), &settings, sizeof(render_settings));
+
+    target = &img;
+    display = settings.display;
+    img.hdr.assign(static_cast<size_t>(img.width) * img.height * 4, 0.0f);
+    blocks.clear();
+    unassigned.clear();
+    for (const tile &region : make_tiles(img.width, img.height, block_size, tile_order::morton))
+    {
+        unassigned.push_back(static_cast<int>(blocks.size()));
+        blocks.push_back({region});
+    }
+    blocks_left = static_cast<int>(blocks.size());
+    stats.clear();
+    frame_active = true;
+    work_available.notify_all();
+
+    if (ready_workers == 0)
+        std::cout << "Waiting for workers on port " << port << std::endl;
+
+    const int total = static_cast<int>(blocks.size());
+    while (!frame_progress.wait_for(lock, std::max(progress_interval, std::chrono::milliseconds(1)),
+                                    [&] { return blocks_left == 0; }))
+    {
+        if (!progress)
+            continue;
+        int done = total - blocks_left;
+        lock.unlock();
+        progress(done, total);
+        lock.lock();
+    }
+    frame_active = false;
+    target = nullptr;
+    lock.unlock();
+
+    if (progress)
+        progress(total, total);
+}
+
+// Picks the next block for worker and marks it as held, -1 when there is none.
+// Called with the mutex held.
+int tile_coordinator::take_block(connection &worker)
+{
+    if (!frame_active)
+        return -1;
+
+    int index = -1;
+    while (index < 0 && !unassigned.empty())
+    {
+        int next = unassigned.front();
+        unassigned.pop_front();
+        if (!blocks[next].done)
+            index = next;
+    }
+
+    // Everything is out, back up a block that another worker is still on
+    if (index < 0 && worker.in_flight.empty())
+    {
+        for (size_t i = 0; i < blocks.size() && index < 0; i++)
+        {
+            if (!blocks[i].done && blocks[i].holders == 1)
+                index = static_cast<int>(i);
+        }
+    }
+    if (index < 0)
+        return -1;
+
+    blocks[index].holders++;
+    worker.in_flight.push_back({frame_id, index});
+    return index;
+}
+
+// Hands the blocks of a worker that left to the others. Called with the mutex held.
+void tile_coordinator::drop_blocks(connection &worker)
+{
+    int reissued = 0;
+    for (const auto &held : worker.in_flight)
+    {
+        if (held.first != frame_id || !frame_active)
+            continue;
+        block &b = blocks[held.second];
+        b.holders--;
+        if (!b.done && b.holders == 0)
+        {
+            unassigned.push_front(held.second);
+            reissued++;
+        }
+    }
+    worker.in_flight.clear();
+    if (reissued > 0)
+        std::cout << "Handing out the " << reissued << " blocks of " << worker.name << " again" << std::endl;
+}
+
+void tile_coordinator::serve(connection &worker)
+{
+    tcp_socket &socket = *worker.socket;
+    message_header header;
+    std::vector<unsigned char> payload, buffer;
+
+    // Both ends need the same scene and build
+    hello_message hello;
+    if (!receive_message(socket, header, payload) || header.type != message_hello || payload.size() != sizeof(hello))
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        worker.finished = true;
+        return;
+    }
+    std::memcpy(&hello, payload.data(), sizeof(hello));
+    const char *reason = nullptr;
+    if (std::memcmp(hello.magic, protocol_magic, sizeof(hello.magic)) != 0 || hello.version != protocol_version)
+        reason = "another version of the tile protocol";
+    else if (hello.byte_order != byte_order_mark || hello.real_size != sizeof(real) ||
+             hello.camera_size != sizeof(camera) || hello.settings_size != sizeof(render_settings) ||
+             hello.stats_size != sizeof(render_stats))
+        reason = "a build of another precision or layout";
+    else if (hello.fingerprint != fingerprint)
+        reason = "another scene";
+    if (reason)
+    {
+        std::string text = std::string("the coordinator renders with ") + reason;
+        send_message(socket, message_reject, text.data(), text.size(), buffer);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "Turned away " << worker.name << ": " << reason << std::endl;
+        worker.finished = true;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready_workers++;
+        std::cout << "Worker " << worker.name << " joined with " << hello.threads << " threads, " << ready_workers
+                  << " connected" << std::endl;
+    }
+
+    std::vector<block_message> sends;
+    std::vector<unsigned char> frame;
+    bool ok = true;
+    while (ok)
+    {
+        sends.clear();
+        frame.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping)
+            {
+                int index;
+                while (worker.in_flight.size() < pipeline_depth && (index = take_block(worker)) >= 0)
+                    sends.push_back({frame_id, blocks[index].region});
+                if (!worker.in_flight.empty())
+                    break;
+                work_available.wait(lock);
+            }
+            if (stopping)
+                break;
+            if (!sends.empty() && worker.frame_sent != frame_id)
+            {
+                frame = frame_message;
+                worker.frame_sent = frame_id;
+            }
+        }
+
+        if (!frame.empty())
+            ok = send_message(socket, message_frame, frame.data(), frame.size(), buffer);
+        for (size_t i = 0; i < sends.size() && ok; i++)
+            ok = send_message(socket, message_block, &sends[i], sizeof(block_message), buffer);
+
+        // Collect the oldest block, the worker renders them in order
+        result_message result;
+        ok = ok && receive_message(socket, header, payload) && header.type == message_result &&
+             payload.size() >= sizeof(result);
+        if (!ok)
+            break;
+        std::memcpy(&result, payload.data(), sizeof(result));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto held = worker.in_flight.front();
+        const tile &r = result.region;
+        size_t pixels_size = static_cast<size_t>(r.x1 - r.x0) * (r.y1 - r.y0) * 4 * sizeof(float);
+        if (result.frame != held.first || r.x1 <= r.x0 || r.y1 <= r.y0 ||
+            payload.size() != sizeof(result) + pixels_size)
+        {
+            std::cout << "Worker " << worker.name << " sent a block it wasn't given" << std::endl;
+            ok = false;
+            break;
+        }
+        worker.in_flight.pop_front();
+
+        // A block of a frame that is already done was a backup copy that lost
+        if (held.first != frame_id || !frame_active)
+            continue;
+        block &b = blocks[held.second];
+        b.holders--;
+        if (b.done)
+            continue;
+        if (r.x0 != b.region.x0 || r.y0 != b.region.y0 || r.x1 != b.region.x1 || r.y1 != b.region.y1)
+        {
+            std::cout << "Worker " << worker.name << " sent a block it wasn't given" << std::endl;
+            ok = false;
+            break;
+        }
+
+        const unsigned char *pixels = payload.data() + sizeof(result);
+        const size_t row_size = static_cast<size_t>(r.x1 - r.x0) * 4 * sizeof(float);
+        for (int y = r.y0; y < r.y1; y++, pixels += row_size)
+            std::memcpy(target->hdr.data() + (static_cast<size_t>(y) * target->width + r.x0) * 4, pixels, row_size);
+        tonemap(*target, display, r.x0, r.y0, r.x1, r.y1);
+        stats += result.stats;
+        b.done = true;
+        if (--blocks_left == 0)
+            frame_progress.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    drop_blocks(worker);
+    ready_workers--;
+    worker.finished = true;
+    work_available.notify_all();
+    if (!stopping)
+        std::cout << "Worker " << worker.name << " left, " << ready_workers << " connected" << std::endl;
+}
+
+bool run_tile_worker(const std::string &host, int port, const hittable &world, const material_table &materials,
+                     renderer &tracer)
+{
+    std::unique_ptr<tcp_socket> socket;
+    for (bool told = false; !(socket = tcp_socket::connect(host, port)); told = true)
+    {
+        if (!told)
+            std::cout << "Waiting for the coordinator at " << host << ":" << port << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    hello_message hello = {};
+    std::memcpy(hello.magic, protocol_magic, sizeof(hello.magic));
+    hello.version = protocol_version;
+    hello.byte_order = byte_order_mark;
+    hello.real_size = sizeof(real);
+    hello.camera_size = sizeof(camera);
+    hello.settings_size = sizeof(render_settings);
+    hello.stats_size = sizeof(render_stats);
+    hello.threads = static_cast<uint32_t>(tracer.num_threads());
+    hello.fingerprint = scene_fingerprint(world, materials);
+    std::vector<unsigned char> payload, buffer;
+    if (!send_message(*socket, message_hello, &hello, sizeof(hello), buffer))
+    {
+        std::cerr << "Lost the connection to " << host << ":" << port << std::endl;
+        return false;
+    }
+    std::cout << "Connected to " << host << ":" << port << std::endl;
+
+    // The camera lives in the bytes of the frame description, placed into a
+    // camera object of any value
+    camera cam(point3(0, 0, 0), point3(0, 0, -1), vec3(0, 1, 0), 40, 1, 0, 1);
+    uint32_t frame = 0;
+    image img;
+    int blocks = 0;
+    message_header header;
+    while (receive_message(*socket, header, payload))
+    {
+        if (header.type == message_reject)
+        {
+            std::cerr << "Turned away, " << std::string(payload.begin(), payload.end()) << std::endl;
+            return false;
+        }
+
+        if (header.type == message_frame && payload.size() == sizeof(frame_header) + sizeof(camera) + sizeof(render_settings))
+        {
+            frame_header description;
+            std::memcpy(&description, payload.data(), sizeof(description));
+            std::memcpy(static_cast<void *>(&cam), payload.data() + sizeof(description), sizeof(camera));
+            const int threads = tracer.settings.num_threads;
+            std::memcpy(&tracer.settings, payload.data() + sizeof(description) + sizeof(camera), sizeof(render_settings));
+            tracer.settings.num_threads = threads;
+            frame = description.frame;
+            if (img.width != description.width || img.height != description.height)
+                img = image(description.width, description.height);
+            continue;
+        }
+
+        block_message block;
+        if (header.type != message_block || payload.size() != sizeof(block))
+            break;
+        std::memcpy(&block, payload.data(), sizeof(block));
+        const tile &r = block.region;
+        if (block.frame != frame || r.x0 < 0 || r.y0 < 0 || r.x1 > img.width || r.y1 > img.height || r.x1 <= r.x0 ||
+            r.y1 <= r.y0)
+            break;
+
+        auto job = tracer.submit_region(world, materials, cam, img, r);
+        job->wait();
+
+        result_message result;
+        result.stats = job->stats();
+        result.frame = frame;
+        result.region = r;
+        const size_t row_size = static_cast<size_t>(r.x1 - r.x0) * 4 * sizeof(float);
+        payload.resize(sizeof(result) + row_size * (r.y1 - r.y0));
+        std::memcpy(payload.data(), &result, sizeof(result));
+        unsigned char *pixels = payload.data() + sizeof(result);
+        for (int y = r.y0; y < r.y1; y++, pixels += row_size)
+            std::memcpy(pixels, img.hdr.data() + (static_cast<size_t>(y) * img.width + r.x0) * 4, row_size);
+        if (!send_message(*socket, message_result, payload.data(), payload.size(), buffer))
+            break;
+        blocks++;
+    }
+
+    // The coordinator closes the connection once it is done
+    std::cout << "Disconnected after " << blocks << " blocks" << std::endl;
+    return true;
+}
@@ -0,0 +1,862 @@
+#include "utils/flat_scene.hpp"
+
+#include <algorithm>
+
+#include "utils/sphere.hpp"
+#include "utils/cube.hpp"
+#include "utils/planar.hpp"
+#include "utils/lights.hpp"
+#include "utils/triangle_mesh.hpp"
+#include "utils/render_stats.hpp"
+
+flat_scene::flat_scene(const hittable_list &objects)
+{
+    std::vector<shared_ptr<hittable>> unflattened;
+    for (const auto &object : objects.objects)
+        add(object, unflattened);
+    others = bvh(unflattened);
+    build();
+}
+
+void flat_scene::add(const shared_ptr<hittable> &object, std::vector<shared_ptr<hittable>> &unflattened)
+{
+    if (auto s = std::dynamic_pointer_cast<sphere>(object))
+    {
+        built.cx.push_back(s->center.e[0]);
+        built.cy.push_back(s->center.e[1]);
+        built.cz.push_back(s->center.e[2]);
+        built.radius.push_back(s->radius);
+        built.sphere_mat_id.push_back(s->mat_id);
+    }
+    else if (auto tri = std::dynamic_pointer_cast<triangle>(object))
+    {
+        vec3 e1 = (*tri)[1] - (*tri)[0], e2 = (*tri)[2] - (*tri)[0];
+        add_triangle((*tri)[0], e1, e2, unit_vector(cross(e1, e2)), tri->mat_id);
+    }
+    else if (auto c = std::dynamic_pointer_cast<cube>(object))
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 4; j++)
+                built.box_m[i * 4 + j].push_back(c->to_local.m[i][j]);
+        }
+        built.box_mat_id.push_back(c->mat_id);
+    }
+    else if (auto q = std::dynamic_pointer_cast<quad>(object))
+    {
+        storage &b = built;
+        b.qx.push_back(q->q.e[0]); b.qy.push_back(q->q.e[1]); b.qz.push_back(q->q.e[2]);
+        b.quad_nx.push_back(q->normal.e[0]); b.quad_ny.push_back(q->normal.e[1]); b.quad_nz.push_back(q->normal.e[2]);
+        b.quad_offset.push_back(q->offset);
+        b.ax.push_back(q->alpha_axis.e[0]); b.ay.push_back(q->alpha_axis.e[1]); b.az.push_back(q->alpha_axis.e[2]);
+        b.bx.push_back(q->beta_axis.e[0]); b.by.push_back(q->beta_axis.e[1]); b.bz.push_back(q->beta_axis.e[2]);
+        b.ux.push_back(q->u.e[0]); b.uy.push_back(q->u.e[1]); b.uz.push_back(q->u.e[2]);
+        b.vx.push_back(q->v.e[0]); b.vy.push_back(q->v.e[1]); b.vz.push_back(q->v.e[2]);
+        b.quad_mat_id.push_back(q->mat_id);
+    }
+    else if (auto d = std::dynamic_pointer_cast<disk>(object))
+    {
+        storage &b = built;
+        b.disk_cx.push_back(d->center.e[0]); b.disk_cy.push_back(d->center.e[1]); b.disk_cz.push_back(d->center.e[2]);
+        b.disk_nx.push_back(d->normal.e[0]); b.disk_ny.push_back(d->normal.e[1]); b.disk_nz.push_back(d->normal.e[2]);
+        b.disk_offset.push_back(d->offset);
+        b.disk_radius.push_back(d->radius);
+        b.disk_mat_id.push_back(d->mat_id);
+    }
+    else if (auto pl = std::dynamic_pointer_cast<plane>(object))
+    {
+        built.plane_nx.push_back(pl->normal.e[0]);
+        built.plane_ny.push_back(pl->normal.e[1]);
+        built.plane_nz.push_back(pl->normal.e[2]);
+        built.plane_offset.push_back(pl->offset);
+        built.plane_mat_id.push_back(pl->mat_id);
+    }
+    else if (auto mesh = std::dynamic_pointer_cast<triangle_mesh>(object))
+    {
+        // Round exactly like the mesh's own precomputed triangles
+        for (size_t i = 0; i < mesh->indices.size(); i += 3)
+        {
+            const point3 &v0 = mesh->vertices[mesh->indices[i]];
+            vec3 e1 = mesh->vertices[mesh->indices[i + 1]] - v0;
+            vec3 e2 = mesh->vertices[mesh->indices[i + 2]] - v0;
+            auto round = [](const vec3 &v)
+            {
+                return vec3(static_cast<float>(v.e[0]), static_cast<float>(v.e[1]), static_cast<float>(v.e[2]));
+            };
+            vec3 e1f = round(e1), e2f = round(e2);
+            add_triangle(round(v0), e1f, e2f, unit_vector(cross(e1f, e2f)), mesh->mat_id);
+        }
+    }
+    else if (auto list = std::dynamic_pointer_cast<hittable_list>(object))
+    {
+        for (const auto &child : list->objects)
+            add(child, unflattened);
+    }
+    else if (auto tree = std::dynamic_pointer_cast<bvh>(object))
+    {
+        for (const auto &child : tree->primitives)
+            add(child, unflattened);
+        for (const auto &child : tree->unbounded)
+            add(child, unflattened);
+    }
+    else
+        unflattened.push_back(object);
+}
+
+void flat_scene::add_triangle(const point3 &v0, const vec3 &e1, const vec3 &e2, const vec3 &normal, material_id mat)
+{
+    storage &t = built;
+    t.v0x.push_back(v0.e[0]); t.v0y.push_back(v0.e[1]); t.v0z.push_back(v0.e[2]);
+    t.e1x.push_back(e1.e[0]); t.e1y.push_back(e1.e[1]); t.e1z.push_back(e1.e[2]);
+    t.e2x.push_back(e2.e[0]); t.e2y.push_back(e2.e[1]); t.e2z.push_back(e2.e[2]);
+    t.nx.push_back(normal.e[0]); t.ny.push_back(normal.e[1]); t.nz.push_back(normal.e[2]);
+    t.triangle_mat_id.push_back(mat);
+}
+
+// The cube::to_local of box i, read from the arrays of box_buffer::m or of the
+// vectors they are built from
+template <typename Array>
+static affine_transform box_to_local(const Array (&m)[12], size_t i)
+{
+    affine_transform to_local;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+            to_local.m[row][column] = m[row * 4 + column][i];
+    }
+    return to_local;
+}
+
+// Reorders every array in place to follow the bvh leaves
+template <typename T>
+static void permute(std::vector<T> &values, const std::vector<bvh_primitive> &order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(values.size());
+    for (const auto &prim : order)
+        sorted.push_back(values[prim.index]);
+    values.swap(sorted);
+}
+
+void flat_scene::build()
+{
+    storage &b = built;
+    const uint32_t sphere_total = static_cast<uint32_t>(b.sphere_mat_id.size());
+    std::vector<bvh_primitive> prims;
+    prims.reserve(sphere_total);
+    for (uint32_t i = 0; i < sphere_total; i++)
+    {
+        vec3 r(b.radius[i], b.radius[i], b.radius[i]);
+        point3 c(b.cx[i], b.cy[i], b.cz[i]);
+        aabb box(c - r, c + r);
+        prims.push_back({box, box.centroid(), i});
+    }
+    // A leaf loop tests max_leaf_size primitives for about the price of one node visit
+    b.sphere_nodes = build_bvh(prims, max_leaf_size, max_leaf_size);
+    for (auto *values : {&b.cx, &b.cy, &b.cz, &b.radius})
+        permute(*values, prims);
+    permute(b.sphere_mat_id, prims);
+    // Entries read past the last leaf, masked out by the leaf loops
+    for (auto *values : {&b.cx, &b.cy, &b.cz, &b.radius})
+        values->resize(values->size() + max_leaf_size, 0.0);
+
+    // Pad the boxes so that axis aligned triangles don't produce a zero thickness slab
+    const real pad = 1e-4;
+    const uint32_t triangle_total = static_cast<uint32_t>(b.triangle_mat_id.size());
+    prims.clear();
+    prims.reserve(triangle_total);
+    for (uint32_t i = 0; i < triangle_total; i++)
+    {
+        point3 v0(b.v0x[i], b.v0y[i], b.v0z[i]);
+        aabb box;
+        box.expand(v0);
+        box.expand(v0 + vec3(b.e1x[i], b.e1y[i], b.e1z[i]));
+        box.expand(v0 + vec3(b.e2x[i], b.e2y[i], b.e2z[i]));
+        box.minimum += vec3(-pad, -pad, -pad);
+        box.maximum += vec3(pad, pad, pad);
+        prims.push_back({box, box.centroid(), i});
+    }
+    b.triangle_nodes = build_bvh(prims, max_leaf_size, max_leaf_size);
+    for (auto *values : {&b.v0x, &b.v0y, &b.v0z, &b.e1x, &b.e1y, &b.e1z,
+                         &b.e2x, &b.e2y, &b.e2z, &b.nx, &b.ny, &b.nz})
+        permute(*values, prims);
+    permute(b.triangle_mat_id, prims);
+    for (auto *values : {&b.v0x, &b.v0y, &b.v0z, &b.e1x, &b.e1y, &b.e1z,
+                         &b.e2x, &b.e2y, &b.e2z})
+        values->resize(values->size() + max_leaf_size, 0.0);
+
+    // Cubes in the world are the image of [-1, 1] on every axis
+    const uint32_t box_total = static_cast<uint32_t>(b.box_mat_id.size());
+    prims.clear();
+    prims.reserve(box_total);
+    for (uint32_t i = 0; i < box_total; i++)
+    {
+        affine_transform to_world = box_to_local(b.box_m, i).inverse();
+        aabb box;
+        for (int corner = 0; corner < 8; corner++)
+            box.expand(to_world.point(point3((corner & 1) ? 1 : -1, (corner & 2) ? 1 : -1, (corner & 4) ? 1 : -1)));
+        prims.push_back({box, box.centroid(), i});
+    }
+    b.box_nodes = build_bvh(prims, max_leaf_size, max_leaf_size);
+    for (auto &values : b.box_m)
+    {
+        permute(values, prims);
+        values.resize(values.size() + max_leaf_size, 0.0);
+    }
+    permute(b.box_mat_id, prims);
+
+    const uint32_t quad_total = static_cast<uint32_t>(b.quad_mat_id.size());
+    prims.clear();
+    prims.reserve(quad_total);
+    for (uint32_t i = 0; i < quad_total; i++)
+    {
+        point3 q(b.qx[i], b.qy[i], b.qz[i]);
+        vec3 u(b.ux[i], b.uy[i], b.uz[i]), v(b.vx[i], b.vy[i], b.vz[i]);
+        aabb box;
+        for (const point3 &corner : {q, q + u, q + v, q + u + v})
+            box.expand(corner);
+        box.minimum += vec3(-pad, -pad, -pad);
+        box.maximum += vec3(pad, pad, pad);
+        prims.push_back({box, box.centroid(), i});
+    }
+    b.quad_nodes = build_bvh(prims, max_leaf_size, max_leaf_size);
+    for (auto *values : {&b.qx, &b.qy, &b.qz, &b.quad_nx, &b.quad_ny, &b.quad_nz, &b.quad_offset,
+                         &b.ax, &b.ay, &b.az, &b.bx, &b.by, &b.bz, &b.ux, &b.uy, &b.uz, &b.vx, &b.vy, &b.vz})
+        permute(*values, prims);
+    permute(b.quad_mat_id, prims);
+    for (auto *values : {&b.qx, &b.qy, &b.qz, &b.quad_nx, &b.quad_ny, &b.quad_nz, &b.quad_offset,
+                         &b.ax, &b.ay, &b.az, &b.bx, &b.by, &b.bz})
+        values->resize(values->size() + max_leaf_size, 0.0);
+
+    // The box of disk::bounding_box
+    const uint32_t disk_total = static_cast<uint32_t>(b.disk_mat_id.size());
+    prims.clear();
+    prims.reserve(disk_total);
+    for (uint32_t i = 0; i < disk_total; i++)
+    {
+        point3 c(b.disk_cx[i], b.disk_cy[i], b.disk_cz[i]);
+        vec3 n(b.disk_nx[i], b.disk_ny[i], b.disk_nz[i]);
+        vec3 extent;
+        for (int a = 0; a < 3; a++)
+            extent.e[a] = b.disk_radius[i] * std::sqrt(std::fmax(real(0), 1 - n.e[a] * n.e[a])) + pad;
+        aabb box(c - extent, c + extent);
+        prims.push_back({box, box.centroid(), i});
+    }
+    b.disk_nodes = build_bvh(prims, max_leaf_size, max_leaf_size);
+    for (auto *values : {&b.disk_cx, &b.disk_cy, &b.disk_cz, &b.disk_nx, &b.disk_ny, &b.disk_nz,
+                         &b.disk_offset, &b.disk_radius})
+    {
+        permute(*values, prims);
+        values->resize(values->size() + max_leaf_size, 0.0);
+    }
+    permute(b.disk_mat_id, prims);
+
+    spheres = {b.cx, b.cy, b.cz, b.radius, b.sphere_mat_id};
+    triangles = {b.v0x, b.v0y, b.v0z, b.e1x, b.e1y, b.e1z, b.e2x, b.e2y, b.e2z,
+                 b.nx, b.ny, b.nz, b.triangle_mat_id};
+    for (int k = 0; k < 12; k++)
+        boxes.m[k] = b.box_m[k];
+    boxes.mat_id = b.box_mat_id;
+    quads = {b.qx, b.qy, b.qz, b.quad_nx, b.quad_ny, b.quad_nz, b.quad_offset, b.ax, b.ay, b.az, b.bx, b.by, b.bz,
+             b.ux, b.uy, b.uz, b.vx, b.vy, b.vz, b.quad_mat_id};
+    disks = {b.disk_cx, b.disk_cy, b.disk_cz, b.disk_nx, b.disk_ny, b.disk_nz, b.disk_offset, b.disk_radius,
+             b.disk_mat_id};
+    planes = {b.plane_nx, b.plane_ny, b.plane_nz, b.plane_offset, b.plane_mat_id};
+    sphere_nodes = b.sphere_nodes;
+    triangle_nodes = b.triangle_nodes;
+    box_nodes = b.box_nodes;
+    quad_nodes = b.quad_nodes;
+    disk_nodes = b.disk_nodes;
+}
+
+// Walks a flat_scene bvh front to back and hands every leaf that the ray reaches
+// to intersect_leaf(offset, count), which returns true after shrinking closest.
+// With any_hit set it stops at the first leaf that returns true.
+template <typename Leaf>
+static bool traverse(const array_view<bvh_node> &nodes, const ray &r, real t_min, real &closest, bool any_hit,
+                     Leaf intersect_leaf)
+{
+    if (nodes.empty())
+        return false;
+
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    const vec3 inv_dir(1.0 / dir.e[0], 1.0 / dir.e[1], 1.0 / dir.e[2]);
+    const bool dir_is_neg[3] = {inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real t_enter;
+    bool hit_anything = false;
+    uint64_t boxes = 0;
+
+    while (true)
+    {
+        const bvh_node &node = nodes[current];
+        boxes++;
+        if (node.box.hit(origin, inv_dir, t_min, closest, t_enter))
+        {
+            if (node.count > 0)
+            {
+                hit_anything |= intersect_leaf(node.offset, node.count);
+                if (stack_size == 0 || (any_hit && hit_anything)) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                // The second child holds the larger coordinates, so it is nearer
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    return hit_anything;
+}
+
+// Returns the position of the smallest distance below closest, or -1
+static inline int closest_lane(const real *t, uint32_t count, real &closest)
+{
+    int best = -1;
+    for (uint32_t k = 0; k < count; k++)
+    {
+        if (t[k] < closest)
+        {
+            closest = t[k];
+            best = static_cast<int>(k);
+        }
+    }
+    return best;
+}
+
+// Splits a leaf into pieces of at most max_leaf_size primitives, the builder
+// exceeds that size when centroids coincide or the depth limit is reached
+template <typename Chunk>
+static inline bool leaf_chunks(uint32_t offset, uint32_t count, Chunk intersect_chunk)
+{
+    bool hit_anything = false;
+    for (uint32_t start = 0; start < count; start += flat_scene::max_leaf_size)
+        hit_anything |= intersect_chunk(offset + start, std::min<uint32_t>(flat_scene::max_leaf_size, count - start));
+    return hit_anything;
+}
+
+bool flat_scene::hit_spheres(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const real ox = r.orig.e[0], oy = r.orig.e[1], oz = r.orig.e[2];
+    const real dx = r.dir.e[0], dy = r.dir.e[1], dz = r.dir.e[2];
+    const real a = dx * dx + dy * dy + dz * dz;
+
+    uint64_t tested = 0;
+    bool hit = traverse(sphere_nodes, r, t_min, closest, any_hit, [&](uint32_t offset, uint32_t count)
+                    { tested += count;
+                      return leaf_chunks(offset, count, [&](uint32_t offset, uint32_t count)
+                                         {
+        const real *cx = &spheres.cx[offset], *cy = &spheres.cy[offset], *cz = &spheres.cz[offset];
+        const real *radius = &spheres.radius[offset];
+        const real t_max = closest;
+        real t[max_leaf_size];
+
+        // Same arithmetic as sphere::hit, without branches. The loop always runs
+        // over max_leaf_size entries so that it vectorizes without a remainder.
+        for (uint32_t k = 0; k < max_leaf_size; k++)
+        {
+            real ocx = ox - cx[k], ocy = oy - cy[k], ocz = oz - cz[k];
+            real half_b = ocx * dx + ocy * dy + ocz * dz;
+            real c = (ocx * ocx + ocy * ocy + ocz * ocz) - radius[k] * radius[k];
+            real discriminant = half_b * half_b - a * c;
+            real sqrtd = std::sqrt(std::max(discriminant, real(0)));
+            real near_root = (-half_b - sqrtd) / a;
+            real far_root = (-half_b + sqrtd) / a;
+            real root = (near_root >= t_min && near_root <= t_max) ? near_root : far_root;
+            bool valid = k < count && discriminant >= 0 && root >= t_min && root <= t_max;
+            t[k] = valid ? root : infinity;
+        }
+
+        // Inclusive like sphere::hit, a sphere exactly at t_max still counts
+        real limit = std::nextafter(t_max, infinity);
+        int best = closest_lane(t, count, limit);
+        if (best < 0)
+            return false;
+        closest = limit;
+        index = offset + best;
+        return true; }); });
+    RT_STAT(tests[test_sphere] += tested);
+    return hit;
+}
+
+bool flat_scene::hit_triangles(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const real ox = r.orig.e[0], oy = r.orig.e[1], oz = r.orig.e[2];
+    const real dx = r.dir.e[0], dy = r.dir.e[1], dz = r.dir.e[2];
+    const triangle_buffer &tb = triangles;
+
+    uint64_t tested = 0;
+    bool hit = traverse(triangle_nodes, r, t_min, closest, any_hit, [&](uint32_t offset, uint32_t count)
+                    { tested += count;
+                      return leaf_chunks(offset, count, [&](uint32_t offset, uint32_t count)
+                                         {
+        const real *v0x = &tb.v0x[offset], *v0y = &tb.v0y[offset], *v0z = &tb.v0z[offset];
+        const real *e1x = &tb.e1x[offset], *e1y = &tb.e1y[offset], *e1z = &tb.e1z[offset];
+        const real *e2x = &tb.e2x[offset], *e2y = &tb.e2y[offset], *e2z = &tb.e2z[offset];
+        const real t_max = closest;
+        real t[max_leaf_size];
+
+        // Möller-Trumbore with the operations of ray_triangle_intersection, without branches
+        // and over max_leaf_size entries like the sphere loop
+        for (uint32_t k = 0; k < max_leaf_size; k++)
+        {
+            real hx = dy * e2z[k] - dz * e2y[k];
+            real hy = dz * e2x[k] - dx * e2z[k];
+            real hz = dx * e2y[k] - dy * e2x[k];
+            real a = e1x[k] * hx + e1y[k] * hy + e1z[k] * hz;
+            real f = 1.0 / a;
+            real sx = ox - v0x[k], sy = oy - v0y[k], sz = oz - v0z[k];
+            real u = f * (sx * hx + sy * hy + sz * hz);
+            real qx = sy * e1z[k] - sz * e1y[k];
+            real qy = sz * e1x[k] - sx * e1z[k];
+            real qz = sx * e1y[k] - sy * e1x[k];
+            real v = f * (dx * qx + dy * qy + dz * qz);
+            real tk = f * (e2x[k] * qx + e2y[k] * qy + e2z[k] * qz);
+            bool valid = k < count && (a < 0.0 || a > 0.0) && u >= 0.0 && u <= 1.0 && v >= 0.0 && u + v <= 1.0 &&
+                         tk > t_min && tk < t_max;
+            t[k] = valid ? tk : infinity;
+        }
+
+        int best = closest_lane(t, count, closest);
+        if (best < 0)
+            return false;
+        index = offset + best;
+        return true; }); });
+    RT_STAT(tests[test_triangle] += tested);
+    return hit;
+}
+
+// Narrows [enter, exit] to where a ray at o moving by d per unit of t lies
+// within [-1, 1] on one axis of a box
+static inline void slab(real o, real d, real &enter, real &exit)
+{
+    real inv = 1 / d;
+    real t0 = (-1 - o) * inv;
+    real t1 = (1 - o) * inv;
+    real near = t0 < t1 ? t0 : t1;
+    real far = t0 < t1 ? t1 : t0;
+    enter = near > enter ? near : enter;
+    exit = far < exit ? far : exit;
+}
+
+bool flat_scene::hit_boxes(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const real ox = r.orig.e[0], oy = r.orig.e[1], oz = r.orig.e[2];
+    const real dx = r.dir.e[0], dy = r.dir.e[1], dz = r.dir.e[2];
+
+    uint64_t tested = 0;
+    bool hit = traverse(box_nodes, r, t_min, closest, any_hit, [&](uint32_t offset, uint32_t count)
+                    { tested += count;
+                      return leaf_chunks(offset, count, [&](uint32_t offset, uint32_t count)
+                                         {
+        const real *m[12];
+        for (int j = 0; j < 12; j++)
+            m[j] = &boxes.m[j][offset];
+        const real t_max = closest;
+        real t[max_leaf_size];
+
+        // The slab test of cube::intersect, without branches and with one
+        // division per axis. The axes are written out, a loop over them keeps
+        // the compiler from vectorizing
+        for (uint32_t k = 0; k < max_leaf_size; k++)
+        {
+            real enter = -infinity, exit = infinity;
+            slab(m[0][k] * ox + m[1][k] * oy + m[2][k] * oz + m[3][k], m[0][k] * dx + m[1][k] * dy + m[2][k] * dz,
+                 enter, exit);
+            slab(m[4][k] * ox + m[5][k] * oy + m[6][k] * oz + m[7][k], m[4][k] * dx + m[5][k] * dy + m[6][k] * dz,
+                 enter, exit);
+            slab(m[8][k] * ox + m[9][k] * oy + m[10][k] * oz + m[11][k], m[8][k] * dx + m[9][k] * dy + m[10][k] * dz,
+                 enter, exit);
+            real tk = enter > t_min ? enter : exit;
+            bool valid = k < count && enter <= exit && tk > t_min && tk < t_max;
+            t[k] = valid ? tk : infinity;
+        }
+
+        int best = closest_lane(t, count, closest);
+        if (best < 0)
+            return false;
+        index = offset + best;
+        return true; }); });
+    RT_STAT(tests[test_cube] += tested);
+    return hit;
+}
+
+bool flat_scene::hit_quads(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const real ox = r.orig.e[0], oy = r.orig.e[1], oz = r.orig.e[2];
+    const real dx = r.dir.e[0], dy = r.dir.e[1], dz = r.dir.e[2];
+    const quad_buffer &qb = quads;
+
+    uint64_t tested = 0;
+    bool hit = traverse(quad_nodes, r, t_min, closest, any_hit, [&](uint32_t offset, uint32_t count)
+                    { tested += count;
+                      return leaf_chunks(offset, count, [&](uint32_t offset, uint32_t count)
+                                         {
+        const real *qx = &qb.qx[offset], *qy = &qb.qy[offset], *qz = &qb.qz[offset];
+        const real *nx = &qb.nx[offset], *ny = &qb.ny[offset], *nz = &qb.nz[offset], *off = &qb.offset[offset];
+        const real *ax = &qb.ax[offset], *ay = &qb.ay[offset], *az = &qb.az[offset];
+        const real *bx = &qb.bx[offset], *by = &qb.by[offset], *bz = &qb.bz[offset];
+        const real t_max = closest;
+        real t[max_leaf_size];
+
+        // Same arithmetic as quad::hit, without branches
+        for (uint32_t k = 0; k < max_leaf_size; k++)
+        {
+            real tk = (off[k] - (nx[k] * ox + ny[k] * oy + nz[k] * oz)) / (nx[k] * dx + ny[k] * dy + nz[k] * dz);
+            real rx = (ox + tk * dx) - qx[k], ry = (oy + tk * dy) - qy[k], rz = (oz + tk * dz) - qz[k];
+            real alpha = rx * ax[k] + ry * ay[k] + rz * az[k];
+            real beta = rx * bx[k] + ry * by[k] + rz * bz[k];
+            bool valid = k < count && tk > t_min && tk < t_max && alpha >= 0 && alpha <= 1 && beta >= 0 && beta <= 1;
+            t[k] = valid ? tk : infinity;
+        }
+
+        int best = closest_lane(t, count, closest);
+        if (best < 0)
+            return false;
+        index = offset + best;
+        return true; }); });
+    RT_STAT(tests[test_planar] += tested);
+    return hit;
+}
+
+bool flat_scene::hit_disks(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const real ox = r.orig.e[0], oy = r.orig.e[1], oz = r.orig.e[2];
+    const real dx = r.dir.e[0], dy = r.dir.e[1], dz = r.dir.e[2];
+    const disk_buffer &db = disks;
+
+    uint64_t tested = 0;
+    bool hit = traverse(disk_nodes, r, t_min, closest, any_hit, [&](uint32_t offset, uint32_t count)
+                    { tested += count;
+                      return leaf_chunks(offset, count, [&](uint32_t offset, uint32_t count)
+                                         {
+        const real *cx = &db.cx[offset], *cy = &db.cy[offset], *cz = &db.cz[offset];
+        const real *nx = &db.nx[offset], *ny = &db.ny[offset], *nz = &db.nz[offset], *off = &db.offset[offset];
+        const real *radius = &db.radius[offset];
+        const real t_max = closest;
+        real t[max_leaf_size];
+
+        // Same arithmetic as disk::hit, without branches
+        for (uint32_t k = 0; k < max_leaf_size; k++)
+        {
+            real tk = (off[k] - (nx[k] * ox + ny[k] * oy + nz[k] * oz)) / (nx[k] * dx + ny[k] * dy + nz[k] * dz);
+            real rx = (ox + tk * dx) - cx[k], ry = (oy + tk * dy) - cy[k], rz = (oz + tk * dz) - cz[k];
+            bool valid = k < count && tk > t_min && tk < t_max && rx * rx + ry * ry + rz * rz <= radius[k] * radius[k];
+            t[k] = valid ? tk : infinity;
+        }
+
+        int best = closest_lane(t, count, closest);
+        if (best < 0)
+            return false;
+        index = offset + best;
+        return true; }); });
+    RT_STAT(tests[test_planar] += tested);
+    return hit;
+}
+
+bool flat_scene::hit_planes(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit) const
+{
+    const plane_buffer &pb = planes;
+    bool hit = false;
+    for (uint32_t i = 0; i < plane_count(); i++)
+    {
+        // Same arithmetic as plane::hit
+        real t = (pb.offset[i] - (pb.nx[i] * r.orig.e[0] + pb.ny[i] * r.orig.e[1] + pb.nz[i] * r.orig.e[2])) /
+                 (pb.nx[i] * r.dir.e[0] + pb.ny[i] * r.dir.e[1] + pb.nz[i] * r.dir.e[2]);
+        if (t > t_min && t < closest)
+        {
+            closest = t;
+            index = i;
+            hit = true;
+            if (any_hit)
+                break;
+        }
+    }
+    RT_STAT(tests[test_planar] += plane_count());
+    return hit;
+}
+
+bool flat_scene::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    real closest = t_max;
+    uint32_t sphere_index = 0, triangle_index = 0, box_index = 0, quad_index = 0, disk_index = 0, plane_index = 0;
+    // The few large boxes, quads and disks go first, so that the spheres and
+    // triangles behind them are culled by their distance
+    bool hit_plane = hit_planes(r, t_min, closest, plane_index);
+    bool hit_box = hit_boxes(r, t_min, closest, box_index);
+    bool hit_quad = hit_quads(r, t_min, closest, quad_index);
+    bool hit_disk = hit_disks(r, t_min, closest, disk_index);
+    bool hit_sphere = hit_spheres(r, t_min, closest, sphere_index);
+    bool hit_triangle = hit_triangles(r, t_min, closest, triangle_index);
+
+    // Each search only reports hits closer than the ones before it
+    if (others.hit(r, t_min, closest, rec))
+        return true;
+
+    if (hit_triangle)
+    {
+        const triangle_buffer &tb = triangles;
+        const uint32_t i = triangle_index;
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, vec3(tb.nx[i], tb.ny[i], tb.nz[i]));
+        rec.mat_id = tb.mat_id[i];
+        rec.light = light_shape::area;
+        return true;
+    }
+
+    if (hit_sphere)
+    {
+        const uint32_t i = sphere_index;
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        point3 center(spheres.cx[i], spheres.cy[i], spheres.cz[i]);
+        vec3 outward_normal = (rec.p - center) / spheres.radius[i];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_id = spheres.mat_id[i];
+        bool inside = (r.orig - center).length_squared() - spheres.radius[i] * spheres.radius[i] <= 0;
+        rec.light = inside ? light_shape::none : light_shape::sphere;
+        return true;
+    }
+
+    if (hit_disk)
+    {
+        const disk_buffer &db = disks;
+        const uint32_t i = disk_index;
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, vec3(db.nx[i], db.ny[i], db.nz[i]));
+        rec.mat_id = db.mat_id[i];
+        rec.light = light_shape::area;
+        return true;
+    }
+
+    if (hit_quad)
+    {
+        const quad_buffer &qb = quads;
+        const uint32_t i = quad_index;
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, vec3(qb.nx[i], qb.ny[i], qb.nz[i]));
+        rec.mat_id = qb.mat_id[i];
+        rec.light = light_shape::area;
+        return true;
+    }
+
+    if (hit_box)
+    {
+        // Only the face is left to find, along the ray the loop hit it on
+        real t;
+        vec3 outward_normal;
+        cube::intersect(box_to_local(boxes.m, box_index), r, t_min, infinity, t, outward_normal);
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, unit_vector(outward_normal));
+        rec.mat_id = boxes.mat_id[box_index];
+        rec.light = light_shape::area;
+        return true;
+    }
+
+    if (hit_plane)
+    {
+        const uint32_t i = plane_index;
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, vec3(planes.nx[i], planes.ny[i], planes.nz[i]));
+        rec.mat_id = planes.mat_id[i];
+        rec.light = light_shape::none;
+        return true;
+    }
+
+    return false;
+}
+
+bool flat_scene::occluded(const ray &r, real t_min, real t_max) const
+{
+    real closest = t_max;
+    uint32_t index;
+    return hit_planes(r, t_min, closest, index, true) || hit_boxes(r, t_min, closest, index, true) ||
+           hit_quads(r, t_min, closest, index, true) || hit_disks(r, t_min, closest, index, true) ||
+           hit_triangles(r, t_min, closest, index, true) ||
+           hit_spheres(r, t_min, closest, index, true) || others.occluded(r, t_min, t_max);
+}
+
+void flat_scene::add_lights(light_list &lights) const
+{
+    for (size_t i = 0; i < sphere_count(); i++)
+        lights.add_sphere(point3(spheres.cx[i], spheres.cy[i], spheres.cz[i]), spheres.radius[i], spheres.mat_id[i]);
+    const triangle_buffer &tb = triangles;
+    for (size_t i = 0; i < triangle_count(); i++)
+        lights.add_triangle(point3(tb.v0x[i], tb.v0y[i], tb.v0z[i]), vec3(tb.e1x[i], tb.e1y[i], tb.e1z[i]),
+                            vec3(tb.e2x[i], tb.e2y[i], tb.e2z[i]), tb.mat_id[i]);
+    for (size_t i = 0; i < box_count(); i++)
+    {
+        // The columns of the map from [-1, 1] are half the edges
+        affine_transform to_world = box_to_local(boxes.m, i).inverse();
+        vec3 edges[3];
+        for (int a = 0; a < 3; a++)
+            edges[a] = 2 * vec3(to_world.m[0][a], to_world.m[1][a], to_world.m[2][a]);
+        point3 center(to_world.m[0][3], to_world.m[1][3], to_world.m[2][3]);
+        for (int face = 0; face < 6; face++)
+            cube::face(center, edges, face, boxes.mat_id[i]).add_lights(lights);
+    }
+    const quad_buffer &qb = quads;
+    for (size_t i = 0; i < quad_count(); i++)
+        quad(point3(qb.qx[i], qb.qy[i], qb.qz[i]), vec3(qb.ux[i], qb.uy[i], qb.uz[i]), vec3(qb.vx[i], qb.vy[i], qb.vz[i]),
+             qb.mat_id[i])
+            .add_lights(lights);
+    const disk_buffer &db = disks;
+    for (size_t i = 0; i < disk_count(); i++)
+        lights.add_disk(point3(db.cx[i], db.cy[i], db.cz[i]), vec3(db.nx[i], db.ny[i], db.nz[i]), db.radius[i], db.mat_id[i]);
+    others.add_lights(lights);
+}
+
+// Runs visit_leaf(offset, count) on every leaf that some lane of the packet reaches
+template <typename Leaf>
+static void traverse_packet(const array_view<bvh_node> &nodes, const ray_packet &packet, Leaf visit_leaf)
+{
+    if (nodes.empty())
+        return;
+
+    int first = 0;
+    while (first < packet_size && !packet.active(first))
+        first++;
+    if (first == packet_size)
+        return;
+    const bool dir_is_neg[3] = {packet.inv_dx[first] < 0, packet.inv_dy[first] < 0, packet.inv_dz[first] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    uint64_t boxes = 0;
+
+    while (true)
+    {
+        const bvh_node &node = nodes[current];
+        boxes += packet_size;
+        if (box_hit_packet(packet, node.box.minimum, node.box.maximum))
+        {
+            if (node.count > 0)
+            {
+                visit_leaf(node.offset, node.count);
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+}
+
+void flat_scene::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    others.hit_packet(packet, hit_objects);
+
+    int hits = 0;
+    for (size_t i = 0; i < plane_count(); i++)
+        hits |= plane_hit_packet(packet, vec3(planes.nx[i], planes.ny[i], planes.nz[i]), planes.offset[i]);
+    RT_STAT(tests[test_planar] += plane_count() * packet_size);
+
+    uint64_t spheres_tested = 0, triangles_tested = 0;
+    traverse_packet(sphere_nodes, packet, [&](uint32_t offset, uint32_t count)
+                    {
+        spheres_tested += count * packet_size;
+        for (uint32_t i = offset; i < offset + count; i++)
+            hits |= sphere_hit_packet(packet, point3(spheres.cx[i], spheres.cy[i], spheres.cz[i]), spheres.radius[i]); });
+
+    const triangle_buffer &tb = triangles;
+    traverse_packet(triangle_nodes, packet, [&](uint32_t offset, uint32_t count)
+                    {
+        triangles_tested += count * packet_size;
+        for (uint32_t i = offset; i < offset + count; i++)
+            hits |= triangle_hit_packet(packet, point3(tb.v0x[i], tb.v0y[i], tb.v0z[i]),
+                                        vec3(tb.e1x[i], tb.e1y[i], tb.e1z[i]), vec3(tb.e2x[i], tb.e2y[i], tb.e2z[i])); });
+
+    uint64_t boxes_tested = 0, planar_tested = 0;
+    traverse_packet(box_nodes, packet, [&](uint32_t offset, uint32_t count)
+                    {
+        boxes_tested += count * packet_size;
+        for (uint32_t i = offset; i < offset + count; i++)
+            hits |= cube_hit_packet(packet, box_to_local(boxes.m, i)); });
+
+    const quad_buffer &qb = quads;
+    traverse_packet(quad_nodes, packet, [&](uint32_t offset, uint32_t count)
+                    {
+        planar_tested += count * packet_size;
+        for (uint32_t i = offset; i < offset + count; i++)
+            hits |= quad_hit_packet(packet, vec3(qb.nx[i], qb.ny[i], qb.nz[i]), qb.offset[i], point3(qb.qx[i], qb.qy[i], qb.qz[i]),
+                                    vec3(qb.ax[i], qb.ay[i], qb.az[i]), vec3(qb.bx[i], qb.by[i], qb.bz[i])); });
+
+    const disk_buffer &db = disks;
+    traverse_packet(disk_nodes, packet, [&](uint32_t offset, uint32_t count)
+                    {
+        planar_tested += count * packet_size;
+        for (uint32_t i = offset; i < offset + count; i++)
+            hits |= disk_hit_packet(packet, vec3(db.nx[i], db.ny[i], db.nz[i]), db.offset[i],
+                                    point3(db.cx[i], db.cy[i], db.cz[i]), db.radius[i]); });
+
+    RT_STAT(tests[test_sphere] += spheres_tested);
+    RT_STAT(tests[test_triangle] += triangles_tested);
+    RT_STAT(tests[test_cube] += boxes_tested);
+    RT_STAT(tests[test_planar] += planar_tested);
+
+    // The record is filled in by a scalar hit on this scene
+    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+    {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+bool flat_scene::bounding_box(aabb &output_box) const
+{
+    if (plane_count() > 0)
+        return false;
+    output_box = aabb();
+    for (const array_view<bvh_node> *nodes : {&sphere_nodes, &triangle_nodes, &box_nodes, &quad_nodes, &disk_nodes})
+    {
+        if (!nodes->empty())
+            output_box.expand((*nodes)[0].box);
+    }
+
+    aabb others_box;
+    if (!others.nodes.empty() || !others.unbounded.empty())
+    {
+        if (!others.bounding_box(others_box))
+            return false;
+        output_box.expand(others_box);
+    }
+    return !output_box.empty();
+}
@@ -0,0 +1,53 @@
+#include "utils/frame_time_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Scale steps, so that a small change in the cost doesn't resize every frame
+static const double scale_step = 1.0 / 16;
+
+frame_time_controller::frame_time_controller(frame_size full, double target_seconds)
+    : full(full), moving_size(full), target_seconds(target_seconds)
+{
+}
+
+frame_time_controller::frame_size frame_time_controller::next(bool moving) const
+{
+    return moving ? moving_size : full;
+}
+
+void frame_time_controller::finished(const frame_size &size, double seconds)
+{
+    if (target_seconds <= 0.0 || seconds <= 0.0)
+        return;
+
+    double samples = static_cast<double>(size.width) * size.height * size.samples;
+    double measured = seconds / samples;
+    if (seconds_per_sample == 0.0 || measured > seconds_per_sample)
+        seconds_per_sample = measured;
+    else
+        seconds_per_sample += 0.25 * (measured - seconds_per_sample);
+    update_moving_size();
+}
+
+void frame_time_controller::update_moving_size()
+{
+    const double full_pixels = static_cast<double>(full.width) * full.height;
+    const double budget = target_seconds / seconds_per_sample; // Pixel samples that fit the target
+
+    moving_size = full;
+    if (budget >= full_pixels * full.samples)
+        return;
+    if (budget >= full_pixels)
+    {
+        moving_size.samples = std::max(1, static_cast<int>(budget / full_pixels));
+        return;
+    }
+
+    // Round down to a step, the frame then ends up a bit under the target
+    double scale = std::sqrt(budget / full_pixels);
+    scale = std::max(min_scale, std::floor(scale / scale_step) * scale_step);
+    moving_size.samples = 1;
+    moving_size.width = std::max(1, static_cast<int>(full.width * scale + 0.5));
+    moving_size.height = std::max(1, static_cast<int>(full.height * scale + 0.5));
+}
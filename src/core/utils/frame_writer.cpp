@@ -0,0 +1,202 @@
+#include "utils/frame_writer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+frame_writer::frame_writer(int encoders, int buffers)
+{
+    for (int i = 0; i < std::max(1, buffers); i++)
+    {
+        this->buffers.push_back(std::make_unique<image>());
+        free_buffers.push_back(this->buffers.back().get());
+    }
+    for (int i = 0; i < std::max(1, encoders); i++)
+        this->encoders.emplace_back([this] { encoder_loop(); });
+}
+
+frame_writer::~frame_writer()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &encoder : encoders)
+        encoder.join();
+}
+
+image &frame_writer::acquire(int width, int height)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    buffer_available.wait(lock, [&] { return !free_buffers.empty(); });
+    image *frame = free_buffers.back();
+    free_buffers.pop_back();
+    lock.unlock();
+
+    if (frame->width != width || frame->height != height)
+        *frame = image(width, height);
+    return *frame;
+}
+
+void frame_writer::submit(image &frame, const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t sequence = is_video_path(path) ? streams[path].submitted++ : 0;
+        queue.push_back({&frame, path, sequence});
+    }
+    work_available.notify_one();
+}
+
+bool frame_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [&] { return queue.empty() && writing == 0; });
+
+    for (auto &entry : streams)
+    {
+        if (entry.second.file && std::fclose(entry.second.file) != 0)
+        {
+            std::cerr << "Failed to write " << entry.first << std::endl;
+            failed = true;
+        }
+    }
+    streams.clear();
+
+    bool ok = !failed;
+    failed = false;
+    return ok;
+}
+
+// Called with the mutex held
+void frame_writer::release(image *frame)
+{
+    free_buffers.push_back(frame);
+    buffer_available.notify_one();
+}
+
+void frame_writer::encoder_loop()
+{
+    std::vector<uint8_t> planes;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        work_available.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            return;
+
+        job work = std::move(queue.front());
+        queue.pop_front();
+        writing++;
+
+        bool ok;
+        if (is_video_path(work.path))
+            ok = write_video_frame(work, planes, lock);
+        else
+        {
+            lock.unlock();
+            ok = work.frame->write(work.path);
+            if (ok && write_features && !work.frame->depth.empty())
+                ok = work.frame->write_features(work.path);
+            lock.lock();
+            release(work.frame);
+        }
+        if (!ok)
+        {
+            std::cerr << "Failed to write " << work.path << std::endl;
+            failed = true;
+        }
+
+        writing--;
+        if (queue.empty() && writing == 0)
+            all_done.notify_all();
+    }
+}
+
+// Converts the frame to planar Y'CbCr 4:4:4 (BT.601, video range) without the
+// lock, then appends it to its stream once the frames before it are written.
+// Called and returns with the mutex held.
+bool frame_writer::write_video_frame(const job &work, std::vector<uint8_t> &planes, std::unique_lock<std::mutex> &lock)
+{
+    video_stream &stream = streams[work.path];
+    const image &frame = *work.frame;
+    const int width = frame.width, height = frame.height;
+    const size_t plane_size = static_cast<size_t>(width) * height;
+
+    lock.unlock();
+    planes.resize(plane_size * 3);
+    uint8_t *y_plane = planes.data(), *u_plane = y_plane + plane_size, *v_plane = u_plane + plane_size;
+    for (int y = 0; y < height; y++)
+    {
+        // Our rows start at the bottom, video rows at the top
+        const uint8_t *src = frame.data() + static_cast<size_t>(height - 1 - y) * width * 3;
+        size_t row = static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++)
+        {
+            int r = src[x * 3], g = src[x * 3 + 1], b = src[x * 3 + 2];
+            y_plane[row + x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            u_plane[row + x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v_plane[row + x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    lock.lock();
+    release(work.frame);
+
+    stream_advanced.wait(lock, [&] { return stream.written == work.sequence; });
+    bool ok = !stream.failed;
+    if (ok && work.sequence == 0)
+    {
+        stream.file = std::fopen(work.path.c_str(), "wb");
+        stream.width = width;
+        stream.height = height;
+        ok = stream.file && std::fprintf(stream.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height,
+                                         video_fps) > 0;
+    }
+    else if (ok && (width != stream.width || height != stream.height))
+    {
+        std::cerr << work.path << ": every frame of a video stream needs the same size" << std::endl;
+        ok = false;
+    }
+
+    if (ok)
+    {
+        // Only this thread may write to the stream until written moves on
+        lock.unlock();
+        ok = std::fputs("FRAME\n", stream.file) >= 0 &&
+             std::fwrite(planes.data(), 1, planes.size(), stream.file) == planes.size();
+        lock.lock();
+    }
+
+    stream.failed = !ok;
+    stream.written++;
+    stream_advanced.notify_all();
+    return ok;
+}
+
+std::string frame_path(const std::string &pattern, int frame)
+{
+    size_t start = pattern.find('#');
+    if (start == std::string::npos)
+        return pattern;
+
+    size_t end = pattern.find_first_not_of('#', start);
+    if (end == std::string::npos)
+        end = pattern.size();
+
+    std::string number = std::to_string(frame);
+    if (number.size() < end - start)
+        number.insert(0, end - start - number.size(), '0');
+
+    return pattern.substr(0, start) + number + pattern.substr(end);
+}
+
+bool is_video_path(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "y4m";
+}
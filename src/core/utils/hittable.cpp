@@ -0,0 +1,92 @@
+#include "utils/hittable.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+void hittable::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    hit_record rec;
+    for (int lane = 0; lane < packet_size; lane++) {
+        if (!packet.active(lane))
+            continue;
+        if (hit(packet.get(lane), packet.t_min, packet.t_max[lane], rec)) {
+            packet.t_max[lane] = rec.t;
+            hit_objects[lane] = this;
+        }
+    }
+}
+
+bool hittable::occluded(const ray& r, real t_min, real t_max) const {
+    hit_record rec;
+    return hit(r, t_min, t_max, rec);
+}
+
+void hittable::add_lights(light_list&) const {}
+
+bool triangle::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    if (!ray_triangle_intersection(r, *this, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    rec.light = light_shape::area;
+    return true;
+}
+
+void triangle::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    RT_STAT(tests[test_triangle] += packet_size);
+    int hits = triangle_hit_packet(packet, vertices[0], vertices[1] - vertices[0], vertices[2] - vertices[0]);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1) {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+void triangle::add_lights(light_list& lights) const {
+    lights.add_triangle(vertices[0], vertices[1] - vertices[0], vertices[2] - vertices[0], mat_id);
+}
+
+bool triangle::bounding_box(aabb& output_box) const {
+    // Pad the box so that axis aligned triangles don't produce a zero thickness slab
+    const real pad = 1e-4;
+    output_box = aabb();
+    for (const point3& v : vertices)
+        output_box.expand(v);
+    output_box.minimum += vec3(-pad, -pad, -pad);
+    output_box.maximum += vec3(pad, pad, pad);
+    return true;
+}
+
+bool ray_triangle_intersection(const ray& r, const triangle tri, real t_min, real t_max, hit_record& rec) {
+    // Möller-Trumbore algorithm
+    RT_STAT(tests[test_triangle]++);
+    vec3 edge1 = tri[1] - tri[0];
+    vec3 edge2 = tri[2] - tri[0];
+    vec3 h = cross(r.direction(), edge2);
+    real a = dot(edge1, h);
+
+    // Parallel to the plane of the triangle. a scales with the edges and the
+    // direction, so it is not compared against an epsilon
+    if (a == 0.0)
+        return false;
+
+    real f = 1.0 / a;
+    vec3 s = r.origin() - tri[0];
+    real u = f * dot(s, h);
+
+    if (u < 0.0 || u > 1.0)
+        return false;
+
+    vec3 q = cross(s, edge1);
+    real v = f * dot(r.direction(), q);
+
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+
+    real t = f * dot(edge2, q);
+
+    if (t > t_min && t < t_max) {
+        rec.t = t;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, unit_vector(cross(edge1, edge2)));
+        return true;
+    }
+
+    return false;
+}
\ No newline at end of file
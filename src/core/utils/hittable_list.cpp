@@ -0,0 +1,50 @@
+#include "utils/hittable_list.hpp"
+#include "utils/lights.hpp"
+
+bool hittable_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    hit_record temp_rec;
+    bool hit_anything = false;
+    auto closest_so_far = t_max;
+
+    for (const auto& object : objects) {
+        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+            hit_anything = true;
+            closest_so_far = temp_rec.t;
+            rec = temp_rec;
+        }
+    }
+
+    return hit_anything;
+}
+
+bool hittable_list::bounding_box(aabb& output_box) const {
+    if (objects.empty()) return false;
+
+    aabb temp_box;
+    output_box = aabb();
+
+    for (const auto& object : objects) {
+        if (!object->bounding_box(temp_box)) return false;
+        output_box.expand(temp_box);
+    }
+
+    return true;
+}
+
+void hittable_list::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    for (const auto& object : objects)
+        object->hit_packet(packet, hit_objects);
+}
+
+bool hittable_list::occluded(const ray& r, real t_min, real t_max) const {
+    for (const auto& object : objects) {
+        if (object->occluded(r, t_min, t_max))
+            return true;
+    }
+    return false;
+}
+
+void hittable_list::add_lights(light_list& lights) const {
+    for (const auto& object : objects)
+        object->add_lights(lights);
+}
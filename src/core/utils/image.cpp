@@ -0,0 +1,182 @@
+#include "utils/image.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include "math/utils.hpp"
+
+void image::set_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b){
+    size_t i = (static_cast<size_t>(y) * width + x) * 3;
+    pixels[i + 0] = r;
+    pixels[i + 1] = g;
+    pixels[i + 2] = b;
+}
+
+void image::set_pixel(int x, int y, color col, int samples_per_pixel){
+    auto r = col.x();
+    auto g = col.y();
+    auto b = col.z();
+
+    auto scale = 1.0 / samples_per_pixel;
+    r = sqrt(scale * r);
+    g = sqrt(scale * g);
+    b = sqrt(scale * b);
+    set_pixel(x, y,
+        static_cast<uint8_t>(256 * clamp(r, 0.0, 0.999)),
+        static_cast<uint8_t>(256 * clamp(g, 0.0, 0.999)),
+        static_cast<uint8_t>(256 * clamp(b, 0.0, 0.999)));
+}
+
+void resample(const image& src, image& dst){
+    if (src.width == dst.width && src.height == dst.height){
+        dst.pixels = src.pixels;
+        return;
+    }
+
+    // Source column and weight of the right neighbour for every column of dst,
+    // with pixel centres lined up
+    struct tap {
+        size_t offset;
+        int weight; // Out of 256
+    };
+    auto taps = [](int from, int to){
+        std::vector<tap> result(to);
+        double step = static_cast<double>(from) / to;
+        for (int i = 0; i < to; i++){
+            double pos = clamp((i + 0.5) * step - 0.5, 0.0, from - 1.0);
+            int left = std::min(static_cast<int>(pos), std::max(from - 2, 0));
+            result[i] = {static_cast<size_t>(left), static_cast<int>((pos - left) * 256 + 0.5)};
+        }
+        return result;
+    };
+    const std::vector<tap> columns = taps(src.width, dst.width), rows = taps(src.height, dst.height);
+    const size_t src_row = static_cast<size_t>(src.width) * 3;
+    const size_t next_column = src.width > 1 ? 3 : 0, next_row = src.height > 1 ? src_row : 0;
+
+    for (int y = 0; y < dst.height; y++){
+        const uint8_t* top = src.data() + rows[y].offset * src_row;
+        const uint8_t* bottom = top + next_row;
+        const int wy = rows[y].weight;
+        uint8_t* out = dst.data() + static_cast<size_t>(y) * dst.width * 3;
+        for (int x = 0; x < dst.width; x++){
+            const size_t i = columns[x].offset * 3;
+            const int wx = columns[x].weight;
+            for (int c = 0; c < 3; c++){
+                int upper = top[i + c] * (256 - wx) + top[i + c + next_column] * wx;
+                int lower = bottom[i + c] * (256 - wx) + bottom[i + c + next_column] * wx;
+                out[x * 3 + c] = static_cast<uint8_t>((upper * (256 - wy) + lower * wy + (1 << 15)) >> 16);
+            }
+        }
+    }
+}
+
+static bool write_ppm(const std::string& path, const image& img){
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", img.width, img.height);
+    size_t row_size = static_cast<size_t>(img.width) * 3;
+    bool ok = true;
+    for (int y = img.height - 1; y >= 0 && ok; y--)
+        ok = fwrite(img.data() + y * row_size, 1, row_size, file) == row_size;
+
+    return fclose(file) == 0 && ok;
+}
+
+// Linear RGB of row y, the radiance the renderer left in hdr or else the 8-bit
+// pixels squared back, the inverse of the gamma 2 in set_pixel
+static void linear_row(const image& img, int y, float* row){
+    const size_t start = static_cast<size_t>(y) * img.width;
+    if (!img.hdr.empty()){
+        const float* src = img.hdr.data() + start * 4;
+        for (int x = 0; x < img.width; x++)
+            for (int c = 0; c < 3; c++)
+                row[x * 3 + c] = src[x * 4 + c];
+        return;
+    }
+    const uint8_t* src = img.data() + start * 3;
+    for (int i = 0; i < img.width * 3; i++){
+        float v = (src[i] + 0.5f) / 256.0f;
+        row[i] = v * v;
+    }
+}
+
+static bool little_endian(){
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+// Portable float map, rows go bottom to top like ours
+static bool write_pfm(const std::string& path, const image& img){
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "PF\n%d %d\n%s\n", img.width, img.height, little_endian() ? "-1.0" : "1.0");
+    std::vector<float> row(static_cast<size_t>(img.width) * 3);
+    bool ok = true;
+    for (int y = 0; y < img.height && ok; y++){
+        linear_row(img, y, row.data());
+        ok = fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+bool image::write(const std::string& path) const{
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == "ppm")
+        return write_ppm(path, *this);
+    if (ext == "pfm")
+        return write_pfm(path, *this);
+
+    // stb keeps the flag in a global, set it once before any encoder reads it
+    static std::once_flag flip_once;
+    std::call_once(flip_once, [] { stbi_flip_vertically_on_write(true); });
+    if (ext == "png")
+        return stbi_write_png(path.c_str(), width, height, 3, data(), width * 3) != 0;
+    if (ext == "jpg" || ext == "jpeg")
+        return stbi_write_jpg(path.c_str(), width, height, 3, data(), 100) != 0;
+    if (ext == "bmp")
+        return stbi_write_bmp(path.c_str(), width, height, 3, data()) != 0;
+    if (ext == "hdr"){
+        std::vector<float> linear(pixels.size());
+        for (int y = 0; y < height; y++)
+            linear_row(*this, y, linear.data() + static_cast<size_t>(y) * width * 3);
+        return stbi_write_hdr(path.c_str(), width, height, 3, linear.data()) != 0;
+    }
+
+    fprintf(stderr, "Unsupported image format: %s\n", path.c_str());
+    return false;
+}
+
+// Float map of a buffer with 1 (grey) or 3 (RGB) channels
+static bool write_pfm(const std::string& path, int width, int height, const std::vector<float>& buffer, int channels){
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "%s\n%d %d\n%s\n", channels == 1 ? "Pf" : "PF", width, height, little_endian() ? "-1.0" : "1.0");
+    bool ok = fwrite(buffer.data(), sizeof(float), buffer.size(), file) == buffer.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool image::write_features(const std::string& path) const{
+    const size_t pixels = static_cast<size_t>(width) * height;
+    if (albedo.size() != pixels * 3 || normal.size() != pixels * 3 || depth.size() != pixels)
+        return false;
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    std::string stem = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? path : path.substr(0, dot);
+    return write_pfm(stem + ".albedo.pfm", width, height, albedo, 3) &&
+           write_pfm(stem + ".normal.pfm", width, height, normal, 3) &&
+           write_pfm(stem + ".depth.pfm", width, height, depth, 1);
+}
@@ -0,0 +1,270 @@
+#include "utils/instance.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+#include <unordered_set>
+
+instance::instance(shared_ptr<const hittable> geometry, const affine_transform &object_to_world)
+    : geometry(std::move(geometry)), world_to_object(object_to_world.inverse())
+{
+}
+
+bool instance::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    if (!geometry->hit(to_object(r), t_min, t_max, rec))
+        return false;
+    // The transposed map keeps the sign of the dot product with the ray, so
+    // the normal still faces the ray and front_face holds
+    rec.p = r.at(rec.t);
+    rec.normal = unit_vector(world_to_object.normal(rec.normal));
+    // light_list doesn't list the spheres this turns into ellipsoids
+    if (rec.light == light_shape::sphere && !world_to_object.similarity())
+        rec.light = light_shape::none;
+    return true;
+}
+
+bool instance::occluded(const ray &r, real t_min, real t_max) const
+{
+    return geometry->occluded(to_object(r), t_min, t_max);
+}
+
+bool instance::bounding_box(aabb &output_box) const
+{
+    aabb local;
+    if (!geometry->bounding_box(local) || local.empty())
+        return false;
+    affine_transform object_to_world = world_to_object.inverse();
+    output_box = aabb();
+    for (int corner = 0; corner < 8; corner++)
+    {
+        point3 p((corner & 1) ? local.maximum.e[0] : local.minimum.e[0],
+                 (corner & 2) ? local.maximum.e[1] : local.minimum.e[1],
+                 (corner & 4) ? local.maximum.e[2] : local.minimum.e[2]);
+        output_box.expand(object_to_world.point(p));
+    }
+    return true;
+}
+
+void instance::add_lights(light_list &lights) const
+{
+    lights.push_transform(world_to_object);
+    geometry->add_lights(lights);
+    lights.pop_transform();
+}
+
+instance_bvh::instance_bvh(std::vector<instance> placed, int max_leaf_size)
+{
+    std::vector<bvh_primitive> prims;
+    prims.reserve(placed.size());
+    for (uint32_t i = 0; i < placed.size(); i++)
+    {
+        aabb box;
+        if (!placed[i].bounding_box(box))
+        {
+            unbounded.push_back(placed[i]);
+            continue;
+        }
+        prims.push_back({box, box.centroid(), i});
+    }
+
+    nodes = build_bvh(prims, max_leaf_size);
+    instances.reserve(prims.size());
+    for (const auto &prim : prims)
+        instances.push_back(std::move(placed[prim.index]));
+}
+
+// Walks the nodes front to back and hands every leaf that the ray reaches to
+// intersect_leaf(offset, count), which returns true after shrinking closest.
+// With any_hit set it stops at the first leaf that returns true.
+template <typename Leaf>
+static bool traverse(const std::vector<bvh_node> &nodes, const ray &r, real t_min, real &closest, bool any_hit,
+                     Leaf intersect_leaf)
+{
+    if (nodes.empty())
+        return false;
+
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    const vec3 inv_dir(1.0 / dir.e[0], 1.0 / dir.e[1], 1.0 / dir.e[2]);
+    const bool dir_is_neg[3] = {inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real t_enter;
+    bool hit_anything = false;
+    uint64_t boxes = 0;
+
+    while (true)
+    {
+        const bvh_node &node = nodes[current];
+        boxes++;
+        if (node.box.hit(origin, inv_dir, t_min, closest, t_enter))
+        {
+            if (node.count > 0)
+            {
+                hit_anything |= intersect_leaf(node.offset, node.count);
+                if (stack_size == 0 || (any_hit && hit_anything)) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                // The second child holds the larger coordinates, so it is nearer
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    return hit_anything;
+}
+
+bool instance_bvh::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    // The records of closer hits overwrite the earlier ones, misses leave them alone
+    hit_record temp_rec;
+    bool hit_anything = false;
+    real closest = t_max;
+    for (const instance &object : unbounded)
+    {
+        if (object.hit(r, t_min, closest, temp_rec))
+        {
+            hit_anything = true;
+            closest = temp_rec.t;
+            rec = temp_rec;
+        }
+    }
+
+    hit_anything |= traverse(nodes, r, t_min, closest, false, [&](uint32_t offset, uint32_t count)
+                             {
+        bool found = false;
+        for (uint32_t i = offset; i < offset + count; i++)
+        {
+            if (instances[i].hit(r, t_min, closest, temp_rec))
+            {
+                found = true;
+                closest = temp_rec.t;
+                rec = temp_rec;
+            }
+        }
+        return found; });
+    return hit_anything;
+}
+
+bool instance_bvh::occluded(const ray &r, real t_min, real t_max) const
+{
+    for (const instance &object : unbounded)
+    {
+        if (object.occluded(r, t_min, t_max))
+            return true;
+    }
+
+    real closest = t_max;
+    return traverse(nodes, r, t_min, closest, true, [&](uint32_t offset, uint32_t count)
+                    {
+        for (uint32_t i = offset; i < offset + count; i++)
+        {
+            if (instances[i].occluded(r, t_min, t_max))
+                return true;
+        }
+        return false; });
+}
+
+void instance_bvh::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    for (const instance &object : unbounded)
+        object.hit_packet(packet, hit_objects);
+
+    if (nodes.empty())
+        return;
+
+    int first = 0;
+    while (first < packet_size && !packet.active(first))
+        first++;
+    if (first == packet_size)
+        return;
+    const bool dir_is_neg[3] = {packet.inv_dx[first] < 0, packet.inv_dy[first] < 0, packet.inv_dz[first] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    uint64_t boxes = 0;
+
+    // Leaves test the lanes one at a time, each in the space of the instance.
+    // The lanes report the instance, whose hit fills in the record.
+    while (true)
+    {
+        const bvh_node &node = nodes[current];
+        boxes += packet_size;
+        if (box_hit_packet(packet, node.box.minimum, node.box.maximum))
+        {
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                    instances[i].hit_packet(packet, hit_objects);
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+}
+
+void instance_bvh::add_lights(light_list &lights) const
+{
+    // Geometry without emitting primitives is walked for its first instance
+    // only, a forest of unlit meshes would otherwise take as long as flattening it
+    std::unordered_set<const hittable *> unlit;
+    for (const auto *placed : {&instances, &unbounded})
+    {
+        for (const instance &object : *placed)
+        {
+            if (unlit.count(object.geometry.get()))
+                continue;
+            size_t offered = lights.offered();
+            object.add_lights(lights);
+            if (lights.offered() == offered)
+                unlit.insert(object.geometry.get());
+        }
+    }
+}
+
+bool instance_bvh::bounding_box(aabb &output_box) const
+{
+    if (nodes.empty() || !unbounded.empty())
+        return false;
+    output_box = nodes[0].box;
+    return true;
+}
+
+size_t instance_bvh::memory_size() const
+{
+    return (instances.capacity() + unbounded.capacity()) * sizeof(instance) + nodes.capacity() * sizeof(bvh_node);
+}
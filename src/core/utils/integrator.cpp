@@ -0,0 +1,148 @@
+#include "utils/integrator.hpp"
+#include "utils/render_stats.hpp"
+
+color path_integrator::background(const ray& r) {
+    vec3 unit_direction = unit_vector(r.direction());
+    auto t = 0.5 * (unit_direction.y() + 1.0);
+    return (1.0 - t) * color(1, 1, 1) + t * color(0.5, 0.7, 1);
+}
+
+// Veach's power heuristic: the weight of a sample drawn with density pdf that
+// the other strategy would have drawn with density other_pdf
+static inline real power_heuristic(real pdf, real other_pdf) {
+    real ratio = other_pdf / pdf;
+    return 1 / (1 + ratio * ratio);
+}
+
+// Shadow rays stop this far short of the light, relative to its distance
+static const real shadow_epsilon = 1e-3;
+
+color path_integrator::sample_light(const ray& r_in, const hit_record& rec, const material& mat, const hittable& world) const {
+    light_sample s;
+    if (!lights.sample(rec.p, s))
+        return color(0, 0, 0);
+
+    vec3 to_light = s.p - rec.p;
+    real scatter_pdf;
+    color f = scattering(mat, r_in, rec, to_light, scatter_pdf);
+    if (scatter_pdf <= 0)
+        return color(0, 0, 0);
+
+    // The direction lies above the surface, or the material would not scatter into it
+    real distance = to_light.length();
+    ray shadow(offset_ray_origin(rec.p, unit_vector(rec.normal)), to_light / distance);
+    RT_STAT(shadow_rays++);
+    if (world.occluded(shadow, 0.001, distance * (1 - shadow_epsilon)))
+        return color(0, 0, 0);
+    return f * s.emit * (power_heuristic(s.pdf, scatter_pdf) / s.pdf);
+}
+
+// Ends the search of a path for its features at rec
+static void set_features(path_features* features, const color& throughput, const material& mat,
+                         const hit_record& rec) {
+    features->albedo = throughput * surface_albedo(mat);
+    features->normal = unit_vector(rec.normal);
+}
+
+color path_integrator::li(const ray& r, const hittable& world, path_features* features) const {
+    if (max_depth <= 0)
+        return color(0, 0, 0);
+
+    hit_record rec;
+    bool hit = world.hit(r, 0.001, infinity, rec);
+    return li(r, hit, rec, world, features);
+}
+
+color path_integrator::li(const ray& r, bool hit, const hit_record& first_hit, const hittable& world,
+                          path_features* features) const {
+    if (max_depth <= 0) {
+        RT_STAT(add_path(0, path_max_depth));
+        return color(0, 0, 0);
+    }
+
+    RT_STAT(primary_rays++);
+    RT_STAT(hits += hit);
+    RT_STAT(misses += !hit);
+
+    color radiance(0, 0, 0);
+    color throughput(1, 1, 1);
+    ray current = r;
+    hit_record rec = first_hit;
+    // Density with which the last hit scattered into current, 0 when that hit
+    // took no light sample that could have found the same light
+    real scatter_pdf = 0;
+    // Still looking for the surface whose features the pixel shows
+    bool find_features = features != nullptr;
+
+    for (int depth = 1; ; depth++) {
+        if (!hit) {
+            RT_STAT(add_path(depth, path_escaped));
+            if (find_features)
+                features->albedo = throughput * background(current);
+            return radiance + throughput * background(current);
+        }
+
+        const material& mat = materials[rec.mat_id];
+        if (find_features) {
+            if (depth == 1)
+                features->depth = rec.t * current.direction().length();
+            if (samples_lights(mat) || std::holds_alternative<diffuse_light>(mat)) {
+                set_features(features, throughput, mat, rec);
+                find_features = false;
+            }
+        }
+        if (std::holds_alternative<diffuse_light>(mat)) {
+            real weight = scatter_pdf > 0 ? power_heuristic(scatter_pdf, lights.pdf(current, rec)) : 1;
+            radiance += throughput * emitted(mat) * weight;
+        }
+
+        const bool light_sampled = depth < max_depth && !lights.empty() && samples_lights(mat);
+        if (light_sampled)
+            radiance += throughput * sample_light(current, rec, mat, world);
+
+        ray scattered;
+        color attenuation;
+        RT_STAT(scatters[mat.index()]++);
+        if (!scatter(mat, current, rec, attenuation, scattered)) {
+            RT_STAT(add_path(depth, path_absorbed));
+            if (find_features)
+                set_features(features, throughput, mat, rec);
+            return radiance;
+        }
+        throughput = throughput * attenuation;
+
+        if (depth >= max_depth) {
+            RT_STAT(add_path(depth, path_max_depth));
+            if (find_features)
+                set_features(features, throughput, mat, rec);
+            return radiance;
+        }
+
+        if (depth >= rr_min_depth) {
+            double survival = fmax(throughput.x(), fmax(throughput.y(), throughput.z()));
+            if (survival < rr_threshold) {
+                if (sample_1d() >= survival) {
+                    RT_STAT(add_path(depth, path_roulette));
+                    if (find_features)
+                        set_features(features, throughput, mat, rec);
+                    return radiance;
+                }
+                throughput /= survival;
+            }
+        }
+
+        scatter_pdf = 0;
+        if (light_sampled)
+            scattering(mat, current, rec, scattered.dir, scatter_pdf);
+
+        // Start the next segment just off the surface, on the side it leaves from
+        vec3 n = unit_vector(rec.normal);
+        scattered.orig = offset_ray_origin(rec.p, dot(scattered.dir, n) > 0 ? n : -n);
+
+        current = scattered;
+        hit = world.hit(current, 0.001, infinity, rec);
+        RT_STAT(secondary_rays++);
+        RT_STAT(hits += hit);
+        RT_STAT(misses += !hit);
+    }
+}
@@ -0,0 +1,178 @@
+#include "utils/lights.hpp"
+
+#include <algorithm>
+
+light_list::light_list(const hittable &world, const material_table &materials)
+    : materials(materials), density(materials.size(), 0)
+{
+    world.add_lights(*this);
+
+    // Until now cdf and density held the power of every light and the radiance
+    // of every light material, power is radiance times area
+    real total = cdf.empty() ? 0 : cdf.back();
+    if (total <= 0)
+    {
+        lights.clear();
+        cdf.clear();
+        std::fill(density.begin(), density.end(), real(0));
+        return;
+    }
+    for (real &c : cdf)
+        c /= total;
+    cdf.back() = 1;
+    for (real &d : density)
+        d /= total;
+}
+
+bool light_list::emits(material_id m) const
+{
+    return luminance(emitted(materials[m])) > 0;
+}
+
+void light_list::add(const light &l, real area)
+{
+    real radiance = static_cast<real>(luminance(emitted(materials[l.mat])));
+    if (radiance <= 0 || area <= 0)
+        return;
+    density[l.mat] = radiance;
+    lights.push_back(l);
+    cdf.push_back((cdf.empty() ? 0 : cdf.back()) + radiance * area);
+}
+
+void light_list::add_sphere(const point3 &center, real radius, material_id m)
+{
+    if (!emits(m))
+        return;
+    offered_count++;
+    point3 c = center;
+    if (!transforms.empty())
+    {
+        const level &t = transforms.back();
+        if (!t.keeps_spheres)
+            return;
+        c = t.object_to_world.point(center);
+        radius *= t.object_to_world.vector(vec3(1, 0, 0)).length();
+    }
+    // Only the half facing the shading point is ever picked
+    radius = std::fabs(radius);
+    add({shape::sphere, c, vec3(0, 0, 0), vec3(0, 0, 0), radius, m}, 2 * real(pi) * radius * radius);
+}
+
+void light_list::add_triangle(const point3 &v0, const vec3 &e1, const vec3 &e2, material_id m)
+{
+    if (!emits(m))
+        return;
+    offered_count++;
+    if (!transforms.empty())
+    {
+        const affine_transform &t = transforms.back().object_to_world;
+        vec3 world_e1 = t.vector(e1), world_e2 = t.vector(e2);
+        add({shape::triangle, t.point(v0), world_e1, world_e2, 0, m}, cross(world_e1, world_e2).length() / 2);
+        return;
+    }
+    add({shape::triangle, v0, e1, e2, 0, m}, cross(e1, e2).length() / 2);
+}
+
+void light_list::add_disk(const point3 &center, const vec3 &normal, real radius, material_id m)
+{
+    if (!emits(m))
+        return;
+    offered_count++;
+    vec3 n = unit_vector(normal);
+    vec3 helper = std::fabs(n.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    vec3 e1 = radius * unit_vector(cross(n, helper));
+    vec3 e2 = radius * unit_vector(cross(n, e1));
+    point3 c = center;
+    if (!transforms.empty())
+    {
+        // Any affine map keeps a uniform density uniform, the ellipse is sampled as well
+        const affine_transform &t = transforms.back().object_to_world;
+        c = t.point(center);
+        e1 = t.vector(e1);
+        e2 = t.vector(e2);
+    }
+    add({shape::disk, c, e1, e2, 0, m}, real(pi) * cross(e1, e2).length());
+}
+
+void light_list::push_transform(const affine_transform &world_to_object)
+{
+    // The same test on the same matrix as instance::hit
+    affine_transform object_to_world = world_to_object.inverse();
+    bool similar = world_to_object.similarity();
+    if (transforms.empty())
+        transforms.push_back({object_to_world, similar});
+    else
+        transforms.push_back({transforms.back().object_to_world * object_to_world,
+                              transforms.back().keeps_spheres && similar});
+}
+
+void light_list::pop_transform()
+{
+    transforms.pop_back();
+}
+
+bool light_list::sample(const point3 &p, light_sample &s) const
+{
+    if (lights.empty())
+        return false;
+
+    real pick = static_cast<real>(sample_1d());
+    size_t index = std::upper_bound(cdf.begin(), cdf.end(), pick) - cdf.begin();
+    const light &l = lights[std::min(index, lights.size() - 1)];
+
+    if (l.kind == shape::sphere)
+    {
+        vec3 axis = p - l.p;
+        if (axis.length_squared() <= l.radius * l.radius)
+            return false;
+        axis = unit_vector(axis);
+        // Uniform in area over the half sphere around axis: its height is uniform
+        vec3 helper = std::fabs(axis.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        vec3 u = unit_vector(cross(axis, helper));
+        vec3 v = cross(axis, u);
+        double su, sv;
+        sample_2d(su, sv);
+        real z = static_cast<real>(su);
+        real phi = static_cast<real>(2 * pi * sv);
+        real r = sqrt(fmax(real(0), 1 - z * z));
+        s.normal = r * cos(phi) * u + r * sin(phi) * v + z * axis;
+        s.p = l.p + l.radius * s.normal;
+    }
+    else if (l.kind == shape::disk)
+    {
+        vec3 d = random_in_unit_disk();
+        s.p = l.p + static_cast<real>(d.x()) * l.e1 + static_cast<real>(d.y()) * l.e2;
+        s.normal = unit_vector(cross(l.e1, l.e2));
+    }
+    else
+    {
+        // Folds the unit square onto the triangle with a uniform density
+        double su, sv;
+        sample_2d(su, sv);
+        real root = sqrt(static_cast<real>(su));
+        real b = static_cast<real>(sv) * root;
+        s.p = l.p + (1 - root) * l.e1 + b * l.e2;
+        s.normal = unit_vector(cross(l.e1, l.e2));
+    }
+
+    vec3 to_light = s.p - p;
+    real distance_squared = to_light.length_squared();
+    real cosine = std::fabs(dot(s.normal, to_light)) / sqrt(distance_squared);
+    if (cosine <= 0)
+        return false;
+    s.emit = emitted(materials[l.mat]);
+    s.pdf = density[l.mat] * distance_squared / cosine;
+    return true;
+}
+
+real light_list::pdf(const ray &r, const hit_record &rec) const
+{
+    if (rec.light == light_shape::none || rec.mat_id >= density.size() || density[rec.mat_id] <= 0)
+        return 0;
+    real length = r.direction().length();
+    real distance = rec.t * length;
+    real cosine = std::fabs(dot(rec.normal, r.direction())) / length;
+    if (cosine <= 0)
+        return 0;
+    return density[rec.mat_id] * distance * distance / cosine;
+}
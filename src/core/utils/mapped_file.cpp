@@ -0,0 +1,100 @@
+#include "utils/mapped_file.hpp"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+std::shared_ptr<const mapped_file> mapped_file::open(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        std::cerr << "Could not map " << path << ": empty or unreadable file" << std::endl;
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The mapping keeps the file open by itself
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        std::cerr << "Could not map " << path << std::endl;
+        if (mapping)
+            CloseHandle(mapping);
+        return nullptr;
+    }
+
+    std::shared_ptr<mapped_file> result(new mapped_file());
+    result->bytes = static_cast<const unsigned char *>(view);
+    result->length = static_cast<size_t>(size.QuadPart);
+    result->mapping = mapping;
+    return result;
+}
+
+mapped_file::~mapped_file()
+{
+    UnmapViewOfFile(bytes);
+    CloseHandle(mapping);
+}
+
+#else
+
+std::shared_ptr<const mapped_file> mapped_file::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        std::cerr << "Could not map " << path << ": empty or unreadable file" << std::endl;
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The mapping keeps the file open by itself
+    void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << "Could not map " << path << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<mapped_file> result(new mapped_file());
+    result->bytes = static_cast<const unsigned char *>(view);
+    result->length = static_cast<size_t>(info.st_size);
+    return result;
+}
+
+mapped_file::~mapped_file()
+{
+    munmap(const_cast<unsigned char *>(bytes), length);
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "utils/planar.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+#include <cmath>
+
+// Distance along r to the plane of the points p with dot(normal, p) == offset,
+// infinite or NaN when r runs parallel to it. Same operations as the packet kernels.
+static inline real plane_distance(const ray &r, const vec3 &normal, real offset)
+{
+    return (offset - dot(normal, r.orig)) / dot(normal, r.dir);
+}
+
+quad::quad(const point3 &q, const vec3 &u, const vec3 &v, material_id m)
+    : q(q), u(u), v(v), mat_id(m)
+{
+    vec3 n = cross(u, v);
+    normal = unit_vector(n);
+    offset = dot(normal, q);
+    vec3 w = n / dot(n, n);
+    alpha_axis = cross(v, w);
+    beta_axis = cross(w, u);
+}
+
+bool quad::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    RT_STAT(tests[test_planar]++);
+    real t = plane_distance(r, normal, offset);
+    if (!(t > t_min && t < t_max))
+        return false;
+
+    point3 p = r.at(t);
+    vec3 rel = p - q;
+    real alpha = dot(rel, alpha_axis), beta = dot(rel, beta_axis);
+    if (!(alpha >= 0 && alpha <= 1 && beta >= 0 && beta <= 1))
+        return false;
+
+    rec.t = t;
+    rec.p = p;
+    rec.set_face_normal(r, normal);
+    rec.mat_id = mat_id;
+    rec.light = light_shape::area;
+    return true;
+}
+
+bool quad::bounding_box(aabb &output_box) const
+{
+    // Pad the box so that axis aligned quads don't produce a zero thickness slab
+    const real pad = 1e-4;
+    output_box = aabb();
+    for (const point3 &corner : {q, q + u, q + v, q + u + v})
+        output_box.expand(corner);
+    output_box.minimum += vec3(-pad, -pad, -pad);
+    output_box.maximum += vec3(pad, pad, pad);
+    return true;
+}
+
+void quad::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    RT_STAT(tests[test_planar] += packet_size);
+    int hits = quad_hit_packet(packet, normal, offset, q, alpha_axis, beta_axis);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+    {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+void quad::add_lights(light_list &lights) const
+{
+    // The two halves have the same area, so every point keeps the same density
+    lights.add_triangle(q, u, v, mat_id);
+    lights.add_triangle(q + u + v, -u, -v, mat_id);
+}
+
+disk::disk(const point3 &center, const vec3 &normal, real radius, material_id m)
+    : center(center), normal(unit_vector(normal)), radius(std::fabs(radius)), mat_id(m)
+{
+    offset = dot(this->normal, center);
+}
+
+bool disk::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    RT_STAT(tests[test_planar]++);
+    real t = plane_distance(r, normal, offset);
+    if (!(t > t_min && t < t_max))
+        return false;
+
+    point3 p = r.at(t);
+    if (!((p - center).length_squared() <= radius * radius))
+        return false;
+
+    rec.t = t;
+    rec.p = p;
+    rec.set_face_normal(r, normal);
+    rec.mat_id = mat_id;
+    rec.light = light_shape::area;
+    return true;
+}
+
+bool disk::bounding_box(aabb &output_box) const
+{
+    // A circle of radius r reaches r * sin out along an axis at that angle to
+    // its normal, padded like the quads
+    const real pad = 1e-4;
+    vec3 extent;
+    for (int a = 0; a < 3; a++)
+        extent.e[a] = radius * std::sqrt(std::fmax(real(0), 1 - normal.e[a] * normal.e[a])) + pad;
+    output_box = aabb(center - extent, center + extent);
+    return true;
+}
+
+void disk::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    RT_STAT(tests[test_planar] += packet_size);
+    int hits = disk_hit_packet(packet, normal, offset, center, radius);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+    {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+void disk::add_lights(light_list &lights) const
+{
+    lights.add_disk(center, normal, radius, mat_id);
+}
+
+plane::plane(const point3 &point, const vec3 &normal, material_id m)
+    : normal(unit_vector(normal)), mat_id(m)
+{
+    offset = dot(this->normal, point);
+}
+
+bool plane::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    RT_STAT(tests[test_planar]++);
+    real t = plane_distance(r, normal, offset);
+    if (!(t > t_min && t < t_max))
+        return false;
+
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.set_face_normal(r, normal);
+    rec.mat_id = mat_id;
+    rec.light = light_shape::none;
+    return true;
+}
+
+bool plane::bounding_box(aabb &) const
+{
+    return false;
+}
+
+void plane::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    RT_STAT(tests[test_planar] += packet_size);
+    int hits = plane_hit_packet(packet, normal, offset);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+    {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
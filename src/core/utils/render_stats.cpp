@@ -0,0 +1,104 @@
+#include "utils/render_stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+static const char* const test_names[stat_test_count] = {"sphere", "triangle", "box", "cube", "planar"};
+static const char* const path_end_names[path_end_count] = {"escaped", "absorbed", "roulette", "max_depth"};
+static const char* const material_class_names[] = {"lambertian", "metal", "dielectric", "diffuse_light"};
+static_assert(sizeof(material_class_names) / sizeof(material_class_names[0]) == material_class_count,
+              "name every alternative of the material variant");
+
+static thread_local render_stats own_stats;
+static thread_local render_stats* current_stats = nullptr;
+
+render_stats& thread_stats() {
+    return current_stats ? *current_stats : own_stats;
+}
+
+void set_thread_stats(render_stats* stats) {
+    current_stats = stats;
+}
+
+uint64_t render_stats::paths() const {
+    uint64_t sum = 0;
+    for (uint64_t n : path_ends)
+        sum += n;
+    return sum;
+}
+
+render_stats& render_stats::operator+=(const render_stats& other) {
+    primary_rays += other.primary_rays;
+    secondary_rays += other.secondary_rays;
+    shadow_rays += other.shadow_rays;
+    hits += other.hits;
+    misses += other.misses;
+    for (int i = 0; i < stat_test_count; i++)
+        tests[i] += other.tests[i];
+    for (int i = 0; i < material_class_count; i++)
+        scatters[i] += other.scatters[i];
+    for (int i = 0; i < path_end_count; i++)
+        path_ends[i] += other.path_ends[i];
+    for (int i = 0; i <= max_histogram_depth; i++)
+        path_length[i] += other.path_length[i];
+    return *this;
+}
+
+// Counts in millions with two decimals
+static std::ostream& millions(std::ostream& out, uint64_t n) {
+    return out << std::fixed << std::setprecision(2) << n / 1e6 << "M";
+}
+
+void render_stats::print(std::ostream& out, double seconds) const {
+    if (!stats_enabled) {
+        out << "Stats : compiled out (RT_NO_STATS)" << std::endl;
+        return;
+    }
+
+    const uint64_t total_paths = std::max<uint64_t>(1, paths());
+    uint64_t segments = 0;
+    for (int i = 0; i <= max_histogram_depth; i++)
+        segments += i * path_length[i];
+
+    out << "Rays : ";
+    millions(out, rays()) << " (";
+    millions(out, primary_rays) << " primary, ";
+    millions(out, shadow_rays) << " shadow, " << std::setprecision(1)
+                                << 100.0 * hits / std::max<uint64_t>(1, hits + misses) << "% hit) ";
+    millions(out, static_cast<uint64_t>(rays() / std::max(seconds, 1e-9))) << "ray/s | Tests :";
+    for (int i = 0; i < stat_test_count; i++)
+        millions(out << " " << test_names[i] << " ", tests[i]);
+    out << "\nPaths :";
+    for (int i = 0; i < path_end_count; i++)
+        out << " " << path_end_names[i] << " " << std::fixed << std::setprecision(1)
+            << 100.0 * path_ends[i] / total_paths << "%";
+    out << ", " << std::setprecision(2) << static_cast<double>(segments) / total_paths << " segments avg | Scatters :";
+    for (int i = 0; i < material_class_count; i++)
+        millions(out << " " << material_class_names[i] << " ", scatters[i]);
+    out << std::endl;
+}
+
+void render_stats::write_json(std::ostream& out, int frame, int max_depth, double seconds) const {
+    out << "{\"frame\": " << frame << ", \"seconds\": " << seconds << ", \"enabled\": " << (stats_enabled ? "true" : "false")
+        << ", \"rays\": {\"primary\": " << primary_rays << ", \"secondary\": " << secondary_rays
+        << ", \"shadow\": " << shadow_rays << ", \"hits\": " << hits << ", \"misses\": " << misses << "}, \"tests\": {";
+    for (int i = 0; i < stat_test_count; i++)
+        out << (i ? ", " : "") << "\"" << test_names[i] << "\": " << tests[i];
+    out << "}, \"scatters\": {";
+    for (int i = 0; i < material_class_count; i++)
+        out << (i ? ", " : "") << "\"" << material_class_names[i] << "\": " << scatters[i];
+    out << "}, \"paths\": {";
+    for (int i = 0; i < path_end_count; i++)
+        out << (i ? ", " : "") << "\"" << path_end_names[i] << "\": " << path_ends[i];
+    // Bin i counts the paths of i segments, the last bin also holds the longer ones
+    out << "}, \"path_length\": [";
+    int bins = std::clamp(max_depth, 0, static_cast<int>(max_histogram_depth));
+    for (int i = 0; i <= bins; i++) {
+        uint64_t n = path_length[i];
+        if (i == bins)
+            for (int j = i + 1; j <= max_histogram_depth; j++)
+                n += path_length[j];
+        out << (i ? ", " : "") << n;
+    }
+    out << "]}" << std::endl;
+}
@@ -0,0 +1,588 @@
+#include "utils/renderer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "utils/integrator.hpp"
+
+static uint32_t morton_index(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint32_t v)
+    {
+        v &= 0xffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+static uint32_t hilbert_index(uint32_t n, uint32_t x, uint32_t y)
+{
+    // n is the side of the enclosing power of two grid
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+std::vector<tile> make_tiles(int width, int height, int tile_size, tile_order order)
+{
+    tile_size = std::max(1, tile_size);
+    int tiles_x = (width + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+
+    uint32_t grid = 1;
+    while (grid < static_cast<uint32_t>(std::max(tiles_x, tiles_y)))
+        grid *= 2;
+
+    std::vector<std::pair<uint32_t, tile>> keyed;
+    keyed.reserve(static_cast<size_t>(tiles_x) * tiles_y);
+    for (int ty = 0; ty < tiles_y; ty++)
+    {
+        for (int tx = 0; tx < tiles_x; tx++)
+        {
+            tile t = {tx * tile_size, ty * tile_size,
+                      std::min(width, (tx + 1) * tile_size), std::min(height, (ty + 1) * tile_size)};
+            uint32_t key = static_cast<uint32_t>(ty * tiles_x + tx);
+            if (order == tile_order::morton)
+                key = morton_index(tx, ty);
+            else if (order == tile_order::hilbert)
+                key = hilbert_index(grid, tx, ty);
+            keyed.push_back({key, t});
+        }
+    }
+
+    std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+
+    std::vector<tile> tiles;
+    tiles.reserve(keyed.size());
+    for (const auto &k : keyed)
+        tiles.push_back(k.second);
+    return tiles;
+}
+
+// Everything a tile needs to add one pass of samples
+struct frame_context
+{
+    const hittable &world;
+    const material_table &materials;
+    const light_list &lights;
+    const camera &cam;
+    const render_settings &settings;
+    image &img;
+    accumulation_buffer &accum;
+    int samples;              // Samples every pixel gets in this pass
+    const int *pixel_samples; // Per pixel sample counts overriding samples, or null
+    const std::atomic<bool> &cancel_requested;
+    std::atomic<bool> &interrupted;
+
+    int samples_at(int i, int j) const
+    {
+        return pixel_samples ? pixel_samples[static_cast<size_t>(j) * img.width + i] : samples;
+    }
+
+    // Checked before every row, so that a cancelled frame stops within a row of
+    // each tile. The rows already done keep their samples.
+    bool stop() const
+    {
+        if (!cancel_requested.load(std::memory_order_relaxed))
+            return false;
+        interrupted.store(true, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+static void add_features(path_features &sum, const path_features &sample)
+{
+    sum.albedo += sample.albedo;
+    sum.normal += sample.normal;
+    sum.depth += sample.depth;
+}
+
+// Render threads write floats only, tonemap() makes the 8-bit pixels once the frame is done
+static void finish_pixel(const frame_context &frame, int i, int j, const color &pixel_color, double lum_sq, int samples,
+                         const path_features &feature_sum)
+{
+    frame.accum.add(i, j, pixel_color, lum_sq, samples);
+    if (frame.accum.has_features())
+        frame.accum.add_features(i, j, feature_sum.albedo, feature_sum.normal, feature_sum.depth);
+    const color mean = frame.accum.sum(i, j) / frame.accum.count(i, j);
+    float *out = frame.img.hdr.data() + (static_cast<size_t>(j) * frame.img.width + i) * 4;
+    out[0] = static_cast<float>(mean.e[0]);
+    out[1] = static_cast<float>(mean.e[1]);
+    out[2] = static_cast<float>(mean.e[2]);
+    out[3] = 1.0f;
+}
+
+static void render_tile(const tile &t, const frame_context &frame)
+{
+    const render_settings &settings = frame.settings;
+    const path_integrator integrator(frame.materials, frame.lights, settings.max_depth, settings.rr_min_depth,
+                                     settings.rr_threshold);
+
+    for (int j = t.y0; j < t.y1; ++j)
+    {
+        if (frame.stop())
+            return;
+        for (int i = t.x0; i < t.x1; ++i)
+        {
+            const int samples = frame.samples_at(i, j);
+            if (samples <= 0)
+                continue;
+
+            // Pixels keep counting their sample indices across passes and frames
+            const int first_sample = frame.accum.count(i, j);
+            color pixel_color(0, 0, 0);
+            double lum_sq = 0;
+            path_features feature_sum;
+            // Anti-aliasing
+            for (int s = 0; s < samples; s++)
+            {
+                start_pixel_sample(i, j, first_sample + s, settings.seed, settings.sampler,
+                                   settings.samples_per_pixel);
+                double jx, jy;
+                sample_2d(jx, jy);
+                auto u = (i + jx) / (frame.img.width - 1);
+                auto v = (j + jy) / (frame.img.height - 1);
+                ray r = frame.cam.get_ray(u, v);
+                path_features features;
+                color c = integrator.li(r, frame.world, frame.accum.has_features() ? &features : nullptr);
+                pixel_color += c;
+                lum_sq += luminance(c) * luminance(c);
+                add_features(feature_sum, features);
+            }
+            finish_pixel(frame, i, j, pixel_color, lum_sq, samples, feature_sum);
+        }
+    }
+}
+
+// Traces the camera rays of packet_size neighbouring pixels in a row together,
+// for passes that give every pixel the same number of samples.
+// Each lane keeps its own copy of the generator and sampler, so every sample draws the same
+// numbers as in render_tile and both paths produce the same image.
+static void render_tile_packets(const tile &t, const frame_context &frame)
+{
+    const render_settings &settings = frame.settings;
+    const hittable &world = frame.world;
+    const path_integrator integrator(frame.materials, frame.lights, settings.max_depth, settings.rr_min_depth,
+                                     settings.rr_threshold);
+    const real t_min = 0.001;
+
+    for (int j = t.y0; j < t.y1; ++j)
+    {
+        if (frame.stop())
+            return;
+        for (int x0 = t.x0; x0 < t.x1; x0 += packet_size)
+        {
+            const int lanes = std::min(packet_size, t.x1 - x0);
+            color pixel_colors[packet_size];
+            double lum_sq[packet_size] = {};
+            path_features feature_sums[packet_size];
+            int first_sample[packet_size];
+            for (int l = 0; l < lanes; l++)
+                first_sample[l] = frame.accum.count(x0 + l, j);
+
+            for (int s = 0; s < frame.samples; s++)
+            {
+                ray_packet packet;
+                packet.t_min = t_min;
+                ray rays[packet_size];
+                pcg32 lane_rng[packet_size];
+                pixel_sampler lane_sampler[packet_size];
+                const hittable *hit_objects[packet_size] = {};
+
+                for (int l = 0; l < packet_size; l++)
+                {
+                    if (l >= lanes)
+                    {
+                        packet.deactivate(l);
+                        continue;
+                    }
+                    start_pixel_sample(x0 + l, j, first_sample[l] + s, settings.seed, settings.sampler,
+                                       settings.samples_per_pixel);
+                    double jx, jy;
+                    sample_2d(jx, jy);
+                    auto u = (x0 + l + jx) / (frame.img.width - 1);
+                    auto v = (j + jy) / (frame.img.height - 1);
+                    rays[l] = frame.cam.get_ray(u, v);
+                    lane_rng[l] = thread_rng();
+                    lane_sampler[l] = thread_sampler();
+                    packet.set(l, rays[l], infinity);
+                }
+
+                if (settings.max_depth > 0)
+                    world.hit_packet(packet, hit_objects);
+
+                for (int l = 0; l < lanes; l++)
+                {
+                    if (settings.max_depth <= 0)
+                        continue;
+
+                    thread_rng() = lane_rng[l];
+                    thread_sampler() = lane_sampler[l];
+
+                    // Let the object that won the lane fill in the hit record. Allow a little
+                    // slack over the packet's distance in case the kernels rounded differently.
+                    hit_record rec;
+                    bool hit = false;
+                    if (hit_objects[l])
+                    {
+                        real t_hit = packet.t_max[l];
+                        hit = hit_objects[l]->hit(rays[l], t_min, t_hit + 1e-9 * (1.0 + fabs(t_hit)), rec);
+                        if (!hit)
+                            hit = world.hit(rays[l], t_min, infinity, rec);
+                    }
+                    path_features features;
+                    color c = integrator.li(rays[l], hit, rec, world, frame.accum.has_features() ? &features : nullptr);
+                    pixel_colors[l] += c;
+                    lum_sq[l] += luminance(c) * luminance(c);
+                    add_features(feature_sums[l], features);
+                }
+            }
+
+            for (int l = 0; l < lanes; l++)
+                finish_pixel(frame, x0 + l, j, pixel_colors[l], lum_sq[l], frame.samples, feature_sums[l]);
+        }
+    }
+}
+
+render_job::render_job(const hittable &world, const material_table &materials, const camera &cam, image &img,
+                       const render_settings &settings, bool progressive, progress_callback progress,
+                       std::chrono::milliseconds progress_interval)
+    : world(world), materials(materials), cam(cam), img(img), settings(settings), progressive(progressive),
+      progress(std::move(progress)), progress_interval(progress_interval), future(promise.get_future().share())
+{
+}
+
+renderer::renderer(const render_settings &settings)
+    : settings(settings), pool(settings.num_threads), worker_stats(pool.size()), driver([this] { driver_loop(); })
+{
+}
+
+renderer::~renderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+        for (auto &job : jobs)
+            job->cancel();
+    }
+    jobs_available.notify_all();
+    driver.join();
+}
+
+std::shared_ptr<render_job> renderer::submit(const hittable &world, const material_table &materials, const camera &cam,
+                                             image &img, bool progressive, progress_callback progress)
+{
+    auto job = std::make_shared<render_job>(world, materials, cam, img, settings, progressive, std::move(progress),
+                                            progress_interval);
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(job);
+    }
+    jobs_available.notify_one();
+    return job;
+}
+
+std::shared_ptr<render_job> renderer::submit_region(const hittable &world, const material_table &materials,
+                                                    const camera &cam, image &img, const tile &region,
+                                                    progress_callback progress)
+{
+    auto job = std::make_shared<render_job>(world, materials, cam, img, settings, false, std::move(progress),
+                                            progress_interval);
+    job->region = region;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(job);
+    }
+    jobs_available.notify_one();
+    return job;
+}
+
+void renderer::render(const hittable &world, const material_table &materials, const camera &cam, image &img,
+                      const progress_callback &progress)
+{
+    submit(world, materials, cam, img, false, progress)->wait();
+}
+
+void renderer::render_progressive(const hittable &world, const material_table &materials, const camera &cam, image &img,
+                                  const progress_callback &progress)
+{
+    submit(world, materials, cam, img, true, progress)->wait();
+}
+
+void renderer::reset_accumulation()
+{
+    accum_camera.reset();
+    lights.reset();
+}
+
+int renderer::accumulated_samples() const
+{
+    size_t pixels = static_cast<size_t>(accum.width) * accum.height;
+    return pixels ? static_cast<int>(accum.total_samples() / pixels) : 0;
+}
+
+// Runs the submitted frames one at a time. Sleeps on the pool while it
+// renders, the workers do all of the tracing.
+void renderer::driver_loop()
+{
+    std::unique_lock<std::mutex> lock(jobs_mutex);
+    while (true)
+    {
+        jobs_available.wait(lock, [&] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+        std::shared_ptr<render_job> job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
+        job_state end = job_state::cancelled;
+        if (!job->cancel_requested.load(std::memory_order_relaxed))
+        {
+            job->status.store(job_state::running, std::memory_order_release);
+            auto start = std::chrono::steady_clock::now();
+            run_job(*job);
+            job->render_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!job->interrupted.load(std::memory_order_relaxed))
+                end = job_state::finished;
+        }
+        job->status.store(end, std::memory_order_release);
+        job->promise.set_value(end);
+
+        lock.lock();
+    }
+}
+
+void renderer::run_job(render_job &job)
+{
+    const render_settings &settings = job.settings;
+    image &img = job.img;
+
+    const bool features = !job.region && (settings.features || settings.denoise.enabled);
+    if (job.region)
+    {
+        // Pixel samples count from 0 again, as they do in a whole frame
+        const tile &r = *job.region;
+        if (accum.width != img.width || accum.height != img.height)
+            accum.reset(img.width, img.height);
+        else
+            accum.clear(r.x0, r.y0, r.x1, r.y1);
+        accum_camera.reset();
+    }
+    else if (!job.progressive)
+    {
+        accum.reset(img.width, img.height, features);
+        accum_camera.reset();
+    }
+    else
+    {
+        bool same_view = accum_camera && *accum_camera == job.cam && accum_world == &job.world &&
+                         accum_materials == &job.materials && accum.width == img.width && accum.height == img.height &&
+                         accum.has_features() == features &&
+                         accum_settings.max_depth == settings.max_depth &&
+                         accum_settings.rr_min_depth == settings.rr_min_depth &&
+                         accum_settings.rr_threshold == settings.rr_threshold &&
+                         accum_settings.seed == settings.seed && accum_settings.sampler == settings.sampler;
+        if (!same_view)
+        {
+            accum.reset(img.width, img.height, features);
+            accum_camera = job.cam;
+            accum_world = &job.world;
+            accum_materials = &job.materials;
+            accum_settings = settings;
+        }
+    }
+
+    if (img.width != tiles_width || img.height != tiles_height || settings.tile_size != tiles_size || settings.order != tiles_order)
+    {
+        tiles = make_tiles(img.width, img.height, settings.tile_size, settings.order);
+        tiles_width = img.width;
+        tiles_height = img.height;
+        tiles_size = settings.tile_size;
+        tiles_order = settings.order;
+    }
+
+    // Gathered once per world, walking every primitive would cost as much as a
+    // small frame
+    if (!lights || lights_world != &job.world || lights_materials != &job.materials)
+    {
+        lights.emplace(job.world, job.materials);
+        lights_world = &job.world;
+        lights_materials = &job.materials;
+    }
+
+    if (img.hdr.size() != static_cast<size_t>(img.width) * img.height * 4)
+        img.hdr.assign(static_cast<size_t>(img.width) * img.height * 4, 0.0f);
+
+    for (render_stats &s : worker_stats)
+        s.clear();
+
+    const frame_context frame = {job.world, job.materials, *lights, job.cam, settings, img, accum,
+                                 settings.samples_per_pixel, nullptr, job.cancel_requested, job.interrupted};
+    if (job.region)
+    {
+        const tile &r = *job.region;
+        std::vector<tile> region_tiles = make_tiles(r.x1 - r.x0, r.y1 - r.y0, settings.tile_size, settings.order);
+        for (tile &t : region_tiles)
+            t = {t.x0 + r.x0, t.y0 + r.y0, t.x1 + r.x0, t.y1 + r.y0};
+        run_pass(region_tiles, frame, job);
+    }
+    else if (settings.adaptive)
+        render_adaptive(frame, job);
+    else
+        run_pass(tiles, frame, job);
+
+    if (features)
+    {
+        resolve_features(accum, img, pool);
+        // A cancelled frame keeps its noisy radiance, the rows it missed would
+        // blur into the rest
+        if (settings.denoise.enabled && !job.interrupted.load(std::memory_order_relaxed))
+            denoise(accum, img, settings.denoise, pool);
+    }
+
+    // Tone map the frame in bands of rows, cancelled frames too so that the
+    // rows they got to show up
+    const tile area = job.region ? *job.region : tile{0, 0, img.width, img.height};
+    const int band = 16;
+    pool.parallel_for((area.y1 - area.y0 + band - 1) / band, [&](int index, int)
+                      {
+        int y0 = area.y0 + index * band;
+        tonemap(img, settings.display, area.x0, y0, area.x1, std::min(area.y1, y0 + band)); });
+
+    stats.clear();
+    for (const render_stats &s : worker_stats)
+        stats += s;
+    job.frame_stats = stats;
+}
+
+void renderer::render_adaptive(const frame_context &frame, render_job &job)
+{
+    const render_settings &settings = frame.settings;
+    const int width = frame.img.width, height = frame.img.height;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const int max_spp = std::max(2, settings.max_spp);
+    const int min_spp = std::clamp(settings.min_spp, 2, max_spp);
+    int64_t budget = static_cast<int64_t>(settings.samples_per_pixel) * pixels;
+
+    frame_context pass = frame;
+    pass_samples.assign(pixels, 0);
+
+    // Bring every pixel up to min_spp. On a fresh buffer all pixels need the
+    // same count, which keeps the packet path usable.
+    int64_t base = 0;
+    bool uniform = true;
+    for (int j = 0; j < height; j++)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            int need = std::max(0, min_spp - accum.count(i, j));
+            pass_samples[static_cast<size_t>(j) * width + i] = need;
+            uniform = uniform && need == pass_samples[0];
+            base += need;
+        }
+    }
+    if (base > 0)
+    {
+        pass.samples = pass_samples[0];
+        pass.pixel_samples = uniform ? nullptr : pass_samples.data();
+        if (!run_pass(tiles, pass, job))
+            return;
+        budget -= base;
+    }
+
+    // Refine the noisiest pixels. Each pass offers a pixel half its current
+    // count again, so the number of passes grows with the log of max_spp.
+    std::vector<std::pair<double, size_t>> candidates;
+    while (budget > 0)
+    {
+        candidates.clear();
+        int64_t wanted = 0;
+        for (int j = 0; j < height; j++)
+        {
+            for (int i = 0; i < width; i++)
+            {
+                size_t index = static_cast<size_t>(j) * width + i;
+                pass_samples[index] = 0;
+                int count = accum.count(i, j);
+                double error = accum.relative_error(i, j);
+                if (count >= max_spp || error <= settings.error_threshold)
+                    continue;
+                candidates.push_back({error, index});
+                pass_samples[index] = std::min(max_spp - count, std::max(min_spp, count / 2));
+                wanted += pass_samples[index];
+            }
+        }
+        if (candidates.empty())
+            break;
+
+        // Out of budget for all of them, serve the largest errors first
+        if (wanted > budget)
+        {
+            std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b)
+                      { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+            int64_t granted = 0;
+            for (const auto &c : candidates)
+            {
+                int &samples = pass_samples[c.second];
+                samples = static_cast<int>(std::min<int64_t>(samples, budget - granted));
+                granted += samples;
+            }
+            wanted = granted;
+        }
+
+        pass.pixel_samples = pass_samples.data();
+        if (!run_pass(tiles, pass, job))
+            return;
+        budget -= wanted;
+    }
+}
+
+// Returns false when the frame was cancelled
+bool renderer::run_pass(const std::vector<tile> &pass_tiles, const frame_context &frame, render_job &job)
+{
+    const int total = static_cast<int>(pass_tiles.size());
+    const bool packets = frame.settings.packets && !frame.pixel_samples;
+    const int done_before = job.total_tiles.fetch_add(total, std::memory_order_relaxed);
+
+    pool.run(total, [&](int index, int worker)
+             {
+        if (frame.stop())
+            return;
+        set_thread_stats(&worker_stats[worker]);
+        if (packets)
+            render_tile_packets(pass_tiles[index], frame);
+        else
+            render_tile(pass_tiles[index], frame); });
+
+    // Sleep on the pool, waking up only to hand out progress
+    auto report = [&](int completed)
+    {
+        job.done_tiles.store(done_before + completed, std::memory_order_relaxed);
+        if (job.progress)
+            job.progress(done_before + completed, job.total_tiles.load(std::memory_order_relaxed));
+    };
+    while (!pool.wait_for(std::max(job.progress_interval, std::chrono::milliseconds(1))))
+        report(pool.tasks_completed());
+    report(total);
+
+    return !job.interrupted.load(std::memory_order_relaxed);
+}
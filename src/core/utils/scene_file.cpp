@@ -0,0 +1,401 @@
+#include "utils/scene_file.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+
+#include "utils/sphere.hpp"
+#include "utils/cube.hpp"
+#include "utils/planar.hpp"
+#include "utils/instance.hpp"
+#include "utils/triangle_mesh.hpp"
+
+// Words of one statement, taken front to back
+struct scene_statement {
+    std::vector<std::string> words;
+    size_t next = 0;
+
+    bool done() const { return next == words.size(); }
+
+    bool word(std::string &out)
+    {
+        if (done())
+            return false;
+        out = words[next++];
+        return true;
+    }
+
+    bool number(double &out)
+    {
+        if (done())
+            return false;
+        const char *text = words[next].c_str();
+        char *end;
+        out = std::strtod(text, &end);
+        if (end == text || *end != '\0')
+            return false;
+        next++;
+        return true;
+    }
+
+    bool triple(vec3 &out)
+    {
+        double x, y, z;
+        if (!number(x) || !number(y) || !number(z))
+            return false;
+        out = vec3(x, y, z);
+        return true;
+    }
+};
+
+// Objects between begin and end, placed later by instance statements
+struct scene_group {
+    std::string name;
+    hittable_list objects;
+    std::vector<instance> instances;
+};
+
+// Everything a statement may refer to besides the scene itself
+struct scene_context {
+    std::string directory; // Of the scene file, ends with a separator or is empty
+    std::unordered_map<std::string, material_id> materials;
+    std::unordered_map<std::string, shared_ptr<const hittable>> groups; // Closed groups by name
+    std::optional<scene_group> open;  // Group that objects currently go to, if any
+    std::vector<instance> instances;  // Top level instances, gathered into one instance_bvh
+
+    hittable_list &objects(scene &result) { return open ? open->objects : result.objects; }
+};
+
+static bool is_absolute(const std::string &path)
+{
+    return (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+}
+
+static const char *parse_material_ref(scene_statement &s, const scene_context &context, material_id &id)
+{
+    std::string name;
+    if (!s.word(name))
+        return "missing material";
+    auto found = context.materials.find(name);
+    if (found == context.materials.end())
+        return "unknown material";
+    id = found->second;
+    return nullptr;
+}
+
+static const char *parse_camera(scene_statement &s, scene &result)
+{
+    if (result.view)
+        return "second camera";
+    camera_settings view;
+    std::string key;
+    while (s.word(key))
+    {
+        bool ok;
+        if (key == "from")
+            ok = s.triple(view.lookfrom);
+        else if (key == "at")
+            ok = s.triple(view.lookat);
+        else if (key == "up")
+            ok = s.triple(view.vup);
+        else if (key == "fov")
+            ok = s.number(view.vfov) && view.vfov > 0 && view.vfov < 180;
+        else if (key == "aperture")
+            ok = s.number(view.aperture) && view.aperture >= 0;
+        else if (key == "focus")
+            ok = s.number(view.focus_dist) && view.focus_dist >= 0;
+        else
+            return "unknown camera setting";
+        if (!ok)
+            return "malformed camera setting";
+    }
+    if ((view.lookat - view.lookfrom).near_zero() || cross(view.vup, view.lookat - view.lookfrom).near_zero())
+        return "camera looks nowhere or along its up vector";
+    result.view = view;
+    return nullptr;
+}
+
+static const char *parse_material(scene_statement &s, scene &result, scene_context &context)
+{
+    std::string name, type;
+    if (!s.word(name) || !s.word(type))
+        return "malformed material";
+    if (context.materials.count(name))
+        return "material named twice";
+
+    vec3 albedo;
+    double param;
+    material_id id;
+    if (type == "lambertian" && s.triple(albedo))
+        id = result.materials.add(lambertian(albedo));
+    else if (type == "metal" && s.triple(albedo) && s.number(param))
+        id = result.materials.add(metal(albedo, param));
+    else if (type == "dielectric" && s.number(param))
+        id = result.materials.add(dielectric(param));
+    else if (type == "diffuse_light" && s.triple(albedo))
+        id = result.materials.add(diffuse_light(albedo));
+    else
+        return "malformed material";
+    if (!s.done())
+        return "trailing words";
+    context.materials[name] = id;
+    return nullptr;
+}
+
+static const char *parse_mesh(scene_statement &s, scene &result, scene_context &context)
+{
+    std::string file;
+    material_id mat;
+    if (!s.word(file))
+        return "missing mesh path";
+    if (const char *error = parse_material_ref(s, context, mat))
+        return error;
+
+    double scale = 1;
+    vec3 translate(0, 0, 0);
+    std::string key;
+    while (s.word(key))
+    {
+        bool ok;
+        if (key == "scale")
+            ok = s.number(scale) && scale != 0;
+        else if (key == "translate")
+            ok = s.triple(translate);
+        else
+            return "unknown mesh setting";
+        if (!ok)
+            return "malformed mesh setting";
+    }
+
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices;
+    if (!load_obj(is_absolute(file) ? file : context.directory + file, vertices, indices))
+        return "mesh not loaded";
+    for (point3 &v : vertices)
+        v = v * scale + translate;
+    context.objects(result).add(make_shared<triangle_mesh>(std::move(vertices), std::move(indices), mat));
+    return nullptr;
+}
+
+static const char *parse_begin(scene_statement &s, scene_context &context)
+{
+    std::string name;
+    if (context.open)
+        return "group inside a group";
+    if (!s.word(name) || !s.done())
+        return "malformed group";
+    if (context.groups.count(name))
+        return "group named twice";
+    context.open = scene_group{name, {}, {}};
+    return nullptr;
+}
+
+// The group becomes one bottom level structure. A lone object keeps its own:
+// a mesh or a single instance_bvh needs no bvh around it.
+static const char *parse_end(scene_statement &s, scene_context &context)
+{
+    if (!context.open)
+        return "end without begin";
+    if (!s.done())
+        return "trailing words";
+    scene_group &group = *context.open;
+    if (!group.instances.empty())
+        group.objects.add(make_shared<instance_bvh>(std::move(group.instances)));
+    if (group.objects.objects.empty())
+        return "empty group";
+    if (group.objects.objects.size() == 1)
+        context.groups[group.name] = group.objects.objects[0];
+    else
+        context.groups[group.name] = make_shared<bvh>(group.objects);
+    context.open.reset();
+    return nullptr;
+}
+
+static const char *parse_instance(scene_statement &s, scene_context &context)
+{
+    std::string name;
+    if (!s.word(name))
+        return "missing group name";
+    auto found = context.groups.find(name);
+    if (found == context.groups.end())
+        return "unknown group";
+
+    // Applied in the order they are written
+    affine_transform object_to_world;
+    std::string key;
+    while (s.word(key))
+    {
+        affine_transform step;
+        if (key == "scale")
+        {
+            // One factor for every axis or three
+            double x, y, z;
+            if (!s.number(x))
+                return "malformed instance setting";
+            if (s.number(y))
+            {
+                if (!s.number(z))
+                    return "malformed instance setting";
+            }
+            else
+                y = z = x;
+            if (x == 0 || y == 0 || z == 0)
+                return "malformed instance setting";
+            step = affine_transform::scale(vec3(x, y, z));
+        }
+        else if (key == "rotate")
+        {
+            vec3 axis;
+            double degrees;
+            if (!s.triple(axis) || axis.near_zero() || !s.number(degrees))
+                return "malformed instance setting";
+            step = affine_transform::rotate(axis, static_cast<real>(degrees_to_radians(degrees)));
+        }
+        else if (key == "translate")
+        {
+            vec3 offset;
+            if (!s.triple(offset))
+                return "malformed instance setting";
+            step = affine_transform::translate(offset);
+        }
+        else
+            return "unknown instance setting";
+        object_to_world = step * object_to_world;
+    }
+
+    (context.open ? context.open->instances : context.instances).emplace_back(found->second, object_to_world);
+    return nullptr;
+}
+
+// Returns null when the statement was added to result, otherwise what is wrong with it
+static const char *parse_statement(scene_statement &s, scene &result, scene_context &context)
+{
+    std::string keyword;
+    s.word(keyword);
+
+    if (keyword == "camera")
+        return parse_camera(s, result);
+    if (keyword == "material")
+        return parse_material(s, result, context);
+    if (keyword == "mesh")
+        return parse_mesh(s, result, context);
+    if (keyword == "begin")
+        return parse_begin(s, context);
+    if (keyword == "end")
+        return parse_end(s, context);
+    if (keyword == "instance")
+        return parse_instance(s, context);
+
+    material_id mat;
+    if (keyword == "sphere")
+    {
+        vec3 center;
+        double radius;
+        if (!s.triple(center) || !s.number(radius) || radius == 0)
+            return "malformed sphere";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<sphere>(center, radius, mat));
+    }
+    else if (keyword == "cube")
+    {
+        vec3 center, up, front;
+        double side;
+        // The box frame is inverted, so up and front must not be parallel
+        if (!s.triple(center) || !s.number(side) || side <= 0 || !s.triple(up) || !s.triple(front) ||
+            cross(up, front).near_zero())
+            return "malformed cube";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<cube>(center, side, up, front, mat));
+    }
+    else if (keyword == "triangle")
+    {
+        vec3 a, b, c;
+        if (!s.triple(a) || !s.triple(b) || !s.triple(c))
+            return "malformed triangle";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<triangle>(a, b, c, mat));
+    }
+    else if (keyword == "quad")
+    {
+        vec3 q, u, v;
+        if (!s.triple(q) || !s.triple(u) || !s.triple(v) || cross(u, v).near_zero())
+            return "malformed quad";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<quad>(q, u, v, mat));
+    }
+    else if (keyword == "disk")
+    {
+        vec3 center, normal;
+        double radius;
+        if (!s.triple(center) || !s.triple(normal) || normal.near_zero() || !s.number(radius) || radius <= 0)
+            return "malformed disk";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<disk>(center, normal, radius, mat));
+    }
+    else if (keyword == "plane")
+    {
+        vec3 point, normal;
+        if (!s.triple(point) || !s.triple(normal) || normal.near_zero())
+            return "malformed plane";
+        if (const char *error = parse_material_ref(s, context, mat))
+            return error;
+        context.objects(result).add(make_shared<plane>(point, normal, mat));
+    }
+    else
+        return "unknown statement";
+
+    return s.done() ? nullptr : "trailing words";
+}
+
+bool load_scene(const std::string &path, scene &result)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    scene_context context;
+    size_t separator = path.find_last_of("/\\");
+    if (separator != std::string::npos)
+        context.directory = path.substr(0, separator + 1);
+
+    std::string line;
+    long line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        std::string text = line.substr(0, line.find('#'));
+
+        scene_statement s;
+        std::istringstream words(text);
+        for (std::string word; words >> word;)
+            s.words.push_back(word);
+        if (s.words.empty())
+            continue;
+
+        if (const char *error = parse_statement(s, result, context))
+        {
+            std::cerr << path << ":" << line_number << ": " << error << ": " << line << std::endl;
+            return false;
+        }
+    }
+
+    if (context.open)
+    {
+        std::cerr << path << ": group " << context.open->name << " has no end" << std::endl;
+        return false;
+    }
+    if (!context.instances.empty())
+        result.objects.add(make_shared<instance_bvh>(std::move(context.instances)));
+    return true;
+}
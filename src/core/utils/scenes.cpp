@@ -0,0 +1,105 @@
+#include "utils/scenes.hpp"
+
+#include <algorithm>
+
+#include "utils/sphere.hpp"
+#include "utils/cube.hpp"
+#include "utils/planar.hpp"
+#include "utils/triangle_mesh.hpp"
+#include "utils/material.hpp"
+
+scene random_scene()
+{
+    scene result;
+    hittable_list &world = result.objects;
+    material_table &materials = result.materials;
+
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    world.add(make_shared<plane>(point3(0, 0, 0), vec3(0, 1, 0), ground_material));
+
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+            {
+                material_id sphere_material;
+
+                if (choose_mat < 0.8)
+                {
+                    // diffuse
+                    auto albedo = random_vec3() * random_vec3();
+                    sphere_material = materials.add(lambertian(albedo));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // metal
+                    auto albedo = random_vec3(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = materials.add(metal(albedo, fuzz));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else
+                {
+                    // glass
+                    sphere_material = materials.add(dielectric(1.5));
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = materials.add(dielectric(1.5));
+    world.add(make_shared<cube>(point3(0, 1, 0), 2, vec3(0, 1, 0), vec3(1, 0, 0), material1));
+
+    auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+    world.add(make_shared<cube>(point3(-4, 1, 0), 3, vec3(0, 1, 0), vec3(1, 0, 0), material2));
+
+    auto material3 = materials.add(metal(color(0.7, 0.6, 0.5), 0.1));
+    world.add(make_shared<cube>(point3(4, 1, 0), 1, vec3(0, 1, 1), vec3(1, 0, 0), material3));
+
+    return result;
+}
+
+scene mesh_scene(std::vector<point3> vertices, std::vector<uint32_t> indices)
+{
+    scene result;
+    hittable_list &world = result.objects;
+
+    auto ground_material = result.materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    world.add(make_shared<plane>(point3(0, 0, 0), vec3(0, 1, 0), ground_material));
+
+    aabb bounds;
+    for (const point3 &v : vertices)
+        bounds.expand(v);
+    if (bounds.empty())
+        return result;
+
+    vec3 extent = bounds.maximum - bounds.minimum;
+    double largest = std::max(extent.x(), std::max(extent.y(), extent.z()));
+    double scale = largest > 0 ? 2.0 / largest : 1.0;
+    point3 base(bounds.centroid().x(), bounds.minimum.y(), bounds.centroid().z());
+    for (point3 &v : vertices)
+        v = (v - base) * scale;
+
+    auto mesh_material = result.materials.add(lambertian(color(0.7, 0.6, 0.5)));
+    world.add(make_shared<triangle_mesh>(std::move(vertices), std::move(indices), mesh_material));
+
+    return result;
+}
+
+camera random_scene_camera(int frame, double aspect_ratio)
+{
+    point3 lookfrom(10 * cos(frame * 0.1), 2, 10 * sin(frame * 0.1));
+    point3 lookat(0, 0, -1);
+    vec3 vup(0, 1, 0);
+    // Focus stays at the distance of the original still shot from (3, 2, 10)
+    auto dist_to_focus = (lookat - point3(3, 2, 10)).length();
+    auto aperture = 0.1;
+
+    return camera(lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus);
+}
@@ -0,0 +1,54 @@
+#include "utils/sphere.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+bool sphere::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    RT_STAT(tests[test_sphere]++);
+    vec3 oc = r.origin() - center;
+    auto a = r.direction().length_squared();
+    auto half_b = dot(oc, r.direction());
+    auto c = oc.length_squared() - radius*radius;
+
+    auto discriminant = half_b*half_b - a*c;
+    if (discriminant < 0) return false;
+    auto sqrtd = sqrt(discriminant);
+
+    // Find the nearest root that lies in the acceptable range.
+    auto root = (-half_b - sqrtd) / a;
+    if (root < t_min || t_max < root) {
+        root = (-half_b + sqrtd) / a;
+        if (root < t_min || t_max < root)
+            return false;
+    }
+
+    rec.t = root;
+    rec.p = r.at(rec.t);
+
+    vec3 outward_normal = (rec.p - center) / radius;
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_id = mat_id;
+    // light_list::sample doesn't pick spheres around the shading point
+    rec.light = c > 0 ? light_shape::sphere : light_shape::none;
+
+    return true;
+}
+
+bool sphere::bounding_box(aabb& output_box) const {
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius));
+    return true;
+}
+
+void sphere::hit_packet(ray_packet& packet, const hittable* hit_objects[]) const {
+    RT_STAT(tests[test_sphere] += packet_size);
+    int hits = sphere_hit_packet(packet, center, radius);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1) {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+void sphere::add_lights(light_list& lights) const {
+    lights.add_sphere(center, radius, mat_id);
+}
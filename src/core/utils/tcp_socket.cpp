@@ -0,0 +1,180 @@
+#include "utils/tcp_socket.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+using native_handle = SOCKET;
+using socket_length = int;
+static const native_handle invalid_handle = INVALID_SOCKET;
+
+static void close_handle(native_handle handle) { closesocket(handle); }
+
+static void start_sockets()
+{
+    static std::once_flag started;
+    std::call_once(started, []
+                   {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data); });
+}
+#else
+using native_handle = int;
+using socket_length = socklen_t;
+static const native_handle invalid_handle = -1;
+
+static void close_handle(native_handle handle) { close(handle); }
+
+static void start_sockets() {}
+#endif
+
+// Small messages go out at once instead of waiting to fill a packet
+static void set_no_delay(native_handle handle)
+{
+    int on = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&on), sizeof(on));
+}
+
+std::unique_ptr<tcp_socket> tcp_socket::connect(const std::string &host, int port)
+{
+    start_sockets();
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        return nullptr;
+
+    std::unique_ptr<tcp_socket> result;
+    for (addrinfo *a = addresses; a && !result; a = a->ai_next)
+    {
+        auto handle = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (handle == invalid_handle)
+            continue;
+        if (::connect(handle, a->ai_addr, static_cast<socket_length>(a->ai_addrlen)) != 0)
+        {
+            close_handle(handle);
+            continue;
+        }
+        set_no_delay(handle);
+        result.reset(new tcp_socket(handle));
+    }
+    freeaddrinfo(addresses);
+    return result;
+}
+
+std::unique_ptr<tcp_socket> tcp_socket::listen(int port)
+{
+    start_sockets();
+    auto handle = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (handle == invalid_handle)
+    {
+        std::cerr << "Could not create a socket" << std::endl;
+        return nullptr;
+    }
+    std::unique_ptr<tcp_socket> result(new tcp_socket(handle));
+
+    // A restarted coordinator can take its port back while the old connections time out
+    int on = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(handle, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(handle, 16) != 0)
+    {
+        std::cerr << "Could not listen on port " << port << std::endl;
+        return nullptr;
+    }
+    return result;
+}
+
+tcp_socket::~tcp_socket()
+{
+    close_handle(handle);
+}
+
+std::unique_ptr<tcp_socket> tcp_socket::accept()
+{
+    auto connection = ::accept(handle, nullptr, nullptr);
+    if (connection == invalid_handle)
+        return nullptr;
+    set_no_delay(connection);
+    return std::unique_ptr<tcp_socket>(new tcp_socket(connection));
+}
+
+bool tcp_socket::send_all(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        int chunk = static_cast<int>(std::min<size_t>(size, 1 << 30));
+#ifdef MSG_NOSIGNAL
+        // A worker that went away is a failed send, not a SIGPIPE
+        auto sent = ::send(handle, bytes, chunk, MSG_NOSIGNAL);
+#else
+        auto sent = ::send(handle, bytes, chunk, 0);
+#endif
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool tcp_socket::receive_all(void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0)
+    {
+        int chunk = static_cast<int>(std::min<size_t>(size, 1 << 30));
+        auto received = ::recv(handle, bytes, chunk, 0);
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void tcp_socket::shutdown()
+{
+#ifdef _WIN32
+    ::shutdown(handle, SD_BOTH);
+#else
+    ::shutdown(handle, SHUT_RDWR);
+#endif
+}
+
+std::string tcp_socket::peer() const
+{
+    sockaddr_storage address = {};
+    socket_length length = sizeof(address);
+    if (getpeername(handle, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+        return "unknown";
+
+    char host[NI_MAXHOST], port[NI_MAXSERV];
+    if (getnameinfo(reinterpret_cast<const sockaddr *>(&address), length, host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        return "unknown";
+    return std::string(host) + ":" + port;
+}
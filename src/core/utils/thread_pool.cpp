@@ -0,0 +1,109 @@
+#include "utils/thread_pool.hpp"
+
+thread_pool::thread_pool(int num_threads) : remaining(0), completed(0) {
+    if (num_threads <= 0)
+        num_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_threads < 1)
+        num_threads = 1;
+
+    for (int i = 0; i < num_threads; i++)
+        queues.push_back(std::make_unique<worker_queue>());
+    for (int i = 0; i < num_threads; i++)
+        workers.emplace_back(&thread_pool::worker_loop, this, i);
+}
+
+thread_pool::~thread_pool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void thread_pool::run(int count, task_function task) {
+    wait();
+
+    // No worker touches the task while nothing is queued, so it is safe to swap it here.
+    // Pushing under the queue mutexes publishes it to whoever pops the first index.
+    this->task = std::move(task);
+    completed.store(0, std::memory_order_relaxed);
+    if (count <= 0)
+        return;
+    remaining.store(count, std::memory_order_release);
+
+    int n = size();
+    for (int w = 0; w < n; w++) {
+        int begin = static_cast<int>(static_cast<long long>(count) * w / n);
+        int end = static_cast<int>(static_cast<long long>(count) * (w + 1) / n);
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (int i = begin; i < end; i++)
+            queues[w]->tasks.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        generation++;
+    }
+    work_available.notify_all();
+}
+
+void thread_pool::wait() {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    work_done.wait(lock, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+}
+
+bool thread_pool::wait_for(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    return work_done.wait_for(lock, timeout, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+}
+
+void thread_pool::worker_loop(int id) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(state_mutex);
+            work_available.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        int index;
+        while (pop(id, index) || steal(id, index)) {
+            task(index, id);
+            completed.fetch_add(1, std::memory_order_relaxed);
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                work_done.notify_all();
+            }
+        }
+    }
+}
+
+bool thread_pool::pop(int id, int& index) {
+    worker_queue& queue = *queues[id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+    index = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool thread_pool::steal(int id, int& index) {
+    // Take from the back, the work furthest away from what the owner is busy with
+    int n = size();
+    for (int k = 1; k < n; k++) {
+        worker_queue& queue = *queues[(id + k) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        index = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,130 @@
+#include "utils/tonemap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if !defined(RT_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define RT_TONEMAP_SSE
+#endif
+
+// 4x4 Bayer matrix, the offsets spread evenly over [0, 1)
+static const float bayer[4][4] = {
+    {0.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16},
+    {12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16},
+    {3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16},
+    {15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16},
+};
+
+// Below this the sRGB curve is a straight line
+static const float srgb_linear_end = 0.0031308f;
+
+#ifdef RT_TONEMAP_SSE
+static inline __m128 curve_sse(__m128 c, tonemap_curve curve)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    switch (curve)
+    {
+    case tonemap_curve::reinhard:
+        return _mm_div_ps(c, _mm_add_ps(one, c));
+    case tonemap_curve::aces:
+    {
+        __m128 top = _mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), c), _mm_set1_ps(0.03f)));
+        __m128 bottom = _mm_add_ps(_mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), c), _mm_set1_ps(0.59f))),
+                                   _mm_set1_ps(0.14f));
+        return _mm_div_ps(top, bottom);
+    }
+    default:
+        return c;
+    }
+}
+
+// Ian Taylor's fit of the sRGB power curve, three square roots instead of a pow
+static inline __m128 transfer_sse(__m128 c, transfer_curve transfer)
+{
+    __m128 s1 = _mm_sqrt_ps(c);
+    if (transfer == transfer_curve::gamma2)
+        return s1;
+    __m128 s2 = _mm_sqrt_ps(s1), s3 = _mm_sqrt_ps(s2);
+    __m128 curve = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.585122381f), s1),
+                                         _mm_mul_ps(_mm_set1_ps(0.783140355f), s2)),
+                              _mm_mul_ps(_mm_set1_ps(0.368262736f), s3));
+    __m128 line = _mm_mul_ps(_mm_set1_ps(12.92f), c);
+    __m128 low = _mm_cmplt_ps(c, _mm_set1_ps(srgb_linear_end));
+    return _mm_or_ps(_mm_and_ps(low, line), _mm_andnot_ps(low, curve));
+}
+#else
+// The same curves one channel at a time
+static float curve_scalar(float c, tonemap_curve curve)
+{
+    switch (curve)
+    {
+    case tonemap_curve::reinhard:
+        return c / (1.0f + c);
+    case tonemap_curve::aces:
+        return (c * (2.51f * c + 0.03f)) / (c * (2.43f * c + 0.59f) + 0.14f);
+    default:
+        return c;
+    }
+}
+
+static float transfer_scalar(float c, transfer_curve transfer)
+{
+    float s1 = std::sqrt(c);
+    if (transfer == transfer_curve::gamma2)
+        return s1;
+    if (c < srgb_linear_end)
+        return 12.92f * c;
+    float s2 = std::sqrt(s1), s3 = std::sqrt(s2);
+    return 0.585122381f * s1 + 0.783140355f * s2 - 0.368262736f * s3;
+}
+#endif
+
+void tonemap(image &img, const display_settings &settings, int x0, int y0, int x1, int y1)
+{
+    const float scale = static_cast<float>(std::exp2(settings.exposure));
+    const tonemap_curve curve = settings.curve;
+    const transfer_curve transfer = settings.transfer;
+
+    for (int y = y0; y < y1; y++)
+    {
+        const float *src = img.hdr.data() + (static_cast<size_t>(y) * img.width + x0) * 4;
+        uint8_t *dst = img.data() + (static_cast<size_t>(y) * img.width + x0) * 3;
+        const float *row_dither = bayer[y & 3];
+#ifdef RT_TONEMAP_SSE
+        const __m128 scale4 = _mm_set1_ps(scale);
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        for (int x = x0; x < x1; x++, src += 4, dst += 3)
+        {
+            __m128 c = curve_sse(_mm_mul_ps(_mm_loadu_ps(src), scale4), curve);
+            c = transfer_sse(_mm_min_ps(_mm_max_ps(c, zero), one), transfer); // NaN goes to 0
+            // Truncate 256 v as the book does, or round 255 v at an offset
+            if (settings.dither)
+                c = _mm_min_ps(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), _mm_set1_ps(row_dither[x & 3])),
+                               _mm_set1_ps(255.0f));
+            else
+                c = _mm_mul_ps(_mm_min_ps(c, _mm_set1_ps(0.999f)), _mm_set1_ps(256.0f));
+            __m128i bytes = _mm_cvttps_epi32(c);
+            bytes = _mm_packus_epi16(_mm_packs_epi32(bytes, bytes), bytes);
+            uint32_t rgba = static_cast<uint32_t>(_mm_cvtsi128_si32(bytes));
+            dst[0] = static_cast<uint8_t>(rgba);
+            dst[1] = static_cast<uint8_t>(rgba >> 8);
+            dst[2] = static_cast<uint8_t>(rgba >> 16);
+        }
+#else
+        for (int x = x0; x < x1; x++, src += 4, dst += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                float c = curve_scalar(src[k] * scale, curve);
+                c = transfer_scalar(std::min(std::max(0.0f, c), 1.0f), transfer); // NaN goes to 0
+                if (settings.dither)
+                    c = std::min(c * 255.0f + row_dither[x & 3], 255.0f);
+                else
+                    c = std::min(c, 0.999f) * 256.0f;
+                dst[k] = static_cast<uint8_t>(c);
+            }
+        }
+#endif
+    }
+}
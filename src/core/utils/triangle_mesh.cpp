@@ -0,0 +1,388 @@
+#include "utils/triangle_mesh.hpp"
+#include "utils/lights.hpp"
+#include "utils/render_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+triangle_mesh::triangle_mesh(std::vector<point3> vertices, std::vector<uint32_t> indices,
+                             material_id m, int max_leaf_size)
+    : vertices(std::move(vertices)), mat_id(m)
+{
+    // Pad the boxes so that axis aligned triangles don't produce a zero thickness slab
+    const double pad = 1e-4;
+    const uint32_t count = static_cast<uint32_t>(indices.size() / 3);
+
+    std::vector<bvh_primitive> prims;
+    prims.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        aabb box;
+        for (int k = 0; k < 3; k++)
+            box.expand(this->vertices[indices[3 * i + k]]);
+        box.minimum += vec3(-pad, -pad, -pad);
+        box.maximum += vec3(pad, pad, pad);
+        prims.push_back({box, box.centroid(), i});
+    }
+
+    nodes = build_bvh(prims, max_leaf_size);
+
+    this->indices.reserve(3 * prims.size());
+    triangles.reserve(prims.size());
+    for (const auto &prim : prims)
+    {
+        const uint32_t *tri = &indices[3 * prim.index];
+        this->indices.insert(this->indices.end(), tri, tri + 3);
+
+        const point3 &v0 = this->vertices[tri[0]];
+        vec3 e1 = this->vertices[tri[1]] - v0;
+        vec3 e2 = this->vertices[tri[2]] - v0;
+        precomputed_triangle pre;
+        for (int k = 0; k < 3; k++)
+        {
+            pre.v0[k] = static_cast<float>(v0.e[k]);
+            pre.e1[k] = static_cast<float>(e1.e[k]);
+            pre.e2[k] = static_cast<float>(e2.e[k]);
+        }
+        triangles.push_back(pre);
+    }
+}
+
+// Same operations as triangle_hit_packet, so the scalar and packet paths agree
+static inline bool intersect(const real v0[3], const real e1[3], const real e2[3],
+                             const point3 &o, const vec3 &d, real t_min, real t_max, real &t)
+{
+    real hx = d.e[1] * e2[2] - d.e[2] * e2[1];
+    real hy = d.e[2] * e2[0] - d.e[0] * e2[2];
+    real hz = d.e[0] * e2[1] - d.e[1] * e2[0];
+    real a = e1[0] * hx + e1[1] * hy + e1[2] * hz;
+    // a grows with the edges and the direction, so only a ray in the plane
+    // of the triangle is rejected, any epsilon would drop small triangles
+    if (a == 0.0)
+        return false;
+
+    real f = 1.0 / a;
+    real sx = o.e[0] - v0[0], sy = o.e[1] - v0[1], sz = o.e[2] - v0[2];
+    real u = f * (sx * hx + sy * hy + sz * hz);
+    if (u < 0.0 || u > 1.0)
+        return false;
+
+    real qx = sy * e1[2] - sz * e1[1];
+    real qy = sz * e1[0] - sx * e1[2];
+    real qz = sx * e1[1] - sy * e1[0];
+    real v = f * (d.e[0] * qx + d.e[1] * qy + d.e[2] * qz);
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+
+    t = f * (e2[0] * qx + e2[1] * qy + e2[2] * qz);
+    return t > t_min && t < t_max;
+}
+
+int64_t triangle_mesh::find_triangle(const ray &r, real t_min, real &t_max, bool any_hit) const
+{
+    if (nodes.empty())
+        return -1;
+
+    const point3 origin = r.origin();
+    const vec3 dir = r.direction();
+    const vec3 inv_dir(1.0 / dir.e[0], 1.0 / dir.e[1], 1.0 / dir.e[2]);
+    const bool dir_is_neg[3] = {inv_dir.e[0] < 0, inv_dir.e[1] < 0, inv_dir.e[2] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real t_enter;
+    int64_t closest = -1;
+    uint64_t boxes = 0, tested = 0;
+
+    while (!(any_hit && closest >= 0))
+    {
+        const bvh_node &node = nodes[current];
+        boxes++;
+        if (node.box.hit(origin, inv_dir, t_min, t_max, t_enter))
+        {
+            if (node.count > 0)
+            {
+                tested += node.count;
+                for (uint32_t i = node.offset; i < node.offset + node.count && !(any_hit && closest >= 0); i++)
+                {
+                    const precomputed_triangle &tri = triangles[i];
+                    const real v0[3] = {tri.v0[0], tri.v0[1], tri.v0[2]};
+                    const real e1[3] = {tri.e1[0], tri.e1[1], tri.e1[2]};
+                    const real e2[3] = {tri.e2[0], tri.e2[1], tri.e2[2]};
+                    real t;
+                    if (intersect(v0, e1, e2, origin, dir, t_min, t_max, t))
+                    {
+                        t_max = t;
+                        closest = i;
+                    }
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                // The second child holds the larger coordinates, so it is nearer
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    RT_STAT(tests[test_triangle] += tested);
+    return closest;
+}
+
+bool triangle_mesh::hit(const ray &r, real t_min, real t_max, hit_record &rec) const
+{
+    int64_t closest = find_triangle(r, t_min, t_max, false);
+    if (closest < 0)
+        return false;
+
+    const precomputed_triangle &tri = triangles[closest];
+    vec3 e1(tri.e1[0], tri.e1[1], tri.e1[2]);
+    vec3 e2(tri.e2[0], tri.e2[1], tri.e2[2]);
+    rec.t = t_max;
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, unit_vector(cross(e1, e2)));
+    rec.mat_id = mat_id;
+    rec.light = light_shape::area;
+    return true;
+}
+
+bool triangle_mesh::occluded(const ray &r, real t_min, real t_max) const
+{
+    return find_triangle(r, t_min, t_max, true) >= 0;
+}
+
+void triangle_mesh::add_lights(light_list &lights) const
+{
+    // The triangles as hit() sees them
+    for (const precomputed_triangle &tri : triangles)
+        lights.add_triangle(point3(tri.v0[0], tri.v0[1], tri.v0[2]), vec3(tri.e1[0], tri.e1[1], tri.e1[2]),
+                            vec3(tri.e2[0], tri.e2[1], tri.e2[2]), mat_id);
+}
+
+void triangle_mesh::hit_packet(ray_packet &packet, const hittable *hit_objects[]) const
+{
+    if (nodes.empty())
+        return;
+
+    // Like bvh::hit_packet, the packet follows the child order of its first active ray
+    int first = 0;
+    while (first < packet_size && !packet.active(first))
+        first++;
+    if (first == packet_size)
+        return;
+    const bool dir_is_neg[3] = {packet.inv_dx[first] < 0, packet.inv_dy[first] < 0, packet.inv_dz[first] < 0};
+
+    uint32_t stack[bvh::max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+    int hits = 0;
+    uint64_t boxes = 0, tested = 0;
+
+    while (true)
+    {
+        const bvh_node &node = nodes[current];
+        boxes += packet_size;
+        if (box_hit_packet(packet, node.box.minimum, node.box.maximum))
+        {
+            if (node.count > 0)
+            {
+                tested += node.count * packet_size;
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                {
+                    const precomputed_triangle &tri = triangles[i];
+                    hits |= triangle_hit_packet(packet, point3(tri.v0[0], tri.v0[1], tri.v0[2]),
+                                                vec3(tri.e1[0], tri.e1[1], tri.e1[2]), vec3(tri.e2[0], tri.e2[1], tri.e2[2]));
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+            else if (dir_is_neg[node.axis])
+            {
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            }
+            else
+            {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        }
+        else
+        {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    RT_STAT(tests[test_box] += boxes);
+    RT_STAT(tests[test_triangle] += tested);
+    for (int lane = 0; hits != 0; lane++, hits >>= 1)
+    {
+        if (hits & 1)
+            hit_objects[lane] = this;
+    }
+}
+
+bool triangle_mesh::bounding_box(aabb &output_box) const
+{
+    if (nodes.empty())
+        return false;
+    output_box = nodes[0].box;
+    return true;
+}
+
+size_t triangle_mesh::memory_size() const
+{
+    return vertices.size() * sizeof(point3) + indices.size() * sizeof(uint32_t) +
+           nodes.size() * sizeof(bvh_node) + triangles.size() * sizeof(precomputed_triangle);
+}
+
+// Parses the vertex reference at text, one of v, v/vt, v/vt/vn or v//vn, and
+// moves text past it. Negative references count back from the last vertex.
+static bool parse_face_vertex(const char *&text, size_t vertex_count, uint32_t &index)
+{
+    char *end;
+    long value = std::strtol(text, &end, 10);
+    if (end == text || value == 0)
+        return false;
+    text = end;
+    while (*text && *text != ' ' && *text != '\t')
+        text++;
+
+    long resolved = value > 0 ? value - 1 : static_cast<long>(vertex_count) + value;
+    if (resolved < 0 || resolved >= static_cast<long>(vertex_count))
+        return false;
+    index = static_cast<uint32_t>(resolved);
+    return true;
+}
+
+static bool parse_obj_line(char *line, std::vector<point3> &vertices, std::vector<uint32_t> &indices)
+{
+    while (*line == ' ' || *line == '\t')
+        line++;
+
+    if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+    {
+        char *text = line + 2;
+        double xyz[3];
+        for (double &c : xyz)
+        {
+            char *end;
+            c = std::strtod(text, &end);
+            if (end == text)
+                return false;
+            text = end;
+        }
+        vertices.push_back(point3(xyz[0], xyz[1], xyz[2]));
+    }
+    else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+    {
+        const char *text = line + 2;
+        uint32_t first = 0, previous = 0, current = 0;
+        int corners = 0;
+        while (true)
+        {
+            while (*text == ' ' || *text == '\t')
+                text++;
+            if (*text == '\0')
+                break;
+            if (!parse_face_vertex(text, vertices.size(), current))
+                return false;
+            // Fan around the first corner
+            if (corners >= 2)
+            {
+                indices.push_back(first);
+                indices.push_back(previous);
+                indices.push_back(current);
+            }
+            if (corners == 0)
+                first = current;
+            previous = current;
+            corners++;
+        }
+        if (corners < 3)
+            return false;
+    }
+    return true;
+}
+
+bool load_obj(const std::string &path, std::vector<point3> &vertices, std::vector<uint32_t> &indices)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    // Lines are parsed in place. A line cut off at the end of a chunk is moved
+    // to the front of the buffer and completed by the next read.
+    const size_t chunk_size = 1 << 20;
+    std::vector<char> buffer(chunk_size + 1);
+    size_t filled = 0;
+    long line_number = 0;
+    bool ok = true;
+
+    while (ok)
+    {
+        if (filled == buffer.size() - 1)
+            buffer.resize(buffer.size() + chunk_size); // Line longer than the buffer
+        size_t read = std::fread(buffer.data() + filled, 1, buffer.size() - 1 - filled, file);
+        filled += read;
+        bool at_end = read == 0;
+        if (at_end && filled == 0)
+            break;
+
+        size_t start = 0;
+        while (true)
+        {
+            char *begin = buffer.data() + start;
+            char *newline = static_cast<char *>(std::memchr(begin, '\n', filled - start));
+            if (!newline)
+            {
+                if (!at_end)
+                    break;
+                newline = buffer.data() + filled; // Last line without a newline
+            }
+            *newline = '\0';
+            line_number++;
+            if (newline > begin && newline[-1] == '\r')
+                newline[-1] = '\0';
+            if (!parse_obj_line(begin, vertices, indices))
+            {
+                std::cerr << path << ":" << line_number << ": malformed statement: " << begin << std::endl;
+                ok = false;
+                break;
+            }
+            start = newline - buffer.data() + 1;
+            if (start >= filled)
+                break;
+        }
+
+        if (at_end)
+            break;
+        filled -= std::min(start, filled);
+        std::memmove(buffer.data(), buffer.data() + start, filled);
+    }
+
+    std::fclose(file);
+    return ok;
+}
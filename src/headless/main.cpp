@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "math/utils.hpp"
+#include "utils/bvh.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/compiled_scene.hpp"
+#include "utils/scene_file.hpp"
+#include "utils/triangle_mesh.hpp"
+#include "utils/scenes.hpp"
+#include "utils/renderer.hpp"
+#include "utils/image.hpp"
+#include "utils/frame_writer.hpp"
+#include "utils/distributed.hpp"
+
+// Offline renderer without any window system, writes every frame straight to disk
+
+struct options {
+    int width = 800;
+    int height = 0; // 0 keeps the 16:9 aspect ratio
+    int frames = 1;
+    int first_frame = 0;
+    bool progressive = false;
+    std::string output = "output/frame_####.png";
+    int encoders = 2; // Threads that encode and write the frames behind the renderer
+    int fps = 30;     // Frame rate of .y4m output
+    std::string obj; // Wavefront OBJ mesh to render instead of random_scene
+    std::string scene; // Text or compiled scene file to render instead of random_scene
+    std::string compile; // Compiled scene file to write instead of rendering
+    std::string stats; // JSON lines file for the per frame statistics, empty for none
+    bool flat = true; // Render from a flat_scene rather than a bvh of the objects
+    int listen = 0; // Port to hand out blocks of the frames on, 0 renders locally
+    std::string coordinator_host; // Render blocks for the coordinator here instead of frames
+    int coordinator_port = 0;
+    render_settings settings;
+};
+
+void print_usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --width N        image width in pixels (default 800)\n"
+              << "  --height N       image height in pixels (default width / (16/9))\n"
+              << "  --spp N          samples per pixel (default 20)\n"
+              << "  --max-depth N    maximum bounces per path (default 50)\n"
+              << "  --rr-min-depth N bounces before Russian roulette starts (default 3)\n"
+              << "  --rr-threshold X roulette paths with throughput below X, 0 disables (default 1)\n"
+              << "  --threads N      render threads, 0 for all cores (default 0)\n"
+              << "  --tile-size N    side of the square screen tiles in pixels (default 16)\n"
+              << "  --tile-order O   scanline, morton or hilbert (default morton)\n"
+              << "  --packets 0|1    trace camera rays in SIMD packets (default 1)\n"
+              << "  --sampler S      independent, stratified, sobol or blue_noise (default sobol)\n"
+              << "  --adaptive 0|1   treat --spp as an average and spend it on the noisiest pixels (default 0)\n"
+              << "  --min-spp N      adaptive: samples every pixel gets first (default 16)\n"
+              << "  --max-spp N      adaptive: most samples a single pixel may take (default 512)\n"
+              << "  --error X        adaptive: relative error at which a pixel is done (default 0.01)\n"
+              << "  --frames N       number of frames of the camera orbit (default 1)\n"
+              << "  --progressive 0|1 keep the camera still and accumulate samples over the\n"
+              << "                   frames, each saved frame is a refinement of the last\n"
+              << "  --first-frame N  orbit position of the first frame (default 0)\n"
+              << "  --seed N         seed for the scene layout and the sample pattern (default 0)\n"
+              << "  --exposure X     scale the radiance by 2^X before tone mapping (default 0)\n"
+              << "  --tonemap T      clamp, reinhard or aces (default clamp)\n"
+              << "  --transfer T     gamma2 or srgb (default gamma2)\n"
+              << "  --dither 0|1     ordered dithering of the 8-bit output (default 0)\n"
+              << "  --denoise 0|1    filter the frame guided by its albedo, normals and depth (default 0)\n"
+              << "  --features 0|1   also write the albedo, normals and depth of each frame as\n"
+              << "                   NAME.albedo.pfm, NAME.normal.pfm and NAME.depth.pfm (default 0)\n"
+              << "  --backend B      flat (structure of arrays) or bvh (object tree) (default flat)\n"
+              << "  --obj PATH       render this Wavefront OBJ mesh instead of the random scene\n"
+              << "  --scene PATH     render this text or compiled scene file instead of the random scene\n"
+              << "  --compile PATH   write the scene with its flat bvh to a compiled scene file\n"
+              << "                   and exit, --scene loads it back without any parsing\n"
+              << "  --stats PATH     print the frame statistics and append them to PATH as\n"
+              << "                   one JSON object per line\n"
+              << "  --output PATH    output file, #### is replaced by the frame number. The format\n"
+              << "                   follows the extension: png, jpg, bmp, ppm, pfm or hdr for the linear\n"
+              << "                   radiance, or y4m for one raw video stream of every frame\n"
+              << "                   (default output/frame_####.png)\n"
+              << "  --encoders N     threads that encode frames while the next one renders (default 2)\n"
+              << "  --fps N          frame rate in the header of y4m output (default 30)\n"
+              << "  --listen PORT    coordinate: render the frames with the workers that connect to PORT\n"
+              << "  --worker HOST:PORT render blocks for the coordinator at HOST:PORT until it is done,\n"
+              << "                   the scene options must match those of the coordinator" << std::endl;
+}
+
+bool parse_int(const char *text, int min, int &value)
+{
+    char *end;
+    long parsed = std::strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || parsed < min || parsed > 1000000000)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parse_double(const char *text, double min, double &value)
+{
+    char *end;
+    double parsed = std::strtod(text, &end);
+    if (*text == '\0' || *end != '\0' || !(parsed >= min) || parsed > 1e9)
+        return false;
+    value = parsed;
+    return true;
+}
+
+bool parse_options(int argc, char const *argv[], options &opts)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+        bool ok = true;
+        if (arg == "--width")
+            ok = parse_int(value, 1, opts.width);
+        else if (arg == "--height")
+            ok = parse_int(value, 1, opts.height);
+        else if (arg == "--spp")
+            ok = parse_int(value, 1, opts.settings.samples_per_pixel);
+        else if (arg == "--max-depth")
+            ok = parse_int(value, 1, opts.settings.max_depth);
+        else if (arg == "--rr-min-depth")
+            ok = parse_int(value, 0, opts.settings.rr_min_depth);
+        else if (arg == "--rr-threshold")
+            ok = parse_double(value, 0.0, opts.settings.rr_threshold);
+        else if (arg == "--threads")
+            ok = parse_int(value, 0, opts.settings.num_threads);
+        else if (arg == "--tile-size")
+            ok = parse_int(value, 1, opts.settings.tile_size);
+        else if (arg == "--tile-order")
+        {
+            std::string order = value;
+            if (order == "scanline")
+                opts.settings.order = tile_order::scanline;
+            else if (order == "morton")
+                opts.settings.order = tile_order::morton;
+            else if (order == "hilbert")
+                opts.settings.order = tile_order::hilbert;
+            else
+                ok = false;
+        }
+        else if (arg == "--packets")
+        {
+            int packets = 1;
+            ok = parse_int(value, 0, packets) && packets <= 1;
+            opts.settings.packets = packets == 1;
+        }
+        else if (arg == "--sampler")
+        {
+            std::string sampler = value;
+            if (sampler == "independent")
+                opts.settings.sampler = sampler_type::independent;
+            else if (sampler == "stratified")
+                opts.settings.sampler = sampler_type::stratified;
+            else if (sampler == "sobol")
+                opts.settings.sampler = sampler_type::sobol;
+            else if (sampler == "blue_noise")
+                opts.settings.sampler = sampler_type::blue_noise;
+            else
+                ok = false;
+        }
+        else if (arg == "--adaptive")
+        {
+            int adaptive = 0;
+            ok = parse_int(value, 0, adaptive) && adaptive <= 1;
+            opts.settings.adaptive = adaptive == 1;
+        }
+        else if (arg == "--min-spp")
+            ok = parse_int(value, 2, opts.settings.min_spp);
+        else if (arg == "--max-spp")
+            ok = parse_int(value, 2, opts.settings.max_spp);
+        else if (arg == "--error")
+            ok = parse_double(value, 0.0, opts.settings.error_threshold);
+        else if (arg == "--frames")
+            ok = parse_int(value, 1, opts.frames);
+        else if (arg == "--progressive")
+        {
+            int progressive = 0;
+            ok = parse_int(value, 0, progressive) && progressive <= 1;
+            opts.progressive = progressive == 1;
+        }
+        else if (arg == "--first-frame")
+            ok = parse_int(value, 0, opts.first_frame);
+        else if (arg == "--seed")
+        {
+            int seed = 0;
+            ok = parse_int(value, 0, seed);
+            opts.settings.seed = static_cast<uint64_t>(seed);
+        }
+        else if (arg == "--exposure")
+            ok = parse_double(value, -1e9, opts.settings.display.exposure);
+        else if (arg == "--tonemap")
+        {
+            std::string curve = value;
+            if (curve == "clamp")
+                opts.settings.display.curve = tonemap_curve::clamp;
+            else if (curve == "reinhard")
+                opts.settings.display.curve = tonemap_curve::reinhard;
+            else if (curve == "aces")
+                opts.settings.display.curve = tonemap_curve::aces;
+            else
+                ok = false;
+        }
+        else if (arg == "--transfer")
+        {
+            std::string transfer = value;
+            ok = transfer == "gamma2" || transfer == "srgb";
+            opts.settings.display.transfer = transfer == "srgb" ? transfer_curve::srgb : transfer_curve::gamma2;
+        }
+        else if (arg == "--dither")
+        {
+            int dither = 0;
+            ok = parse_int(value, 0, dither) && dither <= 1;
+            opts.settings.display.dither = dither == 1;
+        }
+        else if (arg == "--denoise")
+        {
+            int denoise = 0;
+            ok = parse_int(value, 0, denoise) && denoise <= 1;
+            opts.settings.denoise.enabled = denoise == 1;
+        }
+        else if (arg == "--features")
+        {
+            int features = 0;
+            ok = parse_int(value, 0, features) && features <= 1;
+            opts.settings.features = features == 1;
+        }
+        else if (arg == "--backend")
+        {
+            std::string backend = value;
+            ok = backend == "flat" || backend == "bvh";
+            opts.flat = backend == "flat";
+        }
+        else if (arg == "--obj")
+            opts.obj = value;
+        else if (arg == "--scene")
+            opts.scene = value;
+        else if (arg == "--compile")
+            opts.compile = value;
+        else if (arg == "--output")
+            opts.output = value;
+        else if (arg == "--stats")
+            opts.stats = value;
+        else if (arg == "--encoders")
+            ok = parse_int(value, 1, opts.encoders);
+        else if (arg == "--fps")
+            ok = parse_int(value, 1, opts.fps);
+        else if (arg == "--listen")
+            ok = parse_int(value, 1, opts.listen) && opts.listen <= 65535;
+        else if (arg == "--worker")
+        {
+            std::string address = value;
+            size_t colon = address.rfind(':');
+            opts.coordinator_host = address.substr(0, colon);
+            ok = colon != std::string::npos && colon > 0 &&
+                 parse_int(address.c_str() + colon + 1, 1, opts.coordinator_port) && opts.coordinator_port <= 65535;
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            std::cerr << "Invalid argument: " << arg << " " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (opts.height == 0)
+        opts.height = std::max(1, static_cast<int>(opts.width / (16.0 / 9.0)));
+
+    if (!opts.obj.empty() && !opts.scene.empty())
+    {
+        std::cerr << "--obj and --scene both replace the random scene, pick one" << std::endl;
+        return false;
+    }
+
+    if (opts.listen && !opts.coordinator_host.empty())
+    {
+        std::cerr << "--listen and --worker don't go together, start the workers as separate processes" << std::endl;
+        return false;
+    }
+
+    if (opts.listen && (opts.progressive || opts.settings.adaptive))
+    {
+        std::cerr << "Distributed frames are rendered whole, without --progressive or --adaptive" << std::endl;
+        return false;
+    }
+
+    if (opts.listen && (opts.settings.denoise.enabled || opts.settings.features))
+    {
+        std::cerr << "Distributed frames carry no feature buffers, --denoise and --features need a local render"
+                  << std::endl;
+        return false;
+    }
+
+    if (opts.settings.features && is_video_path(opts.output))
+    {
+        std::cerr << "--features writes float maps next to image files, not to a video stream" << std::endl;
+        return false;
+    }
+
+    if (opts.frames > 1 && opts.output.find('#') == std::string::npos && !is_video_path(opts.output))
+    {
+        std::cerr << "Rendering several frames needs a #### placeholder or a .y4m file in --output" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char const *argv[])
+{
+    options opts;
+    if (!parse_options(argc, argv, opts))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    thread_rng().seed(opts.settings.seed);
+    scene world_scene;
+    std::unique_ptr<hittable> world;
+    auto start = std::chrono::steady_clock::now();
+    if (!opts.scene.empty() && is_compiled_scene(opts.scene))
+    {
+        if (!opts.flat)
+        {
+            std::cerr << "Compiled scenes hold the flat backend only" << std::endl;
+            return 1;
+        }
+        auto flat = std::make_unique<flat_scene>();
+        if (!load_compiled_scene(opts.scene, *flat, world_scene.materials, world_scene.view))
+            return 1;
+        std::cout << "Mapped " << opts.scene << " : " << flat->sphere_count() << " spheres, " << flat->triangle_count()
+                  << " triangles, " << flat->box_count() << " boxes, " << flat->quad_count() << " quads, "
+                  << flat->disk_count() << " disks, " << flat->plane_count() << " planes in " << seconds_since(start) << " s" << std::endl;
+        world = std::move(flat);
+    }
+    else
+    {
+        if (!opts.scene.empty())
+        {
+            if (!load_scene(opts.scene, world_scene))
+                return 1;
+            std::cout << "Loaded " << opts.scene << " : " << world_scene.objects.objects.size() << " objects, "
+                      << world_scene.materials.size() << " materials in " << seconds_since(start) << " s" << std::endl;
+        }
+        else if (!opts.obj.empty())
+        {
+            std::vector<point3> vertices;
+            std::vector<uint32_t> indices;
+            if (!load_obj(opts.obj, vertices, indices))
+                return 1;
+            std::cout << "Loaded " << opts.obj << " : " << vertices.size() << " vertices, " << indices.size() / 3
+                      << " triangles in " << seconds_since(start) << " s" << std::endl;
+            world_scene = mesh_scene(std::move(vertices), std::move(indices));
+        }
+        else
+            world_scene = random_scene();
+
+        start = std::chrono::steady_clock::now();
+        if (opts.flat || !opts.compile.empty())
+            world = std::make_unique<flat_scene>(world_scene.objects);
+        else
+            world = std::make_unique<bvh>(world_scene.objects);
+        std::cout << "Built the " << (opts.flat || !opts.compile.empty() ? "flat" : "bvh") << " backend in "
+                  << seconds_since(start) << " s" << std::endl;
+    }
+
+    if (!opts.compile.empty())
+    {
+        auto &flat = static_cast<const flat_scene &>(*world);
+        if (!save_compiled_scene(opts.compile, flat, world_scene.materials, world_scene.view))
+            return 1;
+        std::cout << "Compiled " << flat.sphere_count() << " spheres, " << flat.triangle_count() << " triangles, "
+                  << flat.box_count() << " boxes, " << flat.quad_count() << " quads, " << flat.disk_count()
+                  << " disks, " << flat.plane_count() << " planes to " << opts.compile << std::endl;
+        return 0;
+    }
+
+    renderer tracer(opts.settings);
+    if (!opts.coordinator_host.empty())
+        return run_tile_worker(opts.coordinator_host, opts.coordinator_port, *world, world_scene.materials, tracer) ? 0 : 1;
+
+    std::unique_ptr<tile_coordinator> coordinator;
+    if (opts.listen)
+    {
+        coordinator = tile_coordinator::listen(opts.listen, scene_fingerprint(*world, world_scene.materials));
+        if (!coordinator)
+            return 1;
+        std::cout << "Handing out blocks of the frames on port " << opts.listen << std::endl;
+    }
+
+    frame_writer writer(opts.encoders);
+    writer.video_fps = opts.fps;
+    writer.write_features = opts.settings.features;
+    double aspect_ratio = static_cast<double>(opts.width) / opts.height;
+
+    std::ofstream stats_file;
+    if (!opts.stats.empty())
+    {
+        stats_file.open(opts.stats, std::ios::app);
+        if (!stats_file)
+        {
+            std::cerr << "Failed to open " << opts.stats << std::endl;
+            return 1;
+        }
+    }
+
+    // A scene's own camera stands still, the built in scenes orbit
+    auto frame_camera = [&](int frame)
+    {
+        return world_scene.view ? world_scene.view->make(aspect_ratio) : random_scene_camera(frame, aspect_ratio);
+    };
+
+    auto sequence_start = std::chrono::steady_clock::now();
+    for (int frame = opts.first_frame; frame < opts.first_frame + opts.frames; frame++)
+    {
+        // Renders into a free framebuffer while the encoders write the earlier frames
+        image &img = writer.acquire(opts.width, opts.height);
+        auto start = std::chrono::steady_clock::now();
+        if (coordinator)
+            coordinator->render(frame_camera(frame), opts.settings, img);
+        else if (opts.progressive)
+            tracer.render_progressive(*world, world_scene.materials, frame_camera(opts.first_frame), img);
+        else
+            tracer.render(*world, world_scene.materials, frame_camera(frame), img);
+        double seconds = seconds_since(start);
+
+        std::string path = frame_path(opts.output, frame);
+        writer.submit(img, path);
+        int samples = coordinator ? opts.settings.samples_per_pixel : tracer.accumulated_samples();
+        std::cout << "Frame : " << frame << " Frame time : " << seconds << " Samples : " << samples
+                  << " Queued : " << path << std::endl;
+        if (stats_file.is_open())
+        {
+            const render_stats &stats = coordinator ? coordinator->frame_stats() : tracer.frame_stats();
+            stats.print(std::cout, seconds);
+            stats.write_json(stats_file, frame, opts.settings.max_depth, seconds);
+        }
+    }
+
+    if (!writer.flush())
+        return 1;
+    std::cout << "Wrote " << opts.frames << " frames in " << seconds_since(sequence_start) << " s" << std::endl;
+    return 0;
+}
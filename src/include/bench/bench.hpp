@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "math/utils.hpp"
+#include "utils/hittable_list.hpp"
+
+// Helpers shared by the comparison tables in bench/main.cpp and the suite
+
+using bench_clock = std::chrono::steady_clock;
+
+double seconds_since(bench_clock::time_point start);
+
+// Small spheres scattered through a cube that grows with the count,
+// so the density of the scene stays the same at every size
+hittable_list sphere_field(int count);
+
+// Bumpy grid of about count triangles, two per cell, sharing their vertices
+void height_field(int count, std::vector<point3> &vertices, std::vector<uint32_t> &indices);
+
+struct suite_options
+{
+    std::string json = "-";       // Output file, - for stdout
+    int max_primitives = 1000000; // Largest synthetic scene, starting at 100 and growing tenfold
+    double min_seconds = 0.25;    // Shortest run of one microbenchmark
+    int width = 320;              // End-to-end renders, 16:9
+    int spp = 8;
+    int threads = 0;              // 0 uses every hardware thread
+    uint64_t seed = 0;
+};
+
+// Times the intersection, scatter and sampling functions one call at a time, then
+// renders random_scene() and synthetic scenes with a fixed seed. Results go out
+// as JSON, progress to stderr. Returns the exit code.
+int run_suite(const suite_options &options);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+// PCG32 generator (O'Neill, pcg-random.org). Every (pixel, sample) pair gets its own
+// stream, so renders do not depend on which thread traced which sample.
+class pcg32 {
+public:
+    pcg32() { seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL); }
+    pcg32(uint64_t initstate, uint64_t initseq) { seed(initstate, initseq); }
+
+    void seed(uint64_t initstate, uint64_t initseq = 0xda3e39cb94b95bdbULL) {
+        state = 0;
+        inc = (initseq << 1u) | 1u;
+        next_uint();
+        state += initstate;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old = state;
+        state = old * multiplier + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    // Uniform in [0,1)
+    double next_double() {
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+    // Skips delta draws in O(log delta), used to jump to a given sample dimension
+    void advance(uint64_t delta) {
+        uint64_t cur_mult = multiplier, cur_plus = inc;
+        uint64_t acc_mult = 1u, acc_plus = 0u;
+        while (delta > 0) {
+            if (delta & 1) {
+                acc_mult *= cur_mult;
+                acc_plus = acc_plus * cur_mult + cur_plus;
+            }
+            cur_plus = (cur_mult + 1) * cur_plus;
+            cur_mult *= cur_mult;
+            delta /= 2;
+        }
+        state = acc_mult * state + acc_plus;
+    }
+
+private:
+    static const uint64_t multiplier = 0x5851f42d4c957f2dULL;
+    uint64_t state, inc;
+};
+
+// Finalizer from MurmurHash3, spreads nearby keys over the whole sequence space
+inline uint64_t mix_bits(uint64_t v) {
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb93fe53b2a87ULL;
+    v ^= v >> 33;
+    return v;
+}
+
+// Generator of the calling thread, used by random_double() and everything built on it
+pcg32& thread_rng();
+
+inline double random_double() {
+    // Returns a random real in [0,1) from the calling thread's generator.
+    return thread_rng().next_double();
+}
+
+inline double random_double(double min, double max) {
+    // Returns a random real in [min,max).
+    return min + (max-min)*random_double();
+}
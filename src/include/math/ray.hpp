@@ -2,21 +2,54 @@
 
 #include "math/vec3.hpp"
 
-class ray {
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+template <typename T>
+class ray_t {
     public:
-        ray() {}
-        ray(const point3& origin, const vec3& direction)
+        constexpr ray_t() {}
+        constexpr ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction)
             : orig(origin), dir(direction)
         {}
 
-        point3 origin() const  { return orig; }
-        vec3 direction() const { return dir; }
+        constexpr vec3_t<T> origin() const  { return orig; }
+        constexpr vec3_t<T> direction() const { return dir; }
 
-        point3 at(double t) const {
+        constexpr vec3_t<T> at(T t) const {
             return orig + t*dir;
         }
 
     public:
-        point3 orig;
-        vec3 dir;
-};
\ No newline at end of file
+        vec3_t<T> orig;
+        vec3_t<T> dir;
+};
+
+using ray = ray_t<real>;
+
+// Moves a hit point off the surface along the normal n, on the side the next ray
+// leaves from (Wächter and Binder, Ray Tracing Gems chapter 6). The step is a
+// fixed number of ulps, so it grows with the magnitude of the coordinates and
+// covers the rounding error of the hit point in float builds as well as double.
+// Coordinates close to zero, where ulps get tiny, take a fixed step instead.
+template <typename T>
+inline vec3_t<T> offset_ray_origin(const vec3_t<T>& p, const vec3_t<T>& n) {
+    using bits_t = typename std::conditional<sizeof(T) == 4, int32_t, int64_t>::type;
+    const T origin = T(1) / 32;
+    const T int_scale = 256;
+    const T float_scale = int_scale * std::numeric_limits<T>::epsilon() / 2;
+
+    vec3_t<T> out;
+    for (int a = 0; a < 3; a++) {
+        bits_t ulps = static_cast<bits_t>(int_scale * n.e[a]);
+        bits_t bits;
+        std::memcpy(&bits, &p.e[a], sizeof(T));
+        bits += p.e[a] < 0 ? -ulps : ulps;
+        T stepped;
+        std::memcpy(&stepped, &bits, sizeof(T));
+        out.e[a] = std::fabs(p.e[a]) < origin ? p.e[a] + float_scale * n.e[a] : stepped;
+    }
+    return out;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "math/utils.hpp"
+#include "math/simd.hpp"
+#include "math/transform.hpp"
+
+// Defaults to 8 rays, or one full register when that holds more (float AVX-512)
+#ifndef RT_PACKET_SIZE
+#define RT_PACKET_SIZE (simd_width > 8 ? simd_width : 8)
+#endif
+
+// Rays per packet, a multiple of simd_width
+const int packet_size = RT_PACKET_SIZE;
+static_assert(packet_size % simd_width == 0, "RT_PACKET_SIZE must be a multiple of the SIMD width");
+
+// Bundle of rays in structure of arrays layout. t_max holds the closest hit
+// found so far per lane; lanes with t_max below t_min are inactive.
+struct ray_packet {
+    alignas(64) real ox[packet_size], oy[packet_size], oz[packet_size];
+    alignas(64) real dx[packet_size], dy[packet_size], dz[packet_size];
+    alignas(64) real inv_dx[packet_size], inv_dy[packet_size], inv_dz[packet_size];
+    alignas(64) real t_max[packet_size];
+    real t_min;
+
+    void set(int lane, const ray& r, real t_max_lane) {
+        ox[lane] = r.orig.e[0]; oy[lane] = r.orig.e[1]; oz[lane] = r.orig.e[2];
+        dx[lane] = r.dir.e[0];  dy[lane] = r.dir.e[1];  dz[lane] = r.dir.e[2];
+        inv_dx[lane] = 1.0 / dx[lane];
+        inv_dy[lane] = 1.0 / dy[lane];
+        inv_dz[lane] = 1.0 / dz[lane];
+        t_max[lane] = t_max_lane;
+    }
+
+    // Parks the lane on a finite ray with an empty interval, so it never reports a hit
+    void deactivate(int lane) {
+        set(lane, ray(point3(0, 0, 0), vec3(1, 1, 1)), -infinity);
+    }
+
+    bool active(int lane) const { return t_max[lane] >= t_min; }
+
+    ray get(int lane) const {
+        return ray(point3(ox[lane], oy[lane], oz[lane]), vec3(dx[lane], dy[lane], dz[lane]));
+    }
+};
+
+// Intersection kernels. Each shrinks t_max on the lanes that found a closer hit
+// and returns those lanes as a bitmask.
+int sphere_hit_packet(ray_packet& packet, const point3& center, real radius);
+int triangle_hit_packet(ray_packet& packet, const point3& v0, const vec3& edge1, const vec3& edge2);
+// to_local maps the box onto [-1, 1] on every axis, see cube
+int cube_hit_packet(ray_packet& packet, const affine_transform& to_local);
+// The points p with dot(normal, p) == offset, or the part of them within a
+// parallelogram or a disk, see planar.hpp
+int plane_hit_packet(ray_packet& packet, const vec3& normal, real offset);
+int quad_hit_packet(ray_packet& packet, const vec3& normal, real offset,
+                    const point3& corner, const vec3& alpha_axis, const vec3& beta_axis);
+int disk_hit_packet(ray_packet& packet, const vec3& normal, real offset, const point3& center, real radius);
+
+// Bitmask of the lanes whose ray overlaps the box within [t_min, t_max]
+int box_hit_packet(const ray_packet& packet, const point3& box_min, const point3& box_max);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "math/random.hpp"
+
+// Where the random numbers of a camera sample come from. The renderer starts
+// a sample with start_pixel_sample, then everything on the path of that sample
+// (film position, lens, light and BSDF sampling, Russian roulette) takes its
+// numbers through sample_1d and sample_2d, one dimension per call. The
+// low-discrepancy samplers spread the values of each dimension evenly over
+// the samples of a pixel, so the estimate converges faster than with
+// independent numbers at the same sample count.
+enum class sampler_type {
+    independent, // A new PCG number for every dimension, as random_double gives them
+    stratified,  // Correlated multi-jittered patterns of samples_per_pixel points (Kensler 2013)
+    sobol,       // Owen scrambled Sobol points, padded from pairs of dimensions (Burley 2020)
+    blue_noise,  // Sobol points shared by every pixel, shifted per pixel by a blue noise mask,
+                 // so that neighbouring pixels err in different directions (Georgiev and Fajardo 2016)
+};
+
+// The dimensions of one camera sample. Every render thread has its own, see
+// thread_sampler.
+class pixel_sampler {
+public:
+    // sample_count is the size of a stratified pattern, samples past it start new patterns
+    void start(sampler_type type, int x, int y, int sample_index, int sample_count, uint64_t seed);
+
+    double next_1d();
+    void next_2d(double& u, double& v);
+
+private:
+    sampler_type type = sampler_type::independent;
+    uint32_t x = 0, y = 0;
+    uint32_t index = 0, count = 1;
+    uint64_t seed = 0;
+    uint64_t pixel_seed = 0; // seed mixed with the pixel
+    uint32_t dimension = 0;  // Next dimension to hand out, pairs take one
+};
+
+// Sampler of the calling thread. Until a pixel sample starts it is independent
+// and draws from thread_rng, so scene setup code gets plain random numbers.
+pixel_sampler& thread_sampler();
+
+inline double sample_1d() {
+    return thread_sampler().next_1d();
+}
+
+inline void sample_2d(double& u, double& v) {
+    thread_sampler().next_2d(u, v);
+}
+
+// Largest number of random numbers a single camera sample may draw before it
+// would run into the next sample's numbers
+const uint64_t max_sample_dimensions = 65536;
+
+// Points the calling thread's generator and sampler at one camera sample.
+// Draw n of the sample is then dimension n of the (pixel, sample) sequence.
+inline void start_pixel_sample(int x, int y, int sample_index, uint64_t seed,
+                               sampler_type type = sampler_type::independent, int sample_count = 1) {
+    uint64_t pixel_key = (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x);
+    pcg32& rng = thread_rng();
+    rng.seed(mix_bits(seed), mix_bits(pixel_key ^ mix_bits(seed + 1)));
+    rng.advance(static_cast<uint64_t>(sample_index) * max_sample_dimensions);
+    thread_sampler().start(type, x, y, sample_index, sample_count, seed);
+}
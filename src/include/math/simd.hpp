@@ -0,0 +1,259 @@
+#pragma once
+
+// Thin wrapper over the widest vector unit the compiler targets. vreal holds
+// simd_width lanes of the renderer's scalar type, so float builds get twice the
+// lanes of double builds. Comparisons produce a vmask that can be combined,
+// turned into a lane bitmask or used to select between vectors.
+// Define RT_NO_SIMD to force the scalar fallback.
+
+#include "math/vec3.hpp"
+
+#if !defined(RT_NO_SIMD) && defined(__AVX512F__)
+#include <immintrin.h>
+
+#ifdef RT_FLOAT
+const int simd_width = 16;
+
+struct vmask {
+    __mmask16 m;
+    int bits() const { return static_cast<int>(m); }
+    friend vmask operator&(vmask a, vmask b) { return {static_cast<__mmask16>(a.m & b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {static_cast<__mmask16>(a.m | b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {static_cast<__mmask16>(~a.m & b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m512 v;
+    vreal() {}
+    vreal(__m512 v) : v(v) {}
+    vreal(real x) : v(_mm512_set1_ps(x)) {}
+    static vreal load(const real* p) { return _mm512_loadu_ps(p); }
+    void store(real* p) const { _mm512_storeu_ps(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm512_add_ps(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm512_sub_ps(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm512_mul_ps(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm512_div_ps(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm512_sqrt_ps(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm512_min_ps(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm512_max_ps(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm512_mask_blend_ps(m.m, b.v, a.v); }
+#else
+const int simd_width = 8;
+
+struct vmask {
+    __mmask8 m;
+    int bits() const { return static_cast<int>(m); }
+    friend vmask operator&(vmask a, vmask b) { return {static_cast<__mmask8>(a.m & b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {static_cast<__mmask8>(a.m | b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {static_cast<__mmask8>(~a.m & b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m512d v;
+    vreal() {}
+    vreal(__m512d v) : v(v) {}
+    vreal(real x) : v(_mm512_set1_pd(x)) {}
+    static vreal load(const real* p) { return _mm512_loadu_pd(p); }
+    void store(real* p) const { _mm512_storeu_pd(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm512_add_pd(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm512_sub_pd(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm512_mul_pd(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm512_div_pd(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm512_sqrt_pd(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm512_min_pd(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm512_max_pd(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm512_mask_blend_pd(m.m, b.v, a.v); }
+#endif
+
+#elif !defined(RT_NO_SIMD) && defined(__AVX__)
+#include <immintrin.h>
+
+#ifdef RT_FLOAT
+const int simd_width = 8;
+
+struct vmask {
+    __m256 m;
+    int bits() const { return _mm256_movemask_ps(m); }
+    friend vmask operator&(vmask a, vmask b) { return {_mm256_and_ps(a.m, b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {_mm256_or_ps(a.m, b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {_mm256_andnot_ps(a.m, b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m256 v;
+    vreal() {}
+    vreal(__m256 v) : v(v) {}
+    vreal(real x) : v(_mm256_set1_ps(x)) {}
+    static vreal load(const real* p) { return _mm256_loadu_ps(p); }
+    void store(real* p) const { _mm256_storeu_ps(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm256_add_ps(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm256_sub_ps(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm256_mul_ps(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm256_div_ps(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm256_sqrt_ps(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm256_min_ps(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm256_max_ps(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+#else
+const int simd_width = 4;
+
+struct vmask {
+    __m256d m;
+    int bits() const { return _mm256_movemask_pd(m); }
+    friend vmask operator&(vmask a, vmask b) { return {_mm256_and_pd(a.m, b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {_mm256_or_pd(a.m, b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {_mm256_andnot_pd(a.m, b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m256d v;
+    vreal() {}
+    vreal(__m256d v) : v(v) {}
+    vreal(real x) : v(_mm256_set1_pd(x)) {}
+    static vreal load(const real* p) { return _mm256_loadu_pd(p); }
+    void store(real* p) const { _mm256_storeu_pd(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm256_add_pd(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm256_sub_pd(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm256_mul_pd(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm256_div_pd(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm256_sqrt_pd(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm256_min_pd(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm256_max_pd(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm256_blendv_pd(b.v, a.v, m.m); }
+#endif
+
+#elif !defined(RT_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+
+#ifdef RT_FLOAT
+const int simd_width = 4;
+
+struct vmask {
+    __m128 m;
+    int bits() const { return _mm_movemask_ps(m); }
+    friend vmask operator&(vmask a, vmask b) { return {_mm_and_ps(a.m, b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {_mm_or_ps(a.m, b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {_mm_andnot_ps(a.m, b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m128 v;
+    vreal() {}
+    vreal(__m128 v) : v(v) {}
+    vreal(real x) : v(_mm_set1_ps(x)) {}
+    static vreal load(const real* p) { return _mm_loadu_ps(p); }
+    void store(real* p) const { _mm_storeu_ps(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm_add_ps(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm_sub_ps(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm_mul_ps(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm_div_ps(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm_sqrt_ps(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm_min_ps(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm_max_ps(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)); }
+#else
+const int simd_width = 2;
+
+struct vmask {
+    __m128d m;
+    int bits() const { return _mm_movemask_pd(m); }
+    friend vmask operator&(vmask a, vmask b) { return {_mm_and_pd(a.m, b.m)}; }
+    friend vmask operator|(vmask a, vmask b) { return {_mm_or_pd(a.m, b.m)}; }
+    friend vmask andnot(vmask a, vmask b) { return {_mm_andnot_pd(a.m, b.m)}; } // !a & b
+};
+
+struct vreal {
+    __m128d v;
+    vreal() {}
+    vreal(__m128d v) : v(v) {}
+    vreal(real x) : v(_mm_set1_pd(x)) {}
+    static vreal load(const real* p) { return _mm_loadu_pd(p); }
+    void store(real* p) const { _mm_storeu_pd(p, v); }
+
+    friend vreal operator+(vreal a, vreal b) { return _mm_add_pd(a.v, b.v); }
+    friend vreal operator-(vreal a, vreal b) { return _mm_sub_pd(a.v, b.v); }
+    friend vreal operator*(vreal a, vreal b) { return _mm_mul_pd(a.v, b.v); }
+    friend vreal operator/(vreal a, vreal b) { return _mm_div_pd(a.v, b.v); }
+    friend vmask operator<(vreal a, vreal b) { return {_mm_cmplt_pd(a.v, b.v)}; }
+    friend vmask operator<=(vreal a, vreal b) { return {_mm_cmple_pd(a.v, b.v)}; }
+    friend vmask operator>(vreal a, vreal b) { return {_mm_cmpgt_pd(a.v, b.v)}; }
+    friend vmask operator>=(vreal a, vreal b) { return {_mm_cmpge_pd(a.v, b.v)}; }
+};
+
+inline vreal vsqrt(vreal a) { return _mm_sqrt_pd(a.v); }
+inline vreal vmin(vreal a, vreal b) { return _mm_min_pd(a.v, b.v); }
+inline vreal vmax(vreal a, vreal b) { return _mm_max_pd(a.v, b.v); }
+inline vreal select(vmask m, vreal a, vreal b) { return _mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v)); }
+#endif
+
+#else
+#include <cmath>
+
+const int simd_width = 1;
+
+struct vmask {
+    bool m;
+    int bits() const { return m ? 1 : 0; }
+    friend vmask operator&(vmask a, vmask b) { return {a.m && b.m}; }
+    friend vmask operator|(vmask a, vmask b) { return {a.m || b.m}; }
+    friend vmask andnot(vmask a, vmask b) { return {!a.m && b.m}; } // !a & b
+};
+
+struct vreal {
+    real v;
+    vreal() {}
+    vreal(real x) : v(x) {}
+    static vreal load(const real* p) { return *p; }
+    void store(real* p) const { *p = v; }
+
+    friend vreal operator+(vreal a, vreal b) { return a.v + b.v; }
+    friend vreal operator-(vreal a, vreal b) { return a.v - b.v; }
+    friend vreal operator*(vreal a, vreal b) { return a.v * b.v; }
+    friend vreal operator/(vreal a, vreal b) { return a.v / b.v; }
+    friend vmask operator<(vreal a, vreal b) { return {a.v < b.v}; }
+    friend vmask operator<=(vreal a, vreal b) { return {a.v <= b.v}; }
+    friend vmask operator>(vreal a, vreal b) { return {a.v > b.v}; }
+    friend vmask operator>=(vreal a, vreal b) { return {a.v >= b.v}; }
+};
+
+inline vreal vsqrt(vreal a) { return std::sqrt(a.v); }
+inline vreal vmin(vreal a, vreal b) { return a.v < b.v ? a.v : b.v; }
+inline vreal vmax(vreal a, vreal b) { return a.v > b.v ? a.v : b.v; }
+inline vreal select(vmask m, vreal a, vreal b) { return m.m ? a : b; }
+
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cmath>
+
+#include "math/vec3.hpp"
+
+// Affine map x -> M x + t as the three rows of [M | t]. Points take the
+// translation, vectors don't. Normals map with the transpose of the inverse,
+// see normal.
+template <typename T>
+class affine_transform_t
+{
+public:
+    T m[3][4];
+
+    constexpr affine_transform_t() : m{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}} {}
+
+    static affine_transform_t translate(const vec3_t<T> &offset)
+    {
+        affine_transform_t result;
+        for (int i = 0; i < 3; i++)
+            result.m[i][3] = offset.e[i];
+        return result;
+    }
+
+    static affine_transform_t scale(const vec3_t<T> &factors)
+    {
+        affine_transform_t result;
+        for (int i = 0; i < 3; i++)
+            result.m[i][i] = factors.e[i];
+        return result;
+    }
+
+    // Right handed rotation by angle radians around axis, which need not be unit length
+    static affine_transform_t rotate(const vec3_t<T> &axis, T angle)
+    {
+        vec3_t<T> a = unit_vector(axis);
+        T c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+        affine_transform_t result;
+        result.m[0][0] = t * a.e[0] * a.e[0] + c;
+        result.m[0][1] = t * a.e[0] * a.e[1] - s * a.e[2];
+        result.m[0][2] = t * a.e[0] * a.e[2] + s * a.e[1];
+        result.m[1][0] = t * a.e[0] * a.e[1] + s * a.e[2];
+        result.m[1][1] = t * a.e[1] * a.e[1] + c;
+        result.m[1][2] = t * a.e[1] * a.e[2] - s * a.e[0];
+        result.m[2][0] = t * a.e[0] * a.e[2] - s * a.e[1];
+        result.m[2][1] = t * a.e[1] * a.e[2] + s * a.e[0];
+        result.m[2][2] = t * a.e[2] * a.e[2] + c;
+        return result;
+    }
+
+    constexpr vec3_t<T> point(const vec3_t<T> &p) const
+    {
+        return vec3_t<T>(m[0][0] * p.e[0] + m[0][1] * p.e[1] + m[0][2] * p.e[2] + m[0][3],
+                         m[1][0] * p.e[0] + m[1][1] * p.e[1] + m[1][2] * p.e[2] + m[1][3],
+                         m[2][0] * p.e[0] + m[2][1] * p.e[1] + m[2][2] * p.e[2] + m[2][3]);
+    }
+
+    constexpr vec3_t<T> vector(const vec3_t<T> &v) const
+    {
+        return vec3_t<T>(m[0][0] * v.e[0] + m[0][1] * v.e[1] + m[0][2] * v.e[2],
+                         m[1][0] * v.e[0] + m[1][1] * v.e[1] + m[1][2] * v.e[2],
+                         m[2][0] * v.e[0] + m[2][1] * v.e[1] + m[2][2] * v.e[2]);
+    }
+
+    // Called on the inverse of the map the surface went through: the transpose
+    // keeps normals perpendicular to the surface under any scale or shear. The
+    // result is not unit length.
+    constexpr vec3_t<T> normal(const vec3_t<T> &n) const
+    {
+        return vec3_t<T>(m[0][0] * n.e[0] + m[1][0] * n.e[1] + m[2][0] * n.e[2],
+                         m[0][1] * n.e[0] + m[1][1] * n.e[1] + m[2][1] * n.e[2],
+                         m[0][2] * n.e[0] + m[1][2] * n.e[1] + m[2][2] * n.e[2]);
+    }
+
+    // Applies other first, then this
+    constexpr affine_transform_t operator*(const affine_transform_t &other) const
+    {
+        affine_transform_t result;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                T sum = j == 3 ? m[i][3] : 0;
+                for (int k = 0; k < 3; k++)
+                    sum += m[i][k] * other.m[k][j];
+                result.m[i][j] = sum;
+            }
+        }
+        return result;
+    }
+
+    constexpr T determinant() const
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+               m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    // Whether the map only rotates, reflects, translates and scales uniformly,
+    // so that spheres stay spheres: its columns are perpendicular and equally
+    // long, up to a relative tolerance
+    bool similarity() const
+    {
+        vec3_t<T> x = vector(vec3_t<T>(1, 0, 0)), y = vector(vec3_t<T>(0, 1, 0)), z = vector(vec3_t<T>(0, 0, 1));
+        T scale_squared = x.length_squared();
+        T tolerance = T(1e-4) * scale_squared;
+        return std::fabs(y.length_squared() - scale_squared) <= tolerance &&
+               std::fabs(z.length_squared() - scale_squared) <= tolerance && std::fabs(dot(x, y)) <= tolerance &&
+               std::fabs(dot(y, z)) <= tolerance && std::fabs(dot(z, x)) <= tolerance;
+    }
+
+    // Only defined when determinant() is not zero
+    affine_transform_t inverse() const
+    {
+        T inv_det = 1 / determinant();
+        affine_transform_t result;
+        result.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+        result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        result.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+        result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+        result.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+        result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+        for (int i = 0; i < 3; i++)
+            result.m[i][3] = -(result.m[i][0] * m[0][3] + result.m[i][1] * m[1][3] + result.m[i][2] * m[2][3]);
+        return result;
+    }
+};
+
+using affine_transform = affine_transform_t<real>;
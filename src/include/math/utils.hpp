@@ -5,6 +5,8 @@
 #include <limits>
 #include <memory>
 
+#include "math/random.hpp"
+#include "math/vec3.hpp"
 
 // Usings
 
@@ -14,8 +16,7 @@ using std::sqrt;
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
+const real infinity = std::numeric_limits<real>::infinity();
 
 // Utility Functions
 
@@ -23,16 +24,6 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
-inline double random_double() {
-    // Returns a random_vec3 real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
-}
-
-inline double random_double(double min, double max) {
-    // Returns a random_vec3 real in [min,max).
-    return min + (max-min)*random_double();
-}
-
 inline double clamp(double x, double min, double max) {
     if (x < min) return min;
     if (x > max) return max;
@@ -3,49 +3,216 @@
 #include <cmath>
 #include <iostream>
 
-class vec3
+#include "math/sampler.hpp"
+
+// Scalar type of the renderer. Build every target with -DRT_FLOAT for a single
+// precision renderer, which halves the size of rays, hit records and scene
+// buffers and doubles the lanes per SIMD register.
+#ifdef RT_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
+const double pi = 3.1415926535897932385;
+
+// Header only so that every operation inlines into the intersection and
+// scatter code. The scalar arguments of the operators are not deduced, so
+// double literals mix freely with a float vector.
+template <typename T>
+class vec3_t
 {
 public:
-    double e[3];
-
-    vec3() : e{0, 0, 0} {}
-    vec3(double x, double y, double z) : e{x, y, z} {}
-
-    double x() const;
-    double y() const;
-    double z() const;
-
-    vec3 operator-() const;
-    double operator[](int i) const;
-    double &operator[](int i);
-
-    vec3 &operator+=(const vec3 &v);
-    vec3 &operator*=(const double t);
-    vec3 &operator/=(const double t);
-    double length() const;
-    double length_squared() const;
-    bool near_zero() const;
-    void rotate(double angle, vec3 axis);
+    using value_type = T;
+
+    T e[3];
+
+    constexpr vec3_t() : e{0, 0, 0} {}
+    constexpr vec3_t(T x, T y, T z) : e{x, y, z} {}
+
+    // Conversion between precisions, e.g. to load single precision mesh data
+    template <typename U>
+    constexpr explicit vec3_t(const vec3_t<U> &v)
+        : e{static_cast<T>(v.e[0]), static_cast<T>(v.e[1]), static_cast<T>(v.e[2])} {}
+
+    constexpr T x() const { return e[0]; }
+    constexpr T y() const { return e[1]; }
+    constexpr T z() const { return e[2]; }
+
+    constexpr vec3_t operator-() const { return vec3_t(-e[0], -e[1], -e[2]); }
+    constexpr T operator[](int i) const { return e[i]; }
+    constexpr T &operator[](int i) { return e[i]; }
+
+    constexpr vec3_t &operator+=(const vec3_t &v)
+    {
+        e[0] += v.e[0];
+        e[1] += v.e[1];
+        e[2] += v.e[2];
+        return *this;
+    }
+
+    constexpr vec3_t &operator*=(T t)
+    {
+        e[0] *= t;
+        e[1] *= t;
+        e[2] *= t;
+        return *this;
+    }
+
+    constexpr vec3_t &operator/=(T t) { return *this *= 1 / t; }
+
+    T length() const { return std::sqrt(length_squared()); }
+    constexpr T length_squared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
+
+    bool near_zero() const
+    {
+        // Return true if the vector is close to zero in all dimensions.
+        const T s = 1e-8;
+        return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
+    }
+
+    // Rotates around a unit axis by angle radians
+    void rotate(T angle, vec3_t axis)
+    {
+        T c = std::cos(angle);
+        T s = std::sin(angle);
+        T t = 1 - c;
+        T x = e[0], y = e[1], z = e[2];
+        T x2 = axis[0], y2 = axis[1], z2 = axis[2];
+        *this = vec3_t(
+            (t * x2 * x2 + c) * x + (t * x2 * y2 - s * z2) * y + (t * x2 * z2 + s * y2) * z,
+            (t * x2 * y2 + s * z2) * x + (t * y2 * y2 + c) * y + (t * y2 * z2 - s * x2) * z,
+            (t * x2 * z2 - s * y2) * x + (t * y2 * z2 + s * x2) * y + (t * z2 * z2 + c) * z);
+    }
+
+    friend std::ostream &operator<<(std::ostream &out, const vec3_t &v)
+    {
+        return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+    }
+
+    friend constexpr bool operator==(const vec3_t &u, const vec3_t &v)
+    {
+        return u.e[0] == v.e[0] && u.e[1] == v.e[1] && u.e[2] == v.e[2];
+    }
+    friend constexpr bool operator!=(const vec3_t &u, const vec3_t &v) { return !(u == v); }
+
+    friend constexpr vec3_t operator+(const vec3_t &u, const vec3_t &v)
+    {
+        return vec3_t(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+    }
+    friend constexpr vec3_t operator-(const vec3_t &u, const vec3_t &v)
+    {
+        return vec3_t(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+    }
+    friend constexpr vec3_t operator*(const vec3_t &u, const vec3_t &v)
+    {
+        return vec3_t(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+    }
+    friend constexpr vec3_t operator*(T t, const vec3_t &v)
+    {
+        return vec3_t(t * v.e[0], t * v.e[1], t * v.e[2]);
+    }
+    friend constexpr vec3_t operator*(const vec3_t &v, T t) { return t * v; }
+    friend constexpr vec3_t operator/(const vec3_t &v, T t) { return (1 / t) * v; }
+
+    friend constexpr T dot(const vec3_t &u, const vec3_t &v)
+    {
+        return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
+    }
+
+    friend constexpr vec3_t cross(const vec3_t &u, const vec3_t &v)
+    {
+        return vec3_t(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                      u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                      u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+    }
+
+    friend vec3_t unit_vector(const vec3_t &v) { return v / v.length(); }
+
+    friend constexpr vec3_t reflect(const vec3_t &v, const vec3_t &n)
+    {
+        return v - 2 * dot(v, n) * n;
+    }
+
+    friend vec3_t refract(const vec3_t &uv, const vec3_t &n, T etai_over_etat)
+    {
+        T cos_theta = std::fmin(dot(-uv, n), T(1));
+        vec3_t r_out_perp = etai_over_etat * (uv + cos_theta * n);
+        vec3_t r_out_parallel = -std::sqrt(std::fabs(1 - r_out_perp.length_squared())) * n;
+        return r_out_perp + r_out_parallel;
+    }
 };
 
+using vec3 = vec3_t<real>;
 using point3 = vec3;
 using color = vec3;
 
-std::ostream &operator<<(std::ostream &out, const vec3 &v);
-vec3 operator+(const vec3 &u, const vec3 &v);
-vec3 operator-(const vec3 &u, const vec3 &v);
-vec3 operator*(const vec3 &u, const vec3 &v);
-vec3 operator*(double t, const vec3 &v);
-vec3 operator*(const vec3 &v, double t);
-vec3 operator/(vec3 v, double t);
-double dot(const vec3 &u, const vec3 &v);
-vec3 cross(const vec3 &u, const vec3 &v);
-vec3 unit_vector(vec3 v);
-vec3 random_vec3();
-vec3 random_vec3(double min, double max);
-vec3 random_in_unit_sphere();
-vec3 random_unit_vector();
-vec3 random_in_hemisphere(const vec3& normal);
-vec3 random_in_unit_disk();
-vec3 reflect(const vec3& v, const vec3& n);
-vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat);
\ No newline at end of file
+inline double luminance(const color &c)
+{
+    return 0.2126 * c.e[0] + 0.7152 * c.e[1] + 0.0722 * c.e[2];
+}
+
+inline vec3 random_vec3()
+{
+    return vec3(random_double(), random_double(), random_double());
+}
+
+inline vec3 random_vec3(double min, double max)
+{
+    return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+}
+
+// The warps below map one or two sample dimensions (sample_1d, sample_2d)
+// directly onto the shape, so the spread of low-discrepancy samples carries over.
+
+inline vec3 random_unit_vector()
+{
+    // Uniform on the sphere: the height is uniform, then any angle around the axis
+    double u, v;
+    sample_2d(u, v);
+    double z = 1 - 2 * u;
+    double r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    double phi = 2 * pi * v;
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline vec3 random_in_unit_sphere()
+{
+    // The radius of a point uniform in the ball is the cube root of a uniform number.
+    // Drawn before the direction in its own statement, the compiler may evaluate
+    // the operands of one expression in either order and mix up the dimensions
+    double radius = std::cbrt(sample_1d());
+    return radius * random_unit_vector();
+}
+
+inline vec3 random_in_hemisphere(const vec3 &normal)
+{
+    vec3 in_unit_sphere = random_in_unit_sphere();
+    if (dot(in_unit_sphere, normal) > 0)
+        return in_unit_sphere;
+    else
+        return -in_unit_sphere;
+}
+
+inline vec3 random_in_unit_disk()
+{
+    // Concentric map of the square onto the disk (Shirley and Chiu 1997), keeps
+    // neighbouring samples together
+    double u, v;
+    sample_2d(u, v);
+    double a = 2 * u - 1, b = 2 * v - 1;
+    if (a == 0 && b == 0)
+        return vec3(0, 0, 0);
+    double r, theta;
+    if (std::fabs(a) > std::fabs(b))
+    {
+        r = a;
+        theta = (pi / 4) * (b / a);
+    }
+    else
+    {
+        r = b;
+        theta = pi / 2 - (pi / 4) * (a / b);
+    }
+    return vec3(r * std::cos(theta), r * std::sin(theta), 0);
+}
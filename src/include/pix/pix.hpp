@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <math/vec3.hpp>
+#include <utils/image.hpp>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -17,9 +18,10 @@ public:
     void SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
     void SetPixel(int x, int y, color col, int samples_per_pixel);
     static double GetTime();
+    bool IsKeyPressed(int key);
 
     int width, height;
-    uint8_t* pixels;
+    image frame;
 private:
     GLFWwindow* window;
     GLuint VAO, VBO, EBO, shaderProgram, texture;
@@ -28,6 +30,6 @@ private:
     void _processInput(GLFWwindow* window);
     void _createTexture(GLuint *texture, uint8_t *pixels);
     GLFWwindow* _initializeWindow(int width, int height, std::string title);
-    uint8_t* _setupScene(GLuint *VAO, GLuint *VBO, GLuint *EBO, GLuint *shaderProgram, GLuint *texture);
+    void _setupScene(GLuint *VAO, GLuint *VBO, GLuint *EBO, GLuint *shaderProgram, GLuint *texture);
     void _updateTexture(void (*callback)(Pix* pix));
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "math/utils.hpp"
+
+class aabb {
+public:
+    aabb()
+        : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+    aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+    point3 min() const { return minimum; }
+    point3 max() const { return maximum; }
+
+    point3 centroid() const { return 0.5 * (minimum + maximum); }
+
+    bool empty() const {
+        return minimum.e[0] > maximum.e[0] || minimum.e[1] > maximum.e[1] || minimum.e[2] > maximum.e[2];
+    }
+
+    double surface_area() const {
+        if (empty()) return 0.0;
+        vec3 d = maximum - minimum;
+        return 2.0 * (d.e[0] * d.e[1] + d.e[1] * d.e[2] + d.e[2] * d.e[0]);
+    }
+
+    int longest_axis() const {
+        vec3 d = maximum - minimum;
+        if (d.e[0] > d.e[1] && d.e[0] > d.e[2]) return 0;
+        return d.e[1] > d.e[2] ? 1 : 2;
+    }
+
+    void expand(const point3& p) {
+        for (int a = 0; a < 3; a++) {
+            minimum.e[a] = fmin(minimum.e[a], p.e[a]);
+            maximum.e[a] = fmax(maximum.e[a], p.e[a]);
+        }
+    }
+
+    void expand(const aabb& box) {
+        for (int a = 0; a < 3; a++) {
+            minimum.e[a] = fmin(minimum.e[a], box.minimum.e[a]);
+            maximum.e[a] = fmax(maximum.e[a], box.maximum.e[a]);
+        }
+    }
+
+    // Slab test with the reciprocal direction precomputed by the caller.
+    // On a hit t_enter holds the distance at which the ray enters the box.
+    bool hit(const point3& origin, const vec3& inv_dir, real t_min, real t_max, real& t_enter) const {
+        for (int a = 0; a < 3; a++) {
+            real t0 = (minimum.e[a] - origin.e[a]) * inv_dir.e[a];
+            real t1 = (maximum.e[a] - origin.e[a]) * inv_dir.e[a];
+            if (inv_dir.e[a] < 0.0) {
+                real tmp = t0;
+                t0 = t1;
+                t1 = tmp;
+            }
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+            if (t_max < t_min)
+                return false;
+        }
+        t_enter = t_min;
+        return true;
+    }
+
+    bool hit(const ray& r, real t_min, real t_max) const {
+        vec3 d = r.direction();
+        vec3 inv_dir(1.0 / d.e[0], 1.0 / d.e[1], 1.0 / d.e[2]);
+        real t_enter;
+        return hit(r.origin(), inv_dir, t_min, t_max, t_enter);
+    }
+
+public:
+    point3 minimum;
+    point3 maximum;
+};
+
+inline aabb surrounding_box(const aabb& box0, const aabb& box1) {
+    aabb box = box0;
+    box.expand(box1);
+    return box;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "math/vec3.hpp"
+
+// Running per-pixel sums of radiance samples, kept in float to halve the memory
+// of a double buffer. Every pixel counts its own samples, which lets adaptive
+// sampling give pixels different sample counts. With features on, it also sums
+// what the samples saw first (see path_features) for the denoiser.
+class accumulation_buffer {
+public:
+    accumulation_buffer() {}
+
+    // Resizes the buffer and drops every sample
+    void reset(int width, int height, bool features = false) {
+        this->width = width;
+        this->height = height;
+        size_t pixels = static_cast<size_t>(width) * height;
+        sums.assign(pixels * 3, 0.0f);
+        luminance_sq.assign(pixels, 0.0f);
+        counts.assign(pixels, 0);
+        albedo_sums.assign(features ? pixels * 3 : 0, 0.0f);
+        normal_sums.assign(features ? pixels * 3 : 0, 0.0f);
+        depth_sums.assign(features ? pixels : 0, 0.0f);
+    }
+
+    void clear() { reset(width, height, has_features()); }
+
+    bool has_features() const { return !depth_sums.empty(); }
+
+    // Drops the samples of the pixels in [x0, x1) x [y0, y1)
+    void clear(int x0, int y0, int x1, int y1) {
+        for (int y = y0; y < y1; y++) {
+            size_t row = static_cast<size_t>(y) * width;
+            std::fill(sums.begin() + (row + x0) * 3, sums.begin() + (row + x1) * 3, 0.0f);
+            std::fill(luminance_sq.begin() + row + x0, luminance_sq.begin() + row + x1, 0.0f);
+            std::fill(counts.begin() + row + x0, counts.begin() + row + x1, 0);
+            if (has_features()) {
+                std::fill(albedo_sums.begin() + (row + x0) * 3, albedo_sums.begin() + (row + x1) * 3, 0.0f);
+                std::fill(normal_sums.begin() + (row + x0) * 3, normal_sums.begin() + (row + x1) * 3, 0.0f);
+                std::fill(depth_sums.begin() + row + x0, depth_sums.begin() + row + x1, 0.0f);
+            }
+        }
+    }
+
+    // Adds n samples whose colours sum to sum and whose squared luminances sum to lum_sq_sum
+    void add(int x, int y, const color& sum, double lum_sq_sum, int n) {
+        size_t i = static_cast<size_t>(y) * width + x;
+        float* p = &sums[i * 3];
+        p[0] += static_cast<float>(sum.e[0]);
+        p[1] += static_cast<float>(sum.e[1]);
+        p[2] += static_cast<float>(sum.e[2]);
+        luminance_sq[i] += static_cast<float>(lum_sq_sum);
+        counts[i] += n;
+    }
+
+    // Adds the feature sums of the samples that add() counted, has_features() must be true
+    void add_features(int x, int y, const color& albedo_sum, const vec3& normal_sum, double depth_sum) {
+        size_t i = static_cast<size_t>(y) * width + x;
+        for (int c = 0; c < 3; c++) {
+            albedo_sums[i * 3 + c] += static_cast<float>(albedo_sum.e[c]);
+            normal_sums[i * 3 + c] += static_cast<float>(normal_sum.e[c]);
+        }
+        depth_sums[i] += static_cast<float>(depth_sum);
+    }
+
+    color sum(int x, int y) const {
+        const float* p = &sums[(static_cast<size_t>(y) * width + x) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+
+    int count(int x, int y) const { return static_cast<int>(counts[static_cast<size_t>(y) * width + x]); }
+
+    // Variance of the pixel's mean luminance, estimated from the spread of its
+    // samples. Infinite while there are fewer than two samples.
+    double variance(int x, int y) const;
+
+    // Standard error of the pixel's mean luminance relative to that mean,
+    // infinite while there are fewer than two samples
+    double relative_error(int x, int y) const;
+
+    uint64_t total_samples() const;
+
+public:
+    int width = 0, height = 0;
+    std::vector<float> sums;
+    std::vector<float> luminance_sq;
+    std::vector<uint32_t> counts;
+    std::vector<float> albedo_sums, normal_sums, depth_sums; // Empty without features
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils/hittable.hpp"
+#include "utils/hittable_list.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Node of a flattened bvh. The first child of an interior node is stored
+// directly after it, so only the index of the second child is kept.
+struct bvh_node {
+    aabb box;
+    uint32_t offset; // Leaf: first primitive. Interior: index of the second child.
+    uint32_t count;  // Number of primitives in a leaf, 0 for interior nodes
+    uint32_t axis;   // Split axis, used to visit the children front to back
+};
+
+// Input of build_bvh: the bounds of one primitive and its index in the caller's list
+struct bvh_primitive {
+    aabb box;
+    point3 centroid;
+    uint32_t index;
+};
+
+// Builds a flattened hierarchy with the binned surface area heuristic. Reorders
+// prims so that every leaf covers the contiguous range [offset, offset + count).
+// traversal_cost is the price of visiting a node relative to one primitive test,
+// higher values give fuller leaves.
+std::vector<bvh_node> build_bvh(std::vector<bvh_primitive> &prims, int max_leaf_size, double traversal_cost = 1.0);
+
+// Bounding volume hierarchy over arbitrary hittables
+class bvh : public hittable
+{
+public:
+    static const int max_depth = 64;
+    static const int bin_count = 16;
+
+    bvh() {}
+    bvh(const hittable_list &list, int max_leaf_size = 4)
+        : bvh(list.objects, max_leaf_size) {}
+    bvh(const std::vector<shared_ptr<hittable>> &objects, int max_leaf_size = 4);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+    int depth() const;
+
+public:
+    std::vector<bvh_node> nodes;
+    std::vector<shared_ptr<hittable>> primitives;
+    // Objects without a bounding box are tested against every ray
+    std::vector<shared_ptr<hittable>> unbounded;
+
+private:
+    int subtree_depth(uint32_t node) const;
+};
@@ -15,11 +15,27 @@ public:
     );
     ray get_ray(double u, double v) const;
 
+    bool operator==(const camera& other) const;
+    bool operator!=(const camera& other) const { return !(*this == other); }
+
 private:
     point3 origin;
     point3 lower_left_corner;
     vec3 horizontal;
     vec3 vertical;
     vec3 u, v, w;
-    double lens_radius;
-};
\ No newline at end of file
+    real lens_radius;
+};
+
+// Placement and lens of a camera as a scene file gives them. The aspect ratio
+// is left out, it comes from the image the camera renders into.
+struct camera_settings {
+    point3 lookfrom = point3(0, 0, 0);
+    point3 lookat = point3(0, 0, -1);
+    vec3 vup = vec3(0, 1, 0);
+    double vfov = 40;
+    double aperture = 0;
+    double focus_dist = 0; // 0 focuses on lookat
+
+    camera make(double aspect_ratio) const;
+};
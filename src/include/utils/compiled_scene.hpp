@@ -0,0 +1,30 @@
+#pragma once
+
+#include "utils/flat_scene.hpp"
+#include "utils/material.hpp"
+#include "utils/camera.hpp"
+
+#include <optional>
+#include <string>
+
+// Binary snapshot of a flat_scene: a header holding the camera and the offset
+// of every buffer, the material records, then the structure of arrays buffers
+// and bvhs exactly as they sit in memory.
+// Loading maps the file and points the scene's views into it, so startup does
+// not depend on the size of the scene and pages are read as rays reach them.
+//
+// The file holds native byte order, reals and bvh nodes, so it only loads into
+// a build with the same precision on the same kind of machine. Its contents are
+// trusted: the header and the buffer bounds are checked, the bvhs are not.
+
+// True when path starts with the compiled scene magic
+bool is_compiled_scene(const std::string &path);
+
+// Fails, saying why, when world holds objects that could not be flattened
+bool save_compiled_scene(const std::string &path, const flat_scene &world, const material_table &materials,
+                         const std::optional<camera_settings> &view);
+
+// Replaces world, materials and view with the contents of path. Prints the
+// reason and returns false when the file is not a compiled scene for this build.
+bool load_compiled_scene(const std::string &path, flat_scene &world, material_table &materials,
+                         std::optional<camera_settings> &view);
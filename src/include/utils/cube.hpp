@@ -1,22 +1,43 @@
 #pragma once
 
 #include "utils/hittable.hpp"
+#include "utils/planar.hpp"
+#include "math/transform.hpp"
 #include "math/vec3.hpp"
 #include <memory>
 #include <vector>
 
+// Box of side side_len around cen, its edges along up, front and
+// right = cross(up, front). Scaled or skewed axes give a parallelepiped.
+// Rays are intersected analytically with a slab test in the frame of the box.
 class cube : public hittable
 {
 public:
-    cube(point3 cen, double side_len, vec3 up, vec3 front, std::shared_ptr<material> m);
+    cube(point3 cen, real side_len, vec3 up, vec3 front, material_id m);
 
     virtual bool hit(
-        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+    // Face i of the six, with its normal pointing out of the box
+    quad face(int i) const;
+    // The same for the box around center with the edges edges[0] to [2],
+    // which must be right handed like right, up and front
+    static quad face(const point3 &center, const vec3 edges[3], int i, material_id m);
+
+    // Slab test of r against the box that to_local maps onto [-1, 1], the
+    // scalar version of cube_hit_packet. Sets t and the outward normal, not
+    // unit length, of the face the ray enters or leaves through.
+    static bool intersect(const affine_transform &to_local, const ray &r, real t_min, real t_max, real &t,
+                          vec3 &outward_normal);
 
 public:
     point3 center;
-    double side_len;
+    real side_len;
     vec3 up, front, right;
-    triangle triangles[12];
-    std::shared_ptr<material> mat_ptr;
-};
\ No newline at end of file
+    // Maps the box onto [-1, 1] on every axis
+    affine_transform to_local;
+    material_id mat_id;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "utils/accumulation_buffer.hpp"
+#include "utils/image.hpp"
+#include "utils/thread_pool.hpp"
+
+// How denoise filters a frame. The defaults suit 8 to 64 samples per pixel.
+struct denoise_settings {
+    bool enabled = false;
+    int passes = 5;              // Each pass doubles the reach, 5 passes blend pixels up to 62 apart
+    double color_sigma = 4.0;    // Luminance difference, in standard deviations of the noise, that still blends
+    double normal_power = 128.0; // Sharpness of the cut between surfaces facing different ways
+    double depth_sigma = 1.0;    // Depth difference, in steps of the local depth slope, that still blends
+    double albedo_sigma = 0.1;   // Albedo difference that still blends
+};
+
+// Writes the mean features of every pixel of accum, which must have features,
+// to the feature buffers of img
+void resolve_features(const accumulation_buffer& accum, image& img, thread_pool& pool);
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by the
+// feature buffers of img, which resolve_features filled, and by the variance
+// of every pixel's mean, as in SVGF (Schied et al. 2017). The mean radiance of
+// accum is divided by the albedo, filtered and multiplied back into img.hdr,
+// so that the colours of surfaces stay sharp and only their lighting blurs.
+// Every pass runs in bands of rows on pool.
+void denoise(const accumulation_buffer& accum, image& img, const denoise_settings& settings, thread_pool& pool);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/camera.hpp"
+#include "utils/hittable.hpp"
+#include "utils/image.hpp"
+#include "utils/material.hpp"
+#include "utils/render_stats.hpp"
+#include "utils/renderer.hpp"
+#include "utils/tcp_socket.hpp"
+
+// Spreads frames over worker processes, on this machine or others. Every
+// worker loads the same scene itself and connects to the coordinator, which
+// hands out blocks of the frame and copies their radiance back into place.
+// Pixels seed their own samples, so the frame comes out exactly as a local
+// render with the same settings would.
+//
+// Workers may join and leave at any time. The blocks of a worker that drops
+// out are handed out again. Once every block has been handed out, idle workers
+// also get copies of the blocks still in flight, and the first copy back wins.
+// A frame therefore doesn't wait for a slow or stuck worker.
+
+// Hash of the scene's bounds and materials, so that workers holding another
+// scene or a build of other precision are turned away
+uint64_t scene_fingerprint(const hittable &world, const material_table &materials);
+
+class tile_coordinator
+{
+public:
+    // Listens for workers on port. Prints the reason and returns null on failure.
+    static std::unique_ptr<tile_coordinator> listen(int port, uint64_t fingerprint);
+    ~tile_coordinator(); // Disconnects the workers, which then exit
+
+    tile_coordinator(const tile_coordinator &) = delete;
+    tile_coordinator &operator=(const tile_coordinator &) = delete;
+
+    // Renders a frame of cam into img with the workers and returns once every
+    // block is back, waiting for workers if none are connected. Adaptive
+    // sampling is left out. progress, if given, is called on this thread with
+    // the blocks done at most once every progress_interval.
+    void render(const camera &cam, const render_settings &settings, image &img,
+                const render_job::progress_callback &progress = nullptr);
+
+    // Counters of the last frame, summed over the blocks that made it into the image
+    const render_stats &frame_stats() const { return stats; }
+
+    int workers() const;
+
+    // Side of the square blocks handed to the workers, in pixels
+    int block_size = 64;
+    std::chrono::milliseconds progress_interval{50};
+
+private:
+    struct block {
+        tile region;
+        int holders = 0; // Workers rendering it right now
+        bool done = false;
+    };
+
+    struct connection;
+
+    tile_coordinator(std::unique_ptr<tcp_socket> listener, int port, uint64_t fingerprint);
+    void accept_loop();
+    void serve(connection &worker);
+    int take_block(connection &worker);
+    void drop_blocks(connection &worker);
+
+    std::unique_ptr<tcp_socket> listener;
+    const int port;
+    const uint64_t fingerprint;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_available, frame_progress;
+    bool stopping = false;
+    std::list<connection> connections;
+    int ready_workers = 0;
+
+    // The frame in progress, guarded by mutex
+    uint32_t frame_id = 0;
+    bool frame_active = false;
+    std::vector<unsigned char> frame_message; // Sent to every worker before its first block of the frame
+    image *target = nullptr;
+    display_settings display;
+    std::vector<block> blocks;
+    std::deque<int> unassigned; // Blocks nobody has held yet, or whose holders dropped out
+    int blocks_left = 0;
+    render_stats stats;
+
+    std::thread acceptor; // Last, so that it starts after everything it uses
+};
+
+// Connects to the coordinator at host:port and renders the blocks it sends with
+// tracer until the coordinator closes the connection. Waits for the
+// coordinator to come up. Returns false when turned away or on a broken
+// connection.
+bool run_tile_worker(const std::string &host, int port, const hittable &world, const material_table &materials,
+                     renderer &tracer);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "utils/hittable.hpp"
+#include "utils/hittable_list.hpp"
+#include "utils/bvh.hpp"
+#include "utils/mapped_file.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Render backend that unpacks spheres, triangles, cubes, quads, disks, planes
+// and triangle meshes into one structure of arrays buffer per primitive type. Every
+// type but the planes has its own bvh whose leaves are contiguous ranges of the
+// buffer, intersected in branch free loops without any virtual calls. Planes
+// are tested one after the other against every ray. Objects of other types
+// keep going through their own hit functions. Hit records match the source
+// objects. The buffers are views, into vectors built from objects or into a
+// mapped compiled scene file (see compiled_scene.hpp).
+class flat_scene : public hittable
+{
+public:
+    static const int max_leaf_size = 8;
+
+    flat_scene() {}
+    explicit flat_scene(const hittable_list &objects);
+
+    // Moves keep the vectors the views point into, copies would not
+    flat_scene(const flat_scene &) = delete;
+    flat_scene &operator=(const flat_scene &) = delete;
+    flat_scene(flat_scene &&) = default;
+    flat_scene &operator=(flat_scene &&) = default;
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+    size_t sphere_count() const { return spheres.mat_id.size(); }
+    size_t triangle_count() const { return triangles.mat_id.size(); }
+    size_t box_count() const { return boxes.mat_id.size(); }
+    size_t quad_count() const { return quads.mat_id.size(); }
+    size_t disk_count() const { return disks.mat_id.size(); }
+    size_t plane_count() const { return planes.mat_id.size(); }
+
+public:
+    // The geometry arrays carry max_leaf_size unused entries at the end, so that
+    // the leaf loops can always read a full max_leaf_size run
+    struct sphere_buffer {
+        array_view<real> cx, cy, cz, radius;
+        array_view<material_id> mat_id;
+    };
+
+    struct triangle_buffer {
+        array_view<real> v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+        array_view<real> nx, ny, nz; // Unit length, outward
+        array_view<material_id> mat_id;
+    };
+
+    // Cubes as the map onto [-1, 1] of cube::to_local, m[i * 4 + j] holds m[i][j]
+    struct box_buffer {
+        array_view<real> m[12];
+        array_view<material_id> mat_id;
+    };
+
+    // The members of quad, u and v are not padded
+    struct quad_buffer {
+        array_view<real> qx, qy, qz, nx, ny, nz, offset, ax, ay, az, bx, by, bz;
+        array_view<real> ux, uy, uz, vx, vy, vz;
+        array_view<material_id> mat_id;
+    };
+
+    struct disk_buffer {
+        array_view<real> cx, cy, cz, nx, ny, nz, offset, radius;
+        array_view<material_id> mat_id;
+    };
+
+    // Without padding, planes are not tested in leaves
+    struct plane_buffer {
+        array_view<real> nx, ny, nz, offset;
+        array_view<material_id> mat_id;
+    };
+
+    sphere_buffer spheres;
+    triangle_buffer triangles;
+    box_buffer boxes;
+    quad_buffer quads;
+    disk_buffer disks;
+    plane_buffer planes;
+    array_view<bvh_node> sphere_nodes, triangle_nodes, box_nodes, quad_nodes, disk_nodes;
+    bvh others; // Everything that could not be flattened
+    std::shared_ptr<const mapped_file> source; // File the views point into, if any
+
+private:
+    // What the views point into when the scene was built from objects
+    struct storage {
+        std::vector<real> cx, cy, cz, radius;
+        std::vector<material_id> sphere_mat_id;
+        std::vector<real> v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+        std::vector<real> nx, ny, nz;
+        std::vector<material_id> triangle_mat_id;
+        std::vector<real> box_m[12];
+        std::vector<material_id> box_mat_id;
+        std::vector<real> qx, qy, qz, quad_nx, quad_ny, quad_nz, quad_offset, ax, ay, az, bx, by, bz;
+        std::vector<real> ux, uy, uz, vx, vy, vz;
+        std::vector<material_id> quad_mat_id;
+        std::vector<real> disk_cx, disk_cy, disk_cz, disk_nx, disk_ny, disk_nz, disk_offset, disk_radius;
+        std::vector<material_id> disk_mat_id;
+        std::vector<real> plane_nx, plane_ny, plane_nz, plane_offset;
+        std::vector<material_id> plane_mat_id;
+        std::vector<bvh_node> sphere_nodes, triangle_nodes, box_nodes, quad_nodes, disk_nodes;
+    };
+
+    void add(const shared_ptr<hittable> &object, std::vector<shared_ptr<hittable>> &unflattened);
+    void add_triangle(const point3 &v0, const vec3 &e1, const vec3 &e2, const vec3 &normal, material_id mat);
+    void build();
+
+    storage built;
+
+    // With any_hit set these stop at the first hit, which need not be the closest
+    bool hit_spheres(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+    bool hit_triangles(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+    bool hit_boxes(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+    bool hit_quads(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+    bool hit_disks(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+    bool hit_planes(const ray &r, real t_min, real &closest, uint32_t &index, bool any_hit = false) const;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// Picks the resolution and samples per pixel of interactive frames, so that
+// frames of a moving camera take about target_seconds however expensive the
+// view is. Samples per pixel go first, then the resolution drops. A camera
+// that stands still gets full frames, which converge as usual.
+//
+// The controller learns the cost of a sample from the frames it is told about
+// and rescales the next frame to fit the target. Slow frames are believed at
+// once, fast ones only bit by bit, so a view full of glass drops the
+// resolution straight away and the resolution climbs back gently.
+class frame_time_controller {
+public:
+    struct frame_size {
+        int width, height;
+        int samples; // Samples per pixel of the frame
+
+        bool operator==(const frame_size& other) const
+        {
+            return width == other.width && height == other.height && samples == other.samples;
+        }
+        bool operator!=(const frame_size& other) const { return !(*this == other); }
+    };
+
+    // full is the size and samples of a frame at full quality. A target of 0
+    // turns scaling off and every frame is full.
+    frame_time_controller(frame_size full, double target_seconds);
+
+    // Size of the next frame, moving tells whether its camera differs from the last one
+    frame_size next(bool moving) const;
+
+    // Reports that a frame of the given size took seconds to render
+    void finished(const frame_size& size, double seconds);
+
+    // Smallest fraction of the full width and height a moving frame may shrink to
+    double min_scale = 0.25;
+
+private:
+    void update_moving_size();
+
+    frame_size full, moving_size;
+    double target_seconds;
+    double seconds_per_sample = 0.0; // Per pixel sample, 0 until a frame has been measured
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/image.hpp"
+
+// Encodes and writes frames on background threads, so that the renderer can go
+// on with the next frame while the last one is compressed and saved. Frames are
+// handed over in a few framebuffers that cycle between the caller and the
+// encoders. Once all of them are queued, acquire() waits for the encoders.
+class frame_writer
+{
+public:
+    // encoders threads and buffers framebuffers, 3 buffers renders one frame while
+    // two are being encoded
+    explicit frame_writer(int encoders = 2, int buffers = 3);
+    ~frame_writer(); // Writes out every queued frame
+
+    frame_writer(const frame_writer &) = delete;
+    frame_writer &operator=(const frame_writer &) = delete;
+
+    // Waits for a free framebuffer and resizes it to width x height. Its old
+    // contents are left as they were when the size matches.
+    image &acquire(int width, int height);
+
+    // Queues frame, which acquire() returned, to be written to path. The format
+    // comes from the extension, as for image::write. Frames sent to a .y4m path
+    // are appended to one raw video stream in the order they were submitted.
+    void submit(image &frame, const std::string &path);
+
+    // Waits until every queued frame is written and closes the video streams.
+    // Returns false if any write failed since the last flush.
+    bool flush();
+
+    // Frame rate written to the header of new video streams
+    int video_fps = 30;
+    // Also write the feature buffers of image frames that have them, see image::write_features
+    bool write_features = false;
+
+private:
+    struct job {
+        image *frame;
+        std::string path;
+        uint64_t sequence; // Position in its video stream
+    };
+
+    struct video_stream {
+        FILE *file = nullptr;
+        int width = 0, height = 0;
+        uint64_t submitted = 0, written = 0;
+        bool failed = false;
+    };
+
+    void encoder_loop();
+    bool write_video_frame(const job &work, std::vector<uint8_t> &planes, std::unique_lock<std::mutex> &lock);
+    void release(image *frame);
+
+    std::vector<std::unique_ptr<image>> buffers;
+    std::vector<image *> free_buffers;
+    std::deque<job> queue;
+    std::map<std::string, video_stream> streams;
+    std::vector<std::thread> encoders;
+
+    std::mutex mutex;
+    std::condition_variable work_available, buffer_available, stream_advanced, all_done;
+    int writing = 0; // Jobs taken off the queue but not finished
+    bool failed = false;
+    bool stopping = false;
+};
+
+// Replaces the first run of '#' in pattern with the frame number, zero padded
+// to the length of the run
+std::string frame_path(const std::string &pattern, int frame);
+
+// True for the formats that hold a whole sequence in one file
+bool is_video_path(const std::string &path);
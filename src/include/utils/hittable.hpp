@@ -1,16 +1,32 @@
 #pragma once
 
 #include "math/ray.hpp"
+#include "math/ray_packet.hpp"
+#include "utils/aabb.hpp"
+#include <cstdint>
 #include <memory>
+#include <type_traits>
 
-class material;
+// Index of a material in the scene's material_table
+using material_id = uint32_t;
+
+class light_list;
+
+// How light_list::sample could have picked the point of a hit, so that
+// light_list::pdf only weighs points it can actually produce
+enum class light_shape : uint8_t {
+    none,   // Never listed (planes), or a sphere that the ray leaves from the inside
+    area,   // A triangle or disk, or a face of a quad or cube picked as two triangles
+    sphere, // Listed unless an instance skews it
+};
 
 struct hit_record {
     point3 p;
     vec3 normal;
-    std::shared_ptr<material> mat_ptr;
-    double t;
+    material_id mat_id;
+    real t;
     bool front_face;
+    light_shape light;
 
     inline void set_face_normal(const ray& r, const vec3& outward_normal) {
         front_face = dot(r.direction(), outward_normal) < 0;
@@ -18,21 +34,43 @@ struct hit_record {
     }
 };
 
+// Closer hits overwrite the record all the time, keep that a plain memory copy
+static_assert(std::is_trivially_copyable<hit_record>::value, "hit_record must stay trivially copyable");
+
 class hittable {
 public:
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const = 0;
+    // Returns false for unbounded objects, which acceleration structures test separately.
+    virtual bool bounding_box(aabb& output_box) const = 0;
+
+    // Intersects every active lane of the packet. Lanes that find a closer hit get
+    // their t_max shrunk and hit_objects[lane] set to the object that can fill in
+    // the full hit_record. The default tests the lanes one at a time.
+    virtual void hit_packet(ray_packet& packet, const hittable* hit_objects[]) const;
+
+    // Whether anything lies along r between t_min and t_max, for shadow rays.
+    // Stops at the first hit it finds, the default falls back to hit.
+    virtual bool occluded(const ray& r, real t_min, real t_max) const;
+
+    // Hands the primitives to lights, which keeps those with an emitting
+    // material. The default adds nothing, so lights on objects that don't
+    // override it are only found by the paths that happen to hit them.
+    virtual void add_lights(light_list& lights) const;
 };
 
 class triangle : public hittable {
 public:
     triangle() {}
-    triangle(const point3 vertices[3], std::shared_ptr<material> m)
-        : vertices{ vertices[0], vertices[1], vertices[2] }, mat_ptr(m) {};
+    triangle(const point3 vertices[3], material_id m)
+        : vertices{ vertices[0], vertices[1], vertices[2] }, mat_id(m) {};
     
-    triangle(const point3& v0, const point3& v1, const point3& v2, std::shared_ptr<material> m)
-        : vertices{ v0, v1, v2 }, mat_ptr(m) {};
+    triangle(const point3& v0, const point3& v1, const point3& v2, material_id m)
+        : vertices{ v0, v1, v2 }, mat_id(m) {};
 
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+    virtual bool bounding_box(aabb& output_box) const override;
+    virtual void hit_packet(ray_packet& packet, const hittable* hit_objects[]) const override;
+    virtual void add_lights(light_list& lights) const override;
 
     point3& operator[](int i) { return vertices[i]; }
     const point3& operator[](int i) const { return vertices[i]; }
@@ -43,7 +81,7 @@ public:
 
 public:
     vec3 vertices[3]; // [0] is the top vertex, [1] is the bottom left vertex, [2] is the bottom right vertex
-    std::shared_ptr<material> mat_ptr;
+    material_id mat_id = 0;
 };
 
-bool ray_triangle_intersection(const ray& r, const triangle tri, double t_min, double t_max, hit_record& rec);
\ No newline at end of file
+bool ray_triangle_intersection(const ray& r, const triangle tri, real t_min, real t_max, hit_record& rec);
\ No newline at end of file
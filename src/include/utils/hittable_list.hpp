@@ -17,7 +17,11 @@ public:
     void clear() { objects.clear(); }
     void add(shared_ptr<hittable> object) { objects.push_back(object); }
     virtual bool hit(
-        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
 
 public:
     std::vector<shared_ptr<hittable>> objects;
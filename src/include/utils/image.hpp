@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "math/vec3.hpp"
+
+// 8-bit RGB framebuffer, row 0 is the bottom of the image. Images from the
+// renderer also keep the linear radiance the pixels were tone mapped from.
+class image {
+public:
+    image() : width(0), height(0) {}
+    image(int width, int height)
+        : width(width), height(height), pixels(static_cast<size_t>(width) * height * 3, 0) {}
+
+    void set_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b);
+    void set_pixel(int x, int y, color col, int samples_per_pixel);
+
+    uint8_t* data() { return pixels.data(); }
+    const uint8_t* data() const { return pixels.data(); }
+
+    // The format is picked from the extension: .png, .jpg/.jpeg, .bmp, .ppm, or
+    // .pfm and .hdr for floats. The float formats hold hdr when there is one.
+    // Safe to call from several threads at once, on different paths.
+    bool write(const std::string& path) const;
+
+    // Writes the feature buffers next to path as float maps, photo.png gives
+    // photo.albedo.pfm, photo.normal.pfm and photo.depth.pfm
+    bool write_features(const std::string& path) const;
+
+public:
+    int width, height;
+    std::vector<uint8_t> pixels;
+    // Linear RGBA, 4 floats a pixel with alpha 1. Empty until a renderer writes
+    // to the image, see tonemap.hpp for how it becomes pixels.
+    std::vector<float> hdr;
+    // What each pixel sees first, averaged over its samples, see path_features.
+    // albedo and normal hold 3 floats a pixel, depth one. Empty unless the
+    // renderer gathers features (render_settings::features or denoising).
+    std::vector<float> albedo, normal, depth;
+};
+
+// Stretches src over all of dst with bilinear filtering. Meant for upscaling,
+// shrinking by more than half skips pixels.
+void resample(const image& src, image& dst);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "math/transform.hpp"
+#include "utils/hittable.hpp"
+#include "utils/bvh.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One placement of shared geometry, e.g. a triangle_mesh or a bvh that keeps
+// its own hierarchy in object space. Rays are moved into object space rather
+// than the geometry into the world, so every copy costs the instance alone.
+// Only the world to object map is stored, hits need nothing else.
+class instance final : public hittable
+{
+public:
+    // object_to_world must be invertible
+    instance(shared_ptr<const hittable> geometry, const affine_transform &object_to_world);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+public:
+    shared_ptr<const hittable> geometry;
+    affine_transform world_to_object;
+
+private:
+    // The direction keeps the scale of the map, so a distance along the
+    // object space ray is the same distance along r
+    ray to_object(const ray &r) const
+    {
+        return ray(world_to_object.point(r.orig), world_to_object.vector(r.dir));
+    }
+};
+
+// Top level of a two level hierarchy: a bvh over instances, whose geometry
+// holds the bottom levels. Instances are stored by value in leaf order, so
+// millions of copies of a few meshes take the memory of the meshes plus about
+// 200 bytes per copy.
+class instance_bvh : public hittable
+{
+public:
+    instance_bvh() {}
+    explicit instance_bvh(std::vector<instance> instances, int max_leaf_size = 2);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+    // Bytes held by the instances and the nodes, without the shared geometry
+    size_t memory_size() const;
+
+public:
+    std::vector<instance> instances; // Reordered to match the bvh leaves
+    std::vector<bvh_node> nodes;
+    // Instances of unbounded geometry are tested against every ray
+    std::vector<instance> unbounded;
+};
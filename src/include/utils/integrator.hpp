@@ -0,0 +1,52 @@
+#pragma once
+
+#include "math/utils.hpp"
+#include "utils/hittable.hpp"
+#include "utils/lights.hpp"
+#include "utils/material.hpp"
+
+// What the camera ray of a sample sees, the guide of the denoiser. Perfect
+// mirrors and glass take no light samples and pass on the features of the
+// surface they show, tinted by the path so far.
+struct path_features {
+    color albedo = color(0, 0, 0); // The sky's colour where the path escapes
+    vec3 normal = vec3(0, 0, 0);   // Unit length, zero for the sky
+    real depth = 0;                // Distance to the first hit along the camera ray, zero for the sky
+};
+
+// Iterative path tracer. Carries the path throughput and, from rr_min_depth
+// bounces on, ends paths whose throughput has dropped below rr_threshold with
+// Russian roulette, reweighting the survivors so the estimate stays unbiased.
+//
+// At every hit on a material that samples_lights, a shadow ray goes to a point
+// picked on one of the lights as well. Light reaching a hit that way and light
+// that the scattered ray runs into are weighed against each other with the
+// power heuristic, so that each comes mostly from whichever of the two picks
+// it more easily: small lights from the light samples, glossy reflections of
+// large ones from scattering.
+class path_integrator {
+public:
+    path_integrator(const material_table& materials, const light_list& lights, int max_depth = 50,
+                    int rr_min_depth = 3, double rr_threshold = 1.0)
+        : materials(materials), lights(lights), max_depth(max_depth), rr_min_depth(rr_min_depth),
+          rr_threshold(rr_threshold) {}
+
+    // Radiance arriving along r, and in features what r sees when it isn't null
+    color li(const ray& r, const hittable& world, path_features* features = nullptr) const;
+    // Same, for a camera ray whose closest hit has already been found
+    color li(const ray& r, bool hit, const hit_record& rec, const hittable& world,
+             path_features* features = nullptr) const;
+
+    static color background(const ray& r);
+
+public:
+    const material_table& materials; // Resolves the material ids of the world's hit records
+    const light_list& lights;        // Emitters of the world, sampled directly
+    int max_depth;        // Longest path in ray segments, longer paths return black
+    int rr_min_depth;     // Bounces before Russian roulette may end a path
+    double rr_threshold;  // Roulette only paths whose largest throughput channel is below this
+
+private:
+    // Light from one light sample that reaches rec and leaves along -r_in, weighted for MIS
+    color sample_light(const ray& r_in, const hit_record& rec, const material& mat, const hittable& world) const;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "math/transform.hpp"
+#include "math/utils.hpp"
+#include "utils/hittable.hpp"
+#include "utils/material.hpp"
+
+#include <vector>
+
+// A point on a light, picked by light_list::sample
+struct light_sample {
+    point3 p;
+    vec3 normal; // Unit length
+    color emit;
+    real pdf; // Per unit solid angle as seen from the shading point
+};
+
+// The emitting spheres, triangles and disks of a world, for sampling direct
+// light. A light is picked in proportion to its power, then a point uniformly
+// on the triangle, the disk or the half of the sphere that faces the shading
+// point. Every
+// point of a light material is then picked with the same density per unit
+// area, so the density of a light that a scattered ray runs into follows from
+// the material of its hit record, for the primitives whose hit record says
+// they are listed (see light_shape).
+class light_list
+{
+public:
+    // Collects the lights of world through hittable::add_lights
+    light_list(const hittable &world, const material_table &materials);
+
+    // Called by hittable::add_lights, primitives of other materials are skipped
+    void add_sphere(const point3 &center, real radius, material_id m);
+    void add_triangle(const point3 &v0, const vec3 &e1, const vec3 &e2, material_id m);
+    void add_disk(const point3 &center, const vec3 &normal, real radius, material_id m);
+
+    // Moves the primitives added until the matching pop_transform from the
+    // object space of world_to_object to world space, nested pushes compose.
+    // Set by instance::add_lights. A sphere only stays a sphere when every
+    // level is a similarity, others are left out like instance::hit leaves
+    // them out of pdf, and only found by the paths that hit them.
+    void push_transform(const affine_transform &world_to_object);
+    void pop_transform();
+
+    bool empty() const { return lights.empty(); }
+    size_t size() const { return lights.size(); }
+    // Primitives of an emitting material handed to the add functions so far,
+    // listed or not
+    size_t offered() const { return offered_count; }
+
+    // Picks a point on a light as seen from p. Returns false when the point
+    // can't be lit that way, as from inside a light sphere.
+    bool sample(const point3 &p, light_sample &s) const;
+
+    // Density per unit solid angle with which sample picks the light point of
+    // rec, hit along r. Zero for the hits on anything but a listed light,
+    // including light spheres around the origin of r.
+    real pdf(const ray &r, const hit_record &rec) const;
+
+private:
+    enum class shape : uint8_t { triangle, sphere, disk };
+
+    struct light {
+        shape kind;
+        point3 p; // Centre or first vertex
+        // Edges of a triangle. For a disk two perpendicular radii, which an
+        // instance may stretch into the semi-axes of an ellipse.
+        vec3 e1, e2;
+        real radius; // Of a sphere
+        material_id mat;
+    };
+
+    bool emits(material_id m) const;
+    void add(const light &l, real area);
+
+    const material_table &materials;
+    struct level {
+        affine_transform object_to_world; // Composed with the outer levels
+        bool keeps_spheres;               // This and every outer level is a similarity
+    };
+    std::vector<level> transforms; // Innermost last
+    std::vector<light> lights;
+    std::vector<real> cdf;     // Running sum of the light powers, ends at 1
+    std::vector<real> density; // Per material, chance of a point per unit area
+    size_t offered_count = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read only view of count values somewhere in memory, either in a vector
+// owned next to it or in a mapped file
+template <typename T>
+struct array_view {
+    using value_type = T;
+
+    const T *data = nullptr;
+    size_t count = 0;
+
+    array_view() {}
+    array_view(const T *data, size_t count) : data(data), count(count) {}
+    template <typename Container>
+    array_view(const Container &values) : data(values.data()), count(values.size()) {}
+
+    const T &operator[](size_t i) const { return data[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T *begin() const { return data; }
+    const T *end() const { return data + count; }
+};
+
+// A whole file mapped read only into memory. Pages are read in by the OS the
+// first time they are touched, so opening costs the same for any file size.
+class mapped_file
+{
+public:
+    // Prints the reason and returns null when the file can't be opened or mapped
+    static std::shared_ptr<const mapped_file> open(const std::string &path);
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+    ~mapped_file();
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    mapped_file() {}
+
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *mapping = nullptr;
+#endif
+};
@@ -3,21 +3,25 @@
 #include "math/utils.hpp"
 #include "utils/hittable.hpp"
 
-
-class material{
-public:
-    virtual bool scatter(
-        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-    ) const = 0;
-};
-
-class lambertian : public material
+#include <variant>
+#include <vector>
+
+// The material types form a closed set held in the material variant below, so
+// scatter is dispatched by std::visit over the variant instead of through a vtable.
+//
+// Besides scatter, every type tells the integrator whether direct light can be
+// sampled at its hits, and if so gives the BSDF times the cosine of a direction
+// together with the density with which scatter picks that direction. scatter
+// picks directions in proportion to the BSDF times the cosine, so the former is
+// the attenuation times the latter. Hit records carry unit normals.
+
+class lambertian
 {
 public:
     lambertian(const color &a) : albedo(a) {}
 
-    virtual bool scatter(
-        const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const override
+    bool scatter(
+        const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const
     {
         (void)r_in;
         auto scatter_direction = rec.normal + random_unit_vector();
@@ -31,16 +35,27 @@ public:
         return true;
     }
 
+    bool samples_lights() const { return true; }
+
+    color scattering(const ray &r_in, const hit_record &rec, const vec3 &direction, real &pdf) const
+    {
+        // The point on the unit sphere around the normal makes a cosine weighted direction
+        (void)r_in;
+        real cosine = dot(unit_vector(direction), rec.normal);
+        pdf = cosine > 0 ? cosine / real(pi) : 0;
+        return albedo * pdf;
+    }
+
     color albedo;
 };
 
-class metal : public material
+class metal
 {
 public:
-    metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+    metal(const color& a, real f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
-    virtual bool scatter(
-        const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const override
+    bool scatter(
+        const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const
     {
         vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
         scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
@@ -48,29 +63,54 @@ public:
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
+    // A mirror without fuzz reflects into a single direction, no light sample lands there
+    bool samples_lights() const { return fuzz > 0; }
+
+    color scattering(const ray &r_in, const hit_record &rec, const vec3 &direction, real &pdf) const
+    {
+        // scatter picks a uniform point in the ball of radius fuzz around the
+        // mirror direction. A direction is as likely as the stretch of its ray
+        // inside the ball, weighted by the squared distance from the origin.
+        pdf = 0;
+        vec3 w = unit_vector(direction);
+        if (fuzz <= 0 || dot(w, rec.normal) <= 0)
+            return color(0, 0, 0);
+        vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+        real b = dot(w, reflected);
+        real discriminant = b * b - reflected.length_squared() + fuzz * fuzz;
+        if (discriminant <= 0)
+            return color(0, 0, 0);
+        real root = sqrt(discriminant);
+        real t_far = b + root, t_near = fmax(b - root, real(0));
+        if (t_far <= 0)
+            return color(0, 0, 0);
+        pdf = (t_far * t_far * t_far - t_near * t_near * t_near) / (4 * real(pi) * fuzz * fuzz * fuzz);
+        return albedo * pdf;
+    }
+
     color albedo;
-    double fuzz;
+    real fuzz;
 };
 
-class dielectric : public material
+class dielectric
 {
 public:
-    dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+    dielectric(real index_of_refraction) : ir(index_of_refraction) {}
 
-    virtual bool scatter(
+    bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
-        ) const override {
+        ) const {
             attenuation = color(1.0, 1.0, 1.0);
-            double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
+            real refraction_ratio = rec.front_face ? (1.0/ir) : ir;
 
             vec3 unit_direction = unit_vector(r_in.direction());
-            double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-            double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+            real cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+            real sin_theta = sqrt(1.0 - cos_theta * cos_theta);
 
             bool cannot_refract = refraction_ratio * sin_theta > 1.0;
             vec3 direction;
 
-            if(cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
+            if(cannot_refract || reflectance(cos_theta, refraction_ratio) > sample_1d())
                 direction = reflect(unit_direction, rec.normal);
             else
                 direction = refract(unit_direction, rec.normal, refraction_ratio);
@@ -79,13 +119,99 @@ public:
             return true;
         }
 
-    double ir; // Index of Refraction
+    // Picks between two directions, no light sample lands on either
+    bool samples_lights() const { return false; }
+
+    color scattering(const ray&, const hit_record&, const vec3&, real& pdf) const {
+        pdf = 0;
+        return color(0, 0, 0);
+    }
+
+    real ir; // Index of Refraction
 
 private:
-    static double reflectance(double cosine, double ref_idx){
+    static real reflectance(real cosine, real ref_idx){
         // Use Schlick's approximation for reflectance.
         auto r0 = (1-ref_idx) / (1+ref_idx);
         r0 = r0*r0;
         return r0 + (1-r0)*pow((1 - cosine), 5);
     }
+};
+
+// Gives off emit on both sides and absorbs whatever arrives. Lights are
+// sampled directly at the hits on other materials, see light_list.
+class diffuse_light
+{
+public:
+    diffuse_light(const color &e) : emit(e) {}
+
+    bool scatter(const ray &, const hit_record &, color &, ray &) const { return false; }
+
+    bool samples_lights() const { return false; }
+
+    color scattering(const ray &, const hit_record &, const vec3 &, real &pdf) const
+    {
+        pdf = 0;
+        return color(0, 0, 0);
+    }
+
+    color emit;
+};
+
+using material = std::variant<lambertian, metal, dielectric, diffuse_light>;
+
+inline bool scatter(const material &m, const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered)
+{
+    return std::visit([&](const auto &typed)
+                      { return typed.scatter(r_in, rec, attenuation, scattered); }, m);
+}
+
+inline bool samples_lights(const material &m)
+{
+    return std::visit([](const auto &typed)
+                      { return typed.samples_lights(); }, m);
+}
+
+// BSDF times the cosine toward direction, and in pdf the solid angle density
+// with which scatter picks that direction. Zero where samples_lights is false.
+inline color scattering(const material &m, const ray &r_in, const hit_record &rec, const vec3 &direction, real &pdf)
+{
+    return std::visit([&](const auto &typed)
+                      { return typed.scattering(r_in, rec, direction, pdf); }, m);
+}
+
+// Radiance given off at a hit, black for everything but lights
+inline color emitted(const material &m)
+{
+    if (auto light = std::get_if<diffuse_light>(&m))
+        return light->emit;
+    return color(0, 0, 0);
+}
+
+// Colour of the surface in the denoiser's albedo buffer, white for glass and lights
+inline color surface_albedo(const material &m)
+{
+    if (auto diffuse = std::get_if<lambertian>(&m))
+        return diffuse->albedo;
+    if (auto mirror = std::get_if<metal>(&m))
+        return mirror->albedo;
+    return color(1, 1, 1);
+}
+
+// Owns the materials of a scene. Primitives and hit records refer to them by
+// material_id, so nothing on the render path touches a reference count.
+class material_table
+{
+public:
+    material_id add(const material &m)
+    {
+        materials.push_back(m);
+        return static_cast<material_id>(materials.size() - 1);
+    }
+
+    const material &operator[](material_id id) const { return materials[id]; }
+    size_t size() const { return materials.size(); }
+
+public:
+    std::vector<material> materials; // Stored by value, next to each other
 };
\ No newline at end of file
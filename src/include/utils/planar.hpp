@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils/hittable.hpp"
+#include "math/vec3.hpp"
+
+// Flat shapes, intersected analytically: the distance to their plane, then
+// whether the point lies within the shape. Their normal is fixed, the hit
+// record flips it toward the ray as for every other surface.
+
+// Parallelogram spanned by the edges u and v from corner q, its outward
+// normal points along cross(u, v). A square of side s is quad(q, s * x, s * y).
+class quad : public hittable
+{
+public:
+    quad() {}
+    quad(const point3 &q, const vec3 &u, const vec3 &v, material_id m);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+public:
+    point3 q;
+    vec3 u, v;
+    vec3 normal; // Unit length
+    real offset; // dot(normal, p) of the points p on the plane
+    // The coordinates of a point p of the plane along u and v are
+    // dot(p - q, alpha_axis) and dot(p - q, beta_axis), 0 to 1 within the quad
+    vec3 alpha_axis, beta_axis;
+    material_id mat_id = 0;
+};
+
+// Round flat disk facing along normal
+class disk : public hittable
+{
+public:
+    disk() {}
+    disk(const point3 &center, const vec3 &normal, real radius, material_id m);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+public:
+    point3 center;
+    vec3 normal; // Unit length
+    real radius;
+    real offset;
+    material_id mat_id = 0;
+};
+
+// Infinite plane through point facing along normal, e.g. a ground that never
+// ends. It has no bounding box, so acceleration structures test it against
+// every ray, and no area for light sampling to pick from.
+class plane : public hittable
+{
+public:
+    plane() {}
+    plane(const point3 &point, const vec3 &normal, material_id m);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+
+public:
+    vec3 normal; // Unit length
+    real offset;
+    material_id mat_id = 0;
+};
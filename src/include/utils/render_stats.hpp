@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <variant>
+
+#include "utils/material.hpp"
+
+// Counters of the work behind a frame. Every render worker counts into its own
+// render_stats, which the renderer adds up once the frame is done. Build with
+// -DRT_NO_STATS to compile every counter update out.
+#ifndef RT_NO_STATS
+#define RT_STAT(update) (thread_stats().update)
+const bool stats_enabled = true;
+#else
+#define RT_STAT(update) ((void)0)
+const bool stats_enabled = false;
+#endif
+
+// Ray against primitive tests, packet kernels count every lane. Box counts
+// bvh nodes, planar the quads, disks and planes.
+enum stat_test : int { test_sphere, test_triangle, test_box, test_cube, test_planar, stat_test_count };
+
+// How a path ended
+enum path_end : int { path_escaped, path_absorbed, path_roulette, path_max_depth, path_end_count };
+
+// Scatter events are counted per alternative of the material variant
+const int material_class_count = static_cast<int>(std::variant_size<material>::value);
+
+// Aligned to a cache line so that the counters of neighbouring workers don't share one
+struct alignas(64) render_stats {
+    // Longest path the histogram tells apart, longer paths share the last bin
+    static const int max_histogram_depth = 64;
+
+    uint64_t primary_rays = 0, secondary_rays = 0;
+    uint64_t shadow_rays = 0; // Toward light samples, neither hits nor misses count them
+    uint64_t hits = 0, misses = 0;
+    uint64_t tests[stat_test_count] = {};
+    uint64_t scatters[material_class_count] = {};
+    uint64_t path_ends[path_end_count] = {};
+    uint64_t path_length[max_histogram_depth + 1] = {}; // Paths by number of ray segments
+
+    void add_path(int segments, path_end end) {
+        path_ends[end]++;
+        path_length[segments < max_histogram_depth ? segments : max_histogram_depth]++;
+    }
+
+    uint64_t rays() const { return primary_rays + secondary_rays + shadow_rays; }
+    uint64_t paths() const;
+    void clear() { *this = render_stats(); }
+    render_stats& operator+=(const render_stats& other);
+
+    // Two line summary for the console, seconds is the time the frame took
+    void print(std::ostream& out, double seconds) const;
+    // One JSON object on a single line, the histogram ends at max_depth segments
+    void write_json(std::ostream& out, int frame, int max_depth, double seconds) const;
+};
+
+// Counters of the calling thread. Renderer workers point them at their slot of
+// the renderer's statistics, other threads count into a private set.
+render_stats& thread_stats();
+void set_thread_stats(render_stats* stats);
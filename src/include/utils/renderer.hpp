@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "math/utils.hpp"
+#include "utils/hittable.hpp"
+#include "utils/material.hpp"
+#include "utils/camera.hpp"
+#include "utils/denoise.hpp"
+#include "utils/image.hpp"
+#include "utils/lights.hpp"
+#include "utils/accumulation_buffer.hpp"
+#include "utils/render_stats.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/tonemap.hpp"
+
+enum class tile_order { scanline, morton, hilbert };
+
+struct render_settings {
+    int samples_per_pixel = 20;
+    int max_depth = 50;
+    int rr_min_depth = 3;      // Bounces before Russian roulette may end a path
+    double rr_threshold = 1.0; // Roulette only paths whose throughput fell below this
+    int num_threads = 0; // 0 uses every hardware thread
+    int tile_size = 16;
+    tile_order order = tile_order::morton;
+    uint64_t seed = 0; // Picks the noise pattern, the same seed gives the same image
+    bool packets = true; // Trace camera rays in SIMD packets, see ray_packet.hpp
+    // Where the sample dimensions of a pixel come from, see math/sampler.hpp.
+    // Stratified patterns hold samples_per_pixel points.
+    sampler_type sampler = sampler_type::sobol;
+
+    // Adaptive sampling treats samples_per_pixel as the frame's average budget.
+    // Every pixel first gets min_spp samples, the rest go to the pixels whose
+    // relative error is highest until they drop below error_threshold or reach max_spp.
+    bool adaptive = false;
+    int min_spp = 16;
+    int max_spp = 512;
+    double error_threshold = 0.01;
+
+    // Fill the feature buffers of the image (albedo, normal, depth), denoising
+    // fills them as well. Frames rendered by region leave them out.
+    bool features = false;
+    // Filters the finished frame, guided by its features. Changing it alone
+    // doesn't restart accumulation, the accumulated samples stay noisy.
+    denoise_settings denoise;
+
+    // Applied once the frame is done, changing it alone doesn't restart accumulation
+    display_settings display;
+};
+
+struct tile {
+    int x0, y0, x1, y1; // Pixel range [x0, x1) x [y0, y1)
+};
+
+// Covers the image with tile_size squares, clipped at the borders and sorted along the order's curve
+std::vector<tile> make_tiles(int width, int height, int tile_size, tile_order order);
+
+struct frame_context;
+class renderer;
+
+enum class job_state { queued, running, finished, cancelled };
+
+// Handle to a frame handed to renderer::submit. The frame renders on the
+// renderer's threads while the caller goes on, the handle reports how far it
+// got, cancels it partway through or waits for it. The handle stays valid
+// after the renderer has moved on to other frames.
+class render_job {
+public:
+    using progress_callback = std::function<void(int tiles_done, int tiles_total)>;
+
+    job_state state() const { return status.load(std::memory_order_acquire); }
+    bool done() const { return state() == job_state::finished || state() == job_state::cancelled; }
+
+    // Tiles finished so far out of the tiles of the passes started so far.
+    // Adaptive frames start passes as they go, so the total can grow.
+    int tiles_done() const { return done_tiles.load(std::memory_order_relaxed); }
+    int tiles_total() const { return total_tiles.load(std::memory_order_relaxed); }
+
+    // Asks the workers to stop: queued frames never start, tiles that haven't
+    // started are skipped and running tiles stop after their current row.
+    // Returns at once, wait() tells when the frame has come to rest.
+    void cancel() { cancel_requested.store(true, std::memory_order_relaxed); }
+
+    // Ready once the frame is finished or cancelled. A frame cancelled after its
+    // last tile finishes counts as finished.
+    std::shared_future<job_state> result() const { return future; }
+    job_state wait() const { return future.get(); }
+
+    // Counters of this frame, summed over the workers. Read them once it is done.
+    const render_stats& stats() const { return frame_stats; }
+
+    // Wall time from the start of the first pass to the end of the last, in
+    // seconds. Time spent in the queue doesn't count. Read it once it is done.
+    double seconds() const { return render_seconds; }
+
+    render_job(const hittable& world, const material_table& materials, const camera& cam, image& img,
+               const render_settings& settings, bool progressive, progress_callback progress,
+               std::chrono::milliseconds progress_interval);
+
+private:
+    friend class renderer;
+
+    const hittable& world;
+    const material_table& materials;
+    const camera cam;
+    image& img;
+    const render_settings settings; // As they were when the frame was submitted
+    const bool progressive;
+    const progress_callback progress;
+    const std::chrono::milliseconds progress_interval;
+    std::optional<tile> region; // Pixels to render, all of them when empty
+
+    std::atomic<job_state> status{job_state::queued};
+    std::atomic<bool> cancel_requested{false};
+    std::atomic<bool> interrupted{false}; // Some tile was skipped or cut short
+    std::atomic<int> done_tiles{0}, total_tiles{0};
+    render_stats frame_stats;
+    double render_seconds = 0.0;
+    std::promise<job_state> promise;
+    std::shared_future<job_state> future;
+};
+
+class renderer {
+public:
+    using progress_callback = render_job::progress_callback;
+
+    // Starts settings.num_threads workers that live as long as the renderer,
+    // and one more thread that hands them the submitted frames
+    explicit renderer(const render_settings& settings);
+    ~renderer(); // Cancels the frames that haven't finished
+
+    renderer(const renderer&) = delete;
+    renderer& operator=(const renderer&) = delete;
+
+    // Queues a frame of world, whose material ids index materials, into img and
+    // returns at once. Frames render one after the other in the order they were
+    // submitted, with the settings as they were at submission. A progressive
+    // frame adds to the accumulated samples like render_progressive. world,
+    // materials and img must outlive the job. progress, if given, is called on
+    // the renderer's thread at most once every progress_interval.
+    std::shared_ptr<render_job> submit(const hittable& world, const material_table& materials, const camera& cam,
+                                       image& img, bool progressive = false, progress_callback progress = nullptr);
+
+    // Queues the pixels of region alone, the rest of img is left as it is.
+    // Every pixel comes out as it would in a whole frame of the same settings,
+    // so frames can be rendered in pieces on several machines. Region frames
+    // neither accumulate nor sample adaptively.
+    std::shared_ptr<render_job> submit_region(const hittable& world, const material_table& materials,
+                                              const camera& cam, image& img, const tile& region,
+                                              progress_callback progress = nullptr);
+
+    // Renders one frame of world into img and returns when it is done,
+    // reporting the number of finished tiles through progress, if one is given.
+    void render(const hittable& world, const material_table& materials, const camera& cam, image& img,
+                const progress_callback& progress = nullptr);
+
+    // Adds samples_per_pixel more samples to the accumulated ones and shows their
+    // running average in img. Starts over by itself when the camera, the world
+    // or material table, the resolution or the path settings change.
+    void render_progressive(const hittable& world, const material_table& materials, const camera& cam, image& img,
+                            const progress_callback& progress = nullptr);
+
+    // The calls below read or reset what the frames leave behind, make them
+    // while no submitted frame is running.
+
+    // Drops the accumulated samples and the lights gathered from the world, for
+    // worlds that were edited in place
+    void reset_accumulation();
+    // Average number of samples per pixel behind the last image
+    int accumulated_samples() const;
+
+    int num_threads() const { return pool.size(); }
+
+    // Counters of the last frame that ran, summed over the workers
+    const render_stats& frame_stats() const { return stats; }
+
+public:
+    // Everything but num_threads may be changed between frames
+    render_settings settings;
+    // Shortest time between two progress callbacks of a frame
+    std::chrono::milliseconds progress_interval{50};
+
+private:
+    void driver_loop();
+    void run_job(render_job& job);
+    void render_adaptive(const frame_context& frame, render_job& job);
+    bool run_pass(const std::vector<tile>& pass_tiles, const frame_context& frame, render_job& job);
+
+    thread_pool pool;
+    std::vector<render_stats> worker_stats; // One per worker, cleared every frame
+    render_stats stats;
+
+    accumulation_buffer accum;
+    std::optional<camera> accum_camera;
+    const hittable* accum_world = nullptr;
+    const material_table* accum_materials = nullptr;
+    render_settings accum_settings;
+    std::vector<int> pass_samples;
+
+    std::optional<light_list> lights;
+    const hittable* lights_world = nullptr;
+    const material_table* lights_materials = nullptr;
+
+    std::vector<tile> tiles;
+    int tiles_width = 0, tiles_height = 0, tiles_size = 0;
+    tile_order tiles_order = tile_order::scanline;
+
+    // Submitted frames that haven't started, taken by the driver thread
+    std::deque<std::shared_ptr<render_job>> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_available;
+    bool stopping = false;
+    std::thread driver; // Last, so that it starts after everything it uses
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "utils/scenes.hpp"
+
+#include <string>
+
+// Reads a text scene description, one statement per line:
+//
+//   # comment
+//   camera from X Y Z at X Y Z [up X Y Z] [fov DEGREES] [aperture A] [focus DISTANCE]
+//   material NAME lambertian R G B
+//   material NAME metal R G B FUZZ
+//   material NAME dielectric INDEX
+//   material NAME diffuse_light R G B
+//   sphere X Y Z RADIUS MATERIAL
+//   cube X Y Z SIDE UPX UPY UPZ FRONTX FRONTY FRONTZ MATERIAL
+//   triangle X Y Z X Y Z X Y Z MATERIAL
+//   quad X Y Z UX UY UZ VX VY VZ MATERIAL
+//   disk X Y Z NX NY NZ RADIUS MATERIAL
+//   plane X Y Z NX NY NZ MATERIAL
+//   mesh PATH MATERIAL [scale S] [translate X Y Z]
+//   begin NAME
+//   end
+//   instance NAME [scale S | scale X Y Z] [rotate AXISX AXISY AXISZ DEGREES] [translate X Y Z] ...
+//
+// Materials are named before the objects that use them. Mesh paths are Wavefront
+// OBJ files relative to the scene file. A quad is the parallelogram with corner
+// X Y Z and edges U and V, a disk and a plane face along N. The objects between begin and end form
+// a group, which is not rendered itself but placed by every instance of it with
+// the transforms in the order written. Groups may hold instances of earlier
+// groups. All copies share the group's geometry and bvh, see instance.hpp.
+// Prints the reason and returns false on unreadable files and malformed
+// statements.
+bool load_scene(const std::string &path, scene &result);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "utils/hittable_list.hpp"
+#include "utils/material.hpp"
+#include "utils/camera.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Objects together with the materials their ids refer to
+struct scene {
+    hittable_list objects;
+    material_table materials;
+    std::optional<camera_settings> view; // Camera the scene was made for, if any
+};
+
+// Random spheres around three cubes, the scene from the book cover
+scene random_scene();
+
+// A triangle mesh on the ground of random_scene, scaled so that its largest side
+// is 2 units long and moved to stand where the glass cube is
+scene mesh_scene(std::vector<point3> vertices, std::vector<uint32_t> indices);
+
+// Camera orbiting the centre of random_scene(), advancing one step per frame
+camera random_scene_camera(int frame, double aspect_ratio);
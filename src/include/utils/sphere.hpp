@@ -8,14 +8,17 @@ class sphere : public hittable
 {
 public:
     sphere() {}
-    sphere(point3 cen, double r, std::shared_ptr<material> m)
-        : center(cen), radius(r), mat_ptr(m){};
+    sphere(point3 cen, real r, material_id m)
+        : center(cen), radius(r), mat_id(m){};
 
     virtual bool hit(
-        const ray &r, double t_min, double t_max, hit_record &rec) const override;
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual void add_lights(light_list &lights) const override;
 
 public:
     point3 center;
-    double radius;
-    std::shared_ptr<material> mat_ptr;
+    real radius;
+    material_id mat_id = 0;
 };
\ No newline at end of file
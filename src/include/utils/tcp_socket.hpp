@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Blocking TCP socket, closed when destroyed. Carries the messages between the
+// coordinator and the workers of a distributed render.
+class tcp_socket
+{
+public:
+    // Connects to host, a name or an address, return null when nobody answers
+    static std::unique_ptr<tcp_socket> connect(const std::string &host, int port);
+    // Listens on every interface. Prints the reason and returns null on failure.
+    static std::unique_ptr<tcp_socket> listen(int port);
+
+    tcp_socket(const tcp_socket &) = delete;
+    tcp_socket &operator=(const tcp_socket &) = delete;
+    ~tcp_socket();
+
+    // Waits for the next connection to a listening socket, null on failure
+    std::unique_ptr<tcp_socket> accept();
+
+    // Send or receive exactly size bytes. False once the connection is gone.
+    bool send_all(const void *data, size_t size);
+    bool receive_all(void *data, size_t size);
+
+    // Ends the connection both ways. May be called from another thread, calls
+    // blocked on the socket then return false.
+    void shutdown();
+
+    // Address and port of the other end, for messages
+    std::string peer() const;
+
+private:
+#ifdef _WIN32
+    using handle_type = uintptr_t;
+#else
+    using handle_type = int;
+#endif
+    explicit tcp_socket(handle_type handle) : handle(handle) {}
+
+    handle_type handle;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads. Every worker owns a deque of task indices,
+// works through it from the front and steals from the back of the others once
+// it runs dry.
+class thread_pool {
+public:
+    using task_function = std::function<void(int index, int worker)>;
+
+    explicit thread_pool(int num_threads = 0); // 0 uses every hardware thread
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Queues task(index, worker) for every index in [0, count) and returns at once.
+    // Worker w initially owns the contiguous range starting at w * count / size(),
+    // so neighbouring indices stay on the same worker until they are stolen.
+    void run(int count, task_function task);
+
+    // Blocks until every task of the last run() has finished
+    void wait();
+    // Waits at most timeout, returns true if the tasks have finished
+    bool wait_for(std::chrono::milliseconds timeout);
+
+    void parallel_for(int count, task_function task) {
+        run(count, std::move(task));
+        wait();
+    }
+
+    int tasks_completed() const { return completed.load(std::memory_order_relaxed); }
+
+private:
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void worker_loop(int id);
+    bool pop(int id, int& index);
+    bool steal(int id, int& index);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+
+    task_function task;
+    std::atomic<int> remaining;
+    std::atomic<int> completed;
+
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    unsigned long generation = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "utils/image.hpp"
+
+enum class tonemap_curve {
+    clamp,    // Cuts everything above 1 off
+    reinhard, // c / (1 + c) per channel
+    aces,     // Narkowicz's fit of the ACES filmic curve
+};
+
+enum class transfer_curve {
+    gamma2, // Square root, what the book uses
+    srgb,   // The sRGB curve, approximated within one 8-bit step
+};
+
+// How the linear radiance of an image becomes its 8-bit pixels. The defaults
+// give the images of the book.
+struct display_settings {
+    double exposure = 0.0; // In stops, every stop doubles the radiance
+    tonemap_curve curve = tonemap_curve::clamp;
+    transfer_curve transfer = transfer_curve::gamma2;
+    bool dither = false; // Ordered dithering before the 8-bit rounding, against banding
+};
+
+// Fills the 8-bit pixels of img in [x0, x1) x [y0, y1) from its linear
+// radiance in img.hdr. Works on a whole pixel at a time in the vector unit,
+// build with -DRT_NO_SIMD for the scalar code.
+void tonemap(image& img, const display_settings& settings, int x0, int y0, int x1, int y1);
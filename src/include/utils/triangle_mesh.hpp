@@ -0,0 +1,55 @@
+#pragma once
+
+#include "utils/hittable.hpp"
+#include "utils/bvh.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Triangles that share one vertex buffer, one index buffer and one material.
+// The mesh keeps its own bvh, so a scene bvh sees it as a single primitive.
+class triangle_mesh : public hittable
+{
+public:
+    // indices holds three vertex indices per triangle
+    triangle_mesh(std::vector<point3> vertices, std::vector<uint32_t> indices,
+                  material_id m, int max_leaf_size = 4);
+
+    virtual bool hit(
+        const ray &r, real t_min, real t_max, hit_record &rec) const override;
+    virtual bool bounding_box(aabb &output_box) const override;
+    virtual void hit_packet(ray_packet &packet, const hittable *hit_objects[]) const override;
+    virtual bool occluded(const ray &r, real t_min, real t_max) const override;
+    virtual void add_lights(light_list &lights) const override;
+
+    size_t triangle_count() const { return triangles.size(); }
+    // Bytes held by the buffers and the bvh
+    size_t memory_size() const;
+
+public:
+    std::vector<point3> vertices;
+    std::vector<uint32_t> indices; // Reordered to match the bvh leaves
+    std::vector<bvh_node> nodes;
+    material_id mat_id;
+
+private:
+    // First vertex and the two edges of a triangle, ready for Möller-Trumbore.
+    // Single precision halves their size and OBJ data carries no more than that.
+    struct precomputed_triangle {
+        float v0[3], e1[3], e2[3];
+    };
+
+    std::vector<precomputed_triangle> triangles; // In bvh leaf order
+
+    // Index of the closest triangle along r, shrinking t_max to its distance,
+    // or of the first one found when any_hit is set. -1 when there is none.
+    int64_t find_triangle(const ray &r, real t_min, real &t_max, bool any_hit) const;
+};
+
+// Reads the vertices and faces of a Wavefront OBJ file in fixed size chunks.
+// Polygons are split into triangle fans, texture coordinates, normals and
+// every other statement are skipped. Prints the reason and returns false on
+// unreadable files or malformed faces.
+bool load_obj(const std::string &path, std::vector<point3> &vertices, std::vector<uint32_t> &indices);
@@ -1,176 +0,0 @@
-#include "math/vec3.hpp"
-#include "math/utils.hpp"
-
-double vec3::x() const { return e[0]; }
-double vec3::y() const { return e[1]; }
-double vec3::z() const { return e[2]; }
-
-vec3 vec3::operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-double vec3::operator[](int i) const { 
-    if(i < 0 || i > 2){
-        std::cout << "vec3::operator[]: index out of range in << " << __FILE__ << " at line " << __LINE__ << std::endl;
-        exit(1);
-    }
-    return e[i]; 
-}
-double &vec3::operator[](int i) { return e[i]; }
-
-vec3 &vec3::operator+=(const vec3 &v)
-{
-    e[0] += v.e[0];
-    e[1] += v.e[1];
-    e[2] += v.e[2];
-
-    return *this;
-}
-
-vec3 &vec3::operator*=(const double t)
-{
-    e[0] *= t;
-    e[1] *= t;
-    e[2] *= t;
-
-    return *this;
-}
-
-vec3 &vec3::operator/=(const double t)
-{
-    return *this *= 1 / t;
-}
-
-double vec3::length() const
-{
-    return sqrt(length_squared());
-}
-
-double vec3::length_squared() const
-{
-    return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
-}
-
-bool vec3::near_zero() const
-{
-    // Return true if the vector is close to zero in all dimensions.
-    const auto s = 1e-8;
-    return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
-}
-
-void vec3::rotate(double angle, vec3 axis){
-    double c = cos(angle);
-    double s = sin(angle);
-    double t = 1 - c;
-    double x = e[0];
-    double y = e[1];
-    double z = e[2];
-    double x2 = axis[0];
-    double y2 = axis[1];
-    double z2 = axis[2];
-    vec3 ne = vec3(
-        (t * x2 * x2 + c) * x + (t * x2 * y2 - s * z2) * y + (t * x2 * z2 + s * y2) * z,
-        (t * x2 * y2 + s * z2) * x + (t * y2 * y2 + c) * y + (t * y2 * z2 - s * x2) * z,
-        (t * x2 * z2 - s * y2) * x + (t * y2 * z2 + s * x2) * y + (t * z2 * z2 + c) * z
-    );
-    e[0] = ne[0];
-    e[1] = ne[1];
-    e[2] = ne[2];
-}
-
-std::ostream &operator<<(std::ostream &out, const vec3 &v)
-{
-    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
-}
-
-vec3 operator+(const vec3 &u, const vec3 &v)
-{
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
-}
-
-vec3 operator-(const vec3 &u, const vec3 &v)
-{
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
-}
-
-vec3 operator*(const vec3 &u, const vec3 &v)
-{
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-}
-
-vec3 operator*(double t, const vec3 &v)
-{
-    return vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
-}
-
-vec3 operator*(const vec3 &v, double t)
-{
-    return t * v;
-}
-
-vec3 operator/(vec3 v, double t)
-{
-    return (1 / t) * v;
-}
-
-double dot(const vec3 &u, const vec3 &v)
-{
-    return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
-}
-
-vec3 cross(const vec3 &u, const vec3 &v)
-{
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
-}
-
-vec3 unit_vector(vec3 v)
-{
-    return v / v.length();
-}
-
-vec3 random_vec3(){
-    return vec3(random_double(), random_double(), random_double());
-}
-
-vec3 random_vec3(double min, double max){
-    return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
-}
-
-vec3 random_in_unit_sphere(){
-    while(true){
-        auto p = random_vec3(-1, 1);
-        if(p.length_squared() >= 1) continue;
-        return p;
-    }
-}
-
-vec3 random_unit_vector(){
-    return unit_vector(random_in_unit_sphere());
-}
-
-vec3 random_in_hemisphere(const vec3& normal){
-    vec3 in_unit_sphere = random_in_unit_sphere();
-    if(dot(in_unit_sphere, normal) > 0.0){
-        return in_unit_sphere;
-    }else{
-        return -in_unit_sphere;
-    }
-}
-
-vec3 random_in_unit_disk(){
-    while(true){
-        auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-        if(p.length_squared() >= 1) continue;
-        return p;
-    }
-}
-
-vec3 reflect(const vec3& v, const vec3& n){
-    return v - 2*dot(v, n)*n;
-}
-
-vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat){
-    auto cos_theta = fmin(dot(-uv, n), 1.0);
-    vec3 r_out_perp = etai_over_etat*(uv + cos_theta*n);
-    vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared()))*n;
-    return r_out_perp + r_out_parallel;
-}
\ No newline at end of file